@@ -1,290 +1,678 @@
 #include <ArduinoJson.h>
-#include <ESPAsyncWebServer.h>
+#include <new>
 
 #include "ble_utils.h"
+#include "ble_poller.h"
+#include "connection.h"
+#include "device_registry.h"
+#include "history.h"
+#include "log.h"
+#include "metrics.h"
+#include "modbus.h"
+#include "phase_energy.h"
+#include "prefetch.h"
+#include "push.h"
+#include "server_timing.h"
+#include "refresh.h"
+#include "routes.h"
+#include "scheduler.h"
+#include "settings_shadow.h"
+#include "snapshot.h"
+#include "snapshot_endpoint.h"
+#include "snapshot_fields.h"
 #include "api.h"
 
-typedef struct {
-    char Error[50];
-    uint32_t TotalEnergy;
-    uint32_t EnergyLastCharge;
-    uint16_t ChargingEnergyLimit;
-    uint16_t TotalPower;
-    uint16_t PowerL1;
-    uint16_t PowerL2;
-    uint16_t PowerL3;
-    uint16_t Frequency;
-    int16_t Temperature;
-    uint16_t VoltageL1;
-    uint16_t VoltageL2;
-    uint16_t VoltageL3;
-    uint16_t CurrentL1;
-    uint16_t CurrentL2;
-    uint16_t CurrentL3;
-} ApiMeasurements;
-
-
-ApiMeasurements get_measurements(const String& targetAddress) {
-    ApiMeasurements measurements;
-    measurements.Error[0] = 0;
-    BLEDevice device = scanForTargetDevice(targetAddress);
-    if (!device) {
-        strcpy(measurements.Error, "not found");
-        return measurements;
-    }
-    if (!connectToDevice(device)) {
-        strcpy(measurements.Error, "connect failed");
-        return measurements;
-    }
-
-    BLECharacteristic energyChar = device.characteristic(ENERGY_SERVICE);
-    if (!(energyChar && energyChar.canRead() && energyChar.read())) {
-        strcpy(measurements.Error, "energy characteristic read failed");
-        return measurements;
-    }
-    Energy energy = convertEnergy(energyChar.value());
-    measurements.TotalEnergy = energy.TotalEnergy;
-    measurements.EnergyLastCharge = energy.EnergyLastCharge;
-    measurements.ChargingEnergyLimit = energy.ChargingEnergyLimit;
-
-    BLECharacteristic powerChar = device.characteristic(POWER_SERVICE);
-    if (!(powerChar && powerChar.canRead() && powerChar.read())) {
-        strcpy(measurements.Error, "power characteristic read failed");
-        return measurements;
-    }
-    Power power = convertPower(powerChar.value());
-    measurements.TotalPower = power.TotalPower;
-    measurements.PowerL1 = power.L1;
-    measurements.PowerL2 = power.L2;
-    measurements.PowerL3 = power.L3;
-    measurements.Frequency = power.Frequency;
-    measurements.Temperature = power.Temperature;
-
-    BLECharacteristic vcChar = device.characteristic(VOLTAGE_CURRENT_SERVICE);
-    if (!(vcChar && vcChar.canRead() && vcChar.read())) {
-        strcpy(measurements.Error, "voltage/current characteristic read failed");
-        return measurements;
-    }
-    VoltageCurrent vc = convertVoltageCurrent(vcChar.value());
-    measurements.VoltageL1 = vc.VoltageL1;
-    measurements.VoltageL2 = vc.VoltageL2;
-    measurements.VoltageL3 = vc.VoltageL3;
-    measurements.CurrentL1 = vc.CurrentL1;
-    measurements.CurrentL2 = vc.CurrentL2;
-    measurements.CurrentL3 = vc.CurrentL3;
-    return measurements;
+// Capacity of the /api/snapshot response, all fields with their ages
+#ifndef SNAPSHOT_RESPONSE_SIZE
+#define SNAPSHOT_RESPONSE_SIZE 2048
+#endif
+
+static void appendFixedArray(ResponseBuffer& json, const EndpointValues& values, SnapshotFieldId first,
+                             SnapshotFieldId second, SnapshotFieldId third, uint8_t decimals) {
+    json.append('[');
+    json.appendFixed(values.get(first), decimals);
+    json.append(',');
+    json.appendFixed(values.get(second), decimals);
+    json.append(',');
+    json.appendFixed(values.get(third), decimals);
+    json.append(']');
 }
 
-void print_measurements(const ApiMeasurements& measurements) {
-    if (measurements.Error[0] != 0) {
-        Serial.print("Error: ");
-        Serial.println(measurements.Error);
-    } else {
-        Serial.println("Measurements:");
-        Serial.print("Total Energy: "); Serial.println(measurements.TotalEnergy / 1000.0);
-        Serial.print("Last Charge Energy: "); Serial.println(measurements.EnergyLastCharge / 1000.0);
-        Serial.print("Charging Energy Limit: "); Serial.println(measurements.ChargingEnergyLimit / 100.0);
-        Serial.print("Total Power: "); Serial.println(measurements.TotalPower / 100.0);
-        Serial.print("Power L1: "); Serial.println(measurements.PowerL1 / 100.0);
-        Serial.print("Power L2: "); Serial.println(measurements.PowerL2 / 100.0);
-        Serial.print("Power L3: "); Serial.println(measurements.PowerL3 / 100.0);
-        Serial.print("Frequency: "); Serial.println(measurements.Frequency / 100.0);
-        Serial.print("Temperature: "); Serial.println(measurements.Temperature);
-        Serial.print("Voltage L1: "); Serial.println(measurements.VoltageL1 / 10.0);
-        Serial.print("Voltage L2: "); Serial.println(measurements.VoltageL2 / 10.0);
-        Serial.print("Voltage L3: "); Serial.println(measurements.VoltageL3 / 10.0);
-        Serial.print("Current L1: "); Serial.println(measurements.CurrentL1 / 100.0);
-        Serial.print("Current L2: "); Serial.println(measurements.CurrentL2 / 100.0);
-        Serial.print("Current L3: "); Serial.println(measurements.CurrentL3 / 100.0);
+static const SnapshotFieldId measurementFields[] = {
+    FIELD_CURRENT_L1, FIELD_CURRENT_L2, FIELD_CURRENT_L3,
+    FIELD_ENERGY_LAST_CHARGE, FIELD_ENERGY_TOTAL_ENERGY,
+    FIELD_POWER_TOTAL_POWER, FIELD_POWER_L1, FIELD_POWER_L2, FIELD_POWER_L3,
+    FIELD_POWER_FREQUENCY, FIELD_POWER_TEMPERATURE,
+    FIELD_VOLTAGE_L1, FIELD_VOLTAGE_L2, FIELD_VOLTAGE_L3,
+};
+
+static void renderMeasurements(const EndpointValues& values, ResponseBuffer& json) {
+    json.append("{\"ChargingCurrentPhase\":");
+    appendFixedArray(json, values, FIELD_CURRENT_L1, FIELD_CURRENT_L2, FIELD_CURRENT_L3, 2);
+    json.append(",\"ChargingEnergy\":");
+    json.appendFixed(values.get(FIELD_ENERGY_LAST_CHARGE), 3);
+    json.append(",\"ChargingEnergyOverAll\":");
+    json.appendFixed(values.get(FIELD_ENERGY_TOTAL_ENERGY), 3);
+    PhaseEnergy phases = values.phaseEnergy();
+    json.append(",\"ChargingEnergyPhase\":[");
+    json.appendFixed(phases.L1, 3);
+    json.append(',');
+    json.appendFixed(phases.L2, 3);
+    json.append(',');
+    json.appendFixed(phases.L3, 3);
+    json.append(']');
+    json.append(",\"ChargingPower\":");
+    json.appendFixed(values.get(FIELD_POWER_TOTAL_POWER), 2);
+    json.append(",\"ChargingPowerPhase\":");
+    appendFixedArray(json, values, FIELD_POWER_L1, FIELD_POWER_L2, FIELD_POWER_L3, 2);
+    json.append(",\"Frequency\":");
+    json.appendFixed(values.get(FIELD_POWER_FREQUENCY), 2);
+    json.append(",\"TemperatureMainUnit\":");
+    json.appendInt(values.get(FIELD_POWER_TEMPERATURE));
+    json.append(",\"VoltagePhase\":");
+    appendFixedArray(json, values, FIELD_VOLTAGE_L1, FIELD_VOLTAGE_L2, FIELD_VOLTAGE_L3, 1);
+    json.append('}');
+}
+
+static const SnapshotEndpoint measurementsEndpoint = {
+    "measurements", ENDPOINT_FIELDS(measurementFields), renderMeasurements, 200, "Message", true
+};
+
+static const SnapshotFieldId settingsFields[] = {
+    FIELD_INFO_CHARGING_ACTIVE, FIELD_INFO_CURRENT,
+};
+
+static void renderSettings(const EndpointValues& values, ResponseBuffer& json) {
+    json.append("{\"Values\":{\"ChargingStatus\":{\"Charging\":");
+    json.append(values.get(FIELD_INFO_CHARGING_ACTIVE) == 1 ? "true" : "false");
+    json.append("},\"ChargingCurrent\":{\"Value\":");
+    json.appendInt(values.get(FIELD_INFO_CURRENT));
+    json.append("}}}");
+}
+
+static const SnapshotEndpoint settingsEndpoint = {
+    "settings", ENDPOINT_FIELDS(settingsFields), renderSettings, 200, "Error", true
+};
+
+
+void sendSnapshotJson(HttpRequest *request, int code, const ResponseBuffer& json, int64_t age) {
+    if (json.overflowed()) {
+        sendJsonError(request, 500, "response too large");
+        return;
+    }
+    if (age >= 0) {
+        char value[21];
+        snprintf(value, sizeof(value), "%lld", (long long)age);
+        request->addHeader("X-Snapshot-Age", value);
+    }
+    REQUEST_TIMING_HEADER(request);
+    request->send(code, "application/json", json.c_str(), json.length());
+}
+
+void sendJsonError(HttpRequest *request, int code, const char* message) {
+    countHttpError(message);
+    StaticResponseBuffer<> json;
+    json.append("{\"Message\":");
+    json.appendJsonString(message);
+    json.append('}');
+    request->send(code, "application/json", json.c_str(), json.length());
+}
+
+void sendBusy(HttpRequest *request) {
+    countHttpError("BLE queue full");
+    request->addHeader("Retry-After", "1");
+    request->send(503, "application/json", "{\"Message\":\"BLE queue full\"}");
+}
+
+struct PendingSnapshotRequest {
+    HttpRequest* Request;
+    int Slot;
+    uint8_t Parts;
+    SnapshotResponder Respond;
+    const void* Context;
+};
+
+static void onSnapshotRefreshed(void* context, const char* error) {
+    PendingSnapshotRequest* pending = (PendingSnapshotRequest*)context;
+    ChargerSnapshot snapshot;
+    int64_t age;
+    if (!loadSnapshot(pending->Slot, pending->Parts, snapshot, age) && error) {
+        strlcpy(snapshot.Error, error, sizeof(snapshot.Error));
+    }
+    REQUEST_TIMING_SESSION(pending->Request);
+    pending->Respond(pending->Request, snapshot, age, pending->Context);
+    delete pending->Request;
+    delete pending;
+}
+
+// Returns the slot of a charger, a charger is only registered for polling once the registry
+// has seen it, so requests for other addresses cannot use up the slots
+static int chargerSlot(const char* address, const char*& error) {
+    if (findCharger(address) < 0 && !lookupDevice(address)) {
+        // the next scan registers its advertisements even if it is not named like an NRGkick
+        requestDevice(address);
+        error = "not found";
+        return -1;
     }
+    int slot = registerCharger(address);
+    error = slot < 0 ? "too many chargers" : NULL;
+    return slot;
 }
 
-void measurements2json(const ApiMeasurements& measurements, ArduinoJson::JsonDocument& doc) {
-    if (measurements.Error[0] != 0) {
-        doc["Message"] = measurements.Error;
+// Right after boot the passive scan may not have seen a charger yet, requests for it wait for
+// the registry instead of failing
+static bool deviceAwaited(const char* address) {
+    return findCharger(address) < 0 && !lookupDevice(address) && registryWarmingUp();
+}
+
+// Responds on a handle that was deferred while waiting for the registry and releases it
+static void respondDeferred(HttpRequest *request, bool deferred, SnapshotResponder respond,
+                            const ChargerSnapshot& snapshot, int64_t age, const void* context) {
+    respond(request, snapshot, age, context);
+    if (deferred) {
+        delete request;
+    }
+}
+
+// Serves a snapshot once the charger is known; deferred requests are already owned handles
+static void serveChargerSnapshot(HttpRequest *request, bool deferred, uint8_t parts, SnapshotResponder respond,
+                                 const void* context) {
+    const char* error;
+    int slot = chargerSlot(request->pathArg(0), error);
+    ChargerSnapshot snapshot;
+    int64_t age;
+    bool usable = loadSnapshot(slot, parts, snapshot, age);
+    if (slot < 0) {
+        strcpy(snapshot.Error, error);
+    }
+    // the first request of a known burst also reads what the rest of the burst will need
+    PrefetchDecision prefetch = prefetchRequest(request->clientId(), slot, parts, millis());
+    int64_t now = snapshotNow();
+    REQUEST_TIMING_PHASE(request, TIMING_LOOKUP);
+    if (slot < 0 || !snapshotNeedsRefresh(age)) {
+        uint8_t predicted = staleParts(snapshot, prefetch.Parts, now);
+        if (slot >= 0 && predicted) {
+            requestRefresh(slot, predicted, NULL, NULL);
+        }
+        prefetchServed(prefetch, parts, PREFETCH_FROM_MEMORY);
+        respondDeferred(request, deferred, respond, snapshot, age, context);
+        return;
+    }
+    // parts that are still fresh are served as they are
+    uint8_t stale = staleParts(snapshot, parts | prefetch.Parts, now);
+    if (usable) {
+        // serve the outdated snapshot and refresh it in the background
+        requestRefresh(slot, stale, NULL, NULL);
+        prefetchServed(prefetch, parts, PREFETCH_FROM_MEMORY);
+        respondDeferred(request, deferred, respond, snapshot, age, context);
         return;
     }
-    doc["ChargingCurrentPhase"] = ArduinoJson::JsonArray();
-    doc["ChargingCurrentPhase"].add(measurements.CurrentL1 / 100.0);
-    doc["ChargingCurrentPhase"].add(measurements.CurrentL2 / 100.0);
-    doc["ChargingCurrentPhase"].add(measurements.CurrentL3 / 100.0);
-    doc["ChargingEnergy"] = measurements.EnergyLastCharge / 1000.0;
-    doc["ChargingEnergyOverAll"] = measurements.TotalEnergy / 1000.0;
-    doc["ChargingEnergyPhase"] = ArduinoJson::JsonArray();
-    doc["ChargingEnergyPhase"].add(0.0);
-    doc["ChargingEnergyPhase"].add(0.0);
-    doc["ChargingEnergyPhase"].add(0.0);
-    doc["ChargingPower"] = measurements.TotalPower / 100.0;
-    doc["ChargingPowerPhase"] = ArduinoJson::JsonArray();
-    doc["ChargingPowerPhase"].add(measurements.PowerL1 / 100.0);
-    doc["ChargingPowerPhase"].add(measurements.PowerL2 / 100.0);
-    doc["ChargingPowerPhase"].add(measurements.PowerL3 / 100.0);
-    doc["Frequency"] = measurements.Frequency / 100.0;
-    doc["TemperatureMainUnit"] = measurements.Temperature;
-    doc["VoltagePhase"] = ArduinoJson::JsonArray();
-    doc["VoltagePhase"].add(measurements.VoltageL1 / 10.0);
-    doc["VoltagePhase"].add(measurements.VoltageL2 / 10.0);
-    doc["VoltagePhase"].add(measurements.VoltageL3 / 10.0);
+
+    bool found = lookupDevice(snapshot.Address);
+    REQUEST_TIMING_PHASE(request, TIMING_LOOKUP);
+    if (!found) {
+        // unknown devices fail fast instead of waiting for a scan
+        strcpy(snapshot.Error, "not found");
+        respondDeferred(request, deferred, respond, snapshot, age, context);
+        return;
+    }
+
+    HttpRequest* handle = deferred ? request : request->defer();
+    PendingSnapshotRequest* pending = new PendingSnapshotRequest{handle, slot, parts, respond, context};
+    RefreshStatus status = requestRefresh(slot, stale, onSnapshotRefreshed, pending);
+    if (status == REFRESH_BUSY) {
+        delete pending;
+        sendBusy(handle);
+        delete handle;
+        return;
+    }
+    prefetchServed(prefetch, parts, status == REFRESH_ATTACHED ? PREFETCH_SHARED : PREFETCH_OWN_READ);
 }
 
+struct PendingLookupRequest {
+    HttpRequest* Request;
+    uint8_t Parts;
+    SnapshotResponder Respond;
+    const void* Context;
+};
 
-typedef struct {
-    char Error[50];
-    bool Charging;
-    uint8_t Current;
-    uint16_t ChargingEnergyLimit;
-    uint16_t KWhPer100;
-    uint8_t AmountPerKWh;
-    uint8_t Efficiency;
-    uint8_t PauseCharging;
-    uint8_t BLETransmissionPower;
-} ApiSettings;
-
-ApiSettings get_settings(const String& targetAddress) {
-    ApiSettings settings;
-    settings.Error[0] = 0;
-    BLEDevice device = scanForTargetDevice(targetAddress);
-    if (!device) {
-        strcpy(settings.Error, "not found");
-        return settings;
-    }
-    if (!connectToDevice(device)) {
-        strcpy(settings.Error, "connect failed");
-        return settings;
-    }
-
-    BLECharacteristic infoChar = device.characteristic(INFO_SERVICE);
-    if (!(infoChar && infoChar.canRead() && infoChar.read())) {
-        strcpy(settings.Error, "info characteristic read failed");
-        return settings;
-    }
-    Info info = convertInfo(infoChar.value());
-    settings.Charging = info.ChargingActive == 1 ? true : false;
-    settings.Current = info.Current;
-    settings.KWhPer100 = info.KWhPer100;
-    settings.AmountPerKWh = info.AmountPerKWh;
-    settings.Efficiency = info.Efficiency;
-    settings.PauseCharging = info.PauseCharging == 1 ? true : false;
-    settings.BLETransmissionPower = info.BLETransmissionPower;
-
-    BLECharacteristic energyChar = device.characteristic(ENERGY_SERVICE);
-    if (!(energyChar && energyChar.canRead() && energyChar.read())) {
-        strcpy(settings.Error, "energy characteristic read failed");
-        return settings;
-    }
-    Energy energy = convertEnergy(energyChar.value());
-    settings.ChargingEnergyLimit = energy.ChargingEnergyLimit;
-    return settings;
+static void onSnapshotDeviceSeen(void* context) {
+    PendingLookupRequest* pending = (PendingLookupRequest*)context;
+    serveChargerSnapshot(pending->Request, true, pending->Parts, pending->Respond, pending->Context);
+    delete pending;
 }
 
-void settings2json(const ApiSettings& settings, ArduinoJson::JsonDocument& doc) {
-    if (settings.Error[0] != 0) {
-        doc["Error"] = settings.Error;
+void serveSnapshot(HttpRequest *request, uint8_t parts, SnapshotResponder respond, const void* context) {
+    const char* address = request->pathArg(0);
+    if (!deviceAwaited(address)) {
+        serveChargerSnapshot(request, false, parts, respond, context);
         return;
     }
-    ArduinoJson::JsonObject values = doc["Values"].to<JsonObject>();
-    ArduinoJson::JsonObject chargingStatus = values["ChargingStatus"].to<JsonObject>();
-    chargingStatus["Charging"] = settings.Charging;
-    ArduinoJson::JsonObject chargingCurrent = values["ChargingCurrent"].to<JsonObject>();
-    chargingCurrent["Value"] = settings.Current;
+    requestDevice(address);
+    PendingLookupRequest* pending = new PendingLookupRequest{request->defer(), parts, respond, context};
+    if (!waitForDevice(address, onSnapshotDeviceSeen, pending)) {
+        delete pending->Request;
+        delete pending;
+        sendBusy(request);
+    }
 }
 
+struct PendingWriteRequest {
+    HttpRequest* Request;
+    WriteResponder Respond;
+};
 
+static void onSettingsWritten(void* context, const char* error) {
+    PendingWriteRequest* pending = (PendingWriteRequest*)context;
+    REQUEST_TIMING_SESSION(pending->Request);
+    pending->Respond(pending->Request, error);
+    delete pending->Request;
+    delete pending;
+}
 
-void handleMeasurementsRequest(AsyncWebServerRequest *request) {
-    String mac = request->pathArg(0);
-    Serial.print("measurements request for ");
-    Serial.println(mac);
-    ApiMeasurements measurements = get_measurements(mac);
-    ArduinoJson::JsonDocument doc;
-    measurements2json(measurements, doc);
-    if (measurements.Error[0] != 0) {
-        Serial.print("> Error: ");
-        Serial.println(measurements.Error);
+// Responds on a handle that was deferred while waiting for the registry and releases it
+static void respondDeferred(HttpRequest *request, bool deferred, WriteResponder respond, const char* error) {
+    respond(request, error);
+    if (deferred) {
+        delete request;
     }
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json);
 }
 
-void handleSettingsRequest(AsyncWebServerRequest *request) {
-    String mac = request->pathArg(0);
-    Serial.print("settings request for ");
-    Serial.println(mac);
-    ApiSettings settings = get_settings(mac);
-    ArduinoJson::JsonDocument doc;
-    settings2json(settings, doc);
-    if (settings.Error[0] != 0) {
-        Serial.print("> Error: ");
-        Serial.println(settings.Error);
+// Queues a settings change once the charger is known; deferred requests are already owned handles
+static void submitChargerSettings(HttpRequest *request, bool deferred, const SettingsChange& change,
+                                  WriteResponder respond) {
+    const char* error;
+    int slot = chargerSlot(request->pathArg(0), error);
+    if (slot < 0) {
+        respondDeferred(request, deferred, respond, error);
+        return;
+    }
+    bool found = lookupDevice(request->pathArg(0));
+    REQUEST_TIMING_PHASE(request, TIMING_LOOKUP);
+    if (!found) {
+        respondDeferred(request, deferred, respond, "not found");
+        return;
+    }
+
+    // the charger already has these settings, writing them again would only cost airtime
+    if (settingsUnchanged(slot, change)) {
+        respondDeferred(request, deferred, respond, NULL);
+        return;
+    }
+
+    HttpRequest* handle = deferred ? request : request->defer();
+    PendingWriteRequest* pending = new PendingWriteRequest{handle, respond};
+    SettingsQueueStatus status = queueSettingsChange(slot, change, onSettingsWritten, pending);
+    if (status == SETTINGS_CONFLICT) {
+        delete pending;
+        sendJsonError(handle, 409, "settings write in progress");
+        delete handle;
+    } else if (status == SETTINGS_BUSY) {
+        delete pending;
+        sendBusy(handle);
+        delete handle;
     }
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json);
 }
 
-void handleSettingsRequestPut(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+struct PendingSettingsLookup {
+    HttpRequest* Request;
+    SettingsChange Change;
+    WriteResponder Respond;
+};
+
+static void onSettingsDeviceSeen(void* context) {
+    PendingSettingsLookup* pending = (PendingSettingsLookup*)context;
+    submitChargerSettings(pending->Request, true, pending->Change, pending->Respond);
+    delete pending;
+}
+
+void submitSettingsChange(HttpRequest *request, const SettingsChange& change, WriteResponder respond) {
+    const char* address = request->pathArg(0);
+    if (!deviceAwaited(address)) {
+        submitChargerSettings(request, false, change, respond);
+        return;
+    }
+    requestDevice(address);
+    PendingSettingsLookup* pending = new PendingSettingsLookup{request->defer(), change, respond};
+    if (!waitForDevice(address, onSettingsDeviceSeen, pending)) {
+        delete pending->Request;
+        delete pending;
+        sendBusy(request);
+    }
+}
+
+void handleMeasurementsRequest(HttpRequest *request) {
+    serveEndpoint(request, measurementsEndpoint);
+}
+
+void handleSettingsRequest(HttpRequest *request) {
+    serveEndpoint(request, settingsEndpoint);
+}
+
+static void respondSnapshot(HttpRequest *request, const ChargerSnapshot& snapshot, int64_t age, const void*) {
+    StaticResponseBuffer<SNAPSHOT_RESPONSE_SIZE> json;
+    int64_t now = snapshotNow();
+    json.append("{\"Address\":");
+    json.appendJsonString(snapshot.Address);
+    json.append(",\"Error\":");
+    json.appendJsonString(snapshot.Error);
+    int part = -1;
+    for (size_t i = 0; i < SNAPSHOT_FIELD_COUNT; ++i) {
+        const SnapshotField& field = snapshotFields[i];
+        if (field.Part != part) {
+            json.append(part < 0 ? ",\"" : "},\"");
+            json.append(snapshotPartName(field.Part));
+            json.append("\":{");
+            part = field.Part;
+        } else {
+            json.append(',');
+        }
+        // all fields of a characteristic share the time it was read or notified
+        bool valid = snapshot.Valid & PART_BIT(field.Part);
+        json.appendJsonString(field.Name);
+        json.append(":{\"Value\":");
+        if (valid) {
+            json.appendInt(readSnapshotField(snapshot, field));
+            json.append(",\"Age\":");
+            json.appendInt(now - snapshot.ReadAt[field.Part]);
+        } else {
+            json.append("null,\"Age\":null");
+        }
+        json.append('}');
+    }
+    json.append("}}");
+    REQUEST_TIMING_PHASE(request, TIMING_JSON);
+    if (snapshot.Error[0] != 0) {
+        LOG_ERROR("request failed", snapshot.Error);
+        countHttpError(snapshot.Error);
+    }
+    sendSnapshotJson(request, 200, json, age);
+}
+
+void handleSnapshotRequest(HttpRequest *request) {
+    LOG_INFO("snapshot request for", request->pathArg(0));
+    serveSnapshot(request, PARTS_ALL, respondSnapshot);
+}
+
+static void respondSettingsPut(HttpRequest *request, const char* error) {
+    REQUEST_TIMING_HEADER(request);
+    if (error) {
+        LOG_ERROR("request failed", error);
+        sendJsonError(request, 500, error);
+        return;
+    }
+    request->send(200, "application/json", "{}");
+}
+
+void handleSettingsRequestPut(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
     String body;
     if (index == 0) body = "";
     body += String((const char*)data, len);
     if (index + len != total) return;
 
-    String mac = request->pathArg(0);
-    Serial.print("settings PUT request for ");
-    Serial.println(mac);
-    Serial.print("Received body: ");
-    Serial.println(body);
+    LOG_INFO("settings PUT request for", request->pathArg(0));
+    LOG_DEBUG("received body", body.c_str());
 
     ArduinoJson::JsonDocument doc;
     DeserializationError error = deserializeJson(doc, body);
     if (error) {
-        Serial.print("JSON parse failed: ");
-        Serial.println(error.c_str());
+        LOG_WARN("JSON parse failed", error.c_str());
         request->send(400, "application/json", "{\"Message\":\"Invalid JSON\"}");
         return;
     }
 
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
+    // PINs are 16 bit like in the Settings frame, values out of range must not wrap
+    long pin = 0;
+    if (doc["Values"]["DeviceMetadata"]["Password"].is<const char*>()) {
+        pin = doc["Values"]["DeviceMetadata"]["Password"].as<long>();
+    }
+    if (pin < 0 || pin > 0xFFFF) {
+        request->send(400, "application/json", "{\"Message\":\"Invalid password\"}");
+        return;
+    }
+
+    SettingsChange change = {(uint16_t)pin, -1, -1};
+    if (doc["Values"]["ChargingStatus"]["Charging"].is<bool>()) {
+        change.PauseCharging = doc["Values"]["ChargingStatus"]["Charging"].as<bool>() ? 0 : 1;
+    }
+    if (doc["Values"]["ChargingCurrent"]["Value"].is<float>() || 
+        doc["Values"]["ChargingCurrent"]["Value"].is<int>()) {
+        // same range as the pantabox API, anything else would wrap or be taken as "keep"
+        long current = doc["Values"]["ChargingCurrent"]["Value"].as<long>();
+        if (current < 6 || current > 32) {
+            request->send(400, "application/json", "{\"Message\":\"Invalid current value\"}");
+            return;
+        }
+        change.Current = current;
+    }
+    submitSettingsChange(request, change, respondSettingsPut);
+}
+
+void handleStatsRequest(HttpRequest *request) {
+    ArduinoJson::JsonDocument doc;
+    RefreshStats refreshStats;
+    getRefreshStats(refreshStats);
+    ArduinoJson::JsonObject refresh = doc["Refresh"].to<JsonObject>();
+    refresh["Started"] = refreshStats.Started;
+    refresh["Coalesced"] = refreshStats.Coalesced;
+    refresh["Merged"] = refreshStats.Merged;
+    refresh["Rejected"] = refreshStats.Rejected;
+    PrefetchStats prefetchStats;
+    getPrefetchStats(prefetchStats);
+    ArduinoJson::JsonObject prefetch = doc["Prefetch"].to<JsonObject>();
+    prefetch["Bursts"] = prefetchStats.Bursts;
+    prefetch["Prefetches"] = prefetchStats.Prefetches;
+    prefetch["Hits"] = prefetchStats.Hits;
+    prefetch["Shared"] = prefetchStats.Shared;
+    prefetch["Misses"] = prefetchStats.Misses;
+    prefetch["Wasted"] = prefetchStats.Wasted;
+    prefetch["CacheHits"] = prefetchStats.CacheHits;
+    prefetch["CacheMisses"] = prefetchStats.CacheMisses;
+    PushStats pushStats;
+    getPushStats(pushStats);
+    ArduinoJson::JsonObject push = doc["Push"].to<JsonObject>();
+    push["Subscribers"] = pushStats.Subscribers;
+    push["Messages"] = pushStats.Messages;
+    push["FullMessages"] = pushStats.FullMessages;
+    push["Merged"] = pushStats.Merged;
+    push["Unchanged"] = pushStats.Unchanged;
+    LogStats logStats;
+    getLogStats(logStats);
+    ArduinoJson::JsonObject logging = doc["Log"].to<JsonObject>();
+    logging["Written"] = logStats.Written;
+    logging["Dropped"] = logStats.Dropped;
+    ModbusStats modbusStats;
+    getModbusStats(modbusStats);
+    ArduinoJson::JsonObject modbus = doc["Modbus"].to<JsonObject>();
+    modbus["Requests"] = modbusStats.Requests;
+    modbus["Exceptions"] = modbusStats.Exceptions;
+    modbus["Writes"] = modbusStats.Writes;
+    modbus["MaxResponseUs"] = modbusStats.MaxResponseUs;
+    PhaseEnergyStats phaseEnergyStats;
+    getPhaseEnergyStats(phaseEnergyStats);
+    ArduinoJson::JsonObject phaseEnergy = doc["PhaseEnergy"].to<JsonObject>();
+    phaseEnergy["Samples"] = phaseEnergyStats.Samples;
+    phaseEnergy["Gaps"] = phaseEnergyStats.Gaps;
+    phaseEnergy["Sessions"] = phaseEnergyStats.Sessions;
+    phaseEnergy["Restored"] = phaseEnergyStats.Restored;
+    phaseEnergy["Saves"] = phaseEnergyStats.Saves;
+    phaseEnergy["SaveErrors"] = phaseEnergyStats.SaveErrors;
+    ArduinoJson::JsonObject cache = doc["Cache"].to<JsonObject>();
+    for (size_t route = 0; route < routeCount; ++route) {
+        HttpCacheStats cacheStats;
+        getHttpCacheStats(route, cacheStats);
+        uint32_t responses = cacheStats.Hits + cacheStats.Misses;
+        if (responses == 0) {
+            continue;
+        }
+        ArduinoJson::JsonObject routeCache = cache[routes[route].Pattern].to<JsonObject>();
+        routeCache["Hits"] = cacheStats.Hits;
+        routeCache["Misses"] = cacheStats.Misses;
+        routeCache["HitRatio"] = (float)cacheStats.Hits / responses;
+    }
+    ArduinoJson::JsonArray chargers = doc["Chargers"].to<JsonArray>();
+    int count = chargerCount();
+    for (int slot = 0; slot < count; ++slot) {
+        ChargerSnapshot snapshot;
+        PollerStats stats;
+        ConnectionStats connectionStats;
+        SchedulerStats schedulerStats;
+        SettingsStats settingsStats;
+        if (!copySnapshot(slot, snapshot) || !getPollerStats(slot, stats) ||
+            !getConnectionStats(slot, connectionStats) || !getSchedulerStats(slot, schedulerStats) ||
+            !getSettingsStats(slot, settingsStats)) {
+            continue;
+        }
+        ArduinoJson::JsonObject charger = chargers.add<JsonObject>();
+        charger["Address"] = snapshot.Address;
+        charger["Error"] = snapshot.Error;
+        ArduinoJson::JsonObject connection = charger["Connection"].to<JsonObject>();
+        connection["Connected"] = connectionStats.Connected;
+        connection["BackoffMs"] = connectionStats.BackoffMs;
+        connection["Connects"] = connectionStats.Connects;
+        connection["Discoveries"] = connectionStats.Discoveries;
+        connection["ConnectsLastHour"] = connectionStats.ConnectsLastHour;
+        connection["DiscoveriesLastHour"] = connectionStats.DiscoveriesLastHour;
+        ArduinoJson::JsonObject scheduler = charger["Scheduler"].to<JsonObject>();
+        scheduler["Priority"] = schedulerStats.Priority;
+        scheduler["IntervalMs"] = schedulerStats.IntervalMs;
+        scheduler["BudgetMs"] = schedulerStats.BudgetMs;
+        scheduler["Polls"] = schedulerStats.Polls;
+        scheduler["BudgetMisses"] = schedulerStats.BudgetMisses;
+        scheduler["AvgRefreshMs"] = schedulerStats.AvgRefreshMs;
+        scheduler["AvgWaitMs"] = schedulerStats.AvgWaitMs;
+        scheduler["MaxWaitMs"] = schedulerStats.MaxWaitMs;
+        scheduler["Jobs"] = schedulerStats.Jobs;
+        scheduler["AvgJobWaitMs"] = schedulerStats.AvgJobWaitMs;
+        scheduler["MaxJobWaitMs"] = schedulerStats.MaxJobWaitMs;
+        scheduler["AirtimeMs"] = schedulerStats.AirtimeMs;
+        ArduinoJson::JsonObject settings = charger["Settings"].to<JsonObject>();
+        settings["Requests"] = settingsStats.Requests;
+        settings["Suppressed"] = settingsStats.Suppressed;
+        settings["Coalesced"] = settingsStats.Coalesced;
+        settings["Writes"] = settingsStats.Writes;
+        settings["Confirmed"] = settingsStats.Confirmed;
+        settings["Mismatched"] = settingsStats.Mismatched;
+        ArduinoJson::JsonObject characteristics = charger["Characteristics"].to<JsonObject>();
+        for (int part = 0; part < PART_COUNT; ++part) {
+            ArduinoJson::JsonObject characteristic = characteristics[snapshotPartName((SnapshotPart)part)].to<JsonObject>();
+            characteristic["Subscribed"] = stats.Subscribed[part];
+            characteristic["Notifications"] = stats.Notifications[part];
+            characteristic["Reads"] = stats.Reads[part];
+        }
+    }
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
+}
+
+void handleLogRequest(HttpRequest *request) {
+    const String& since = request->queryArg("since");
+    // resuming from the end of this stream neither skips nor repeats a record
+    uint32_t end;
+    void* stream = openLogStream(since.isEmpty() ? 0 : (uint32_t)strtoul(since.c_str(), NULL, 10), end);
+    if (stream == NULL) {
+        sendJsonError(request, 503, "out of memory");
+        return;
+    }
+    char next[11];
+    snprintf(next, sizeof(next), "%lu", (unsigned long)end);
+    request->addHeader("X-Log-Next", next);
+    request->sendStream(200, "text/plain", fillLogStream, closeLogStream, stream);
+}
+
+void handleHistoryRequest(HttpRequest *request) {
+    HistoryResolution resolution = HISTORY_1MIN;
+    const String& resolutionArg = request->queryArg("resolution");
+    if (!resolutionArg.isEmpty() && !parseHistoryResolution(resolutionArg, resolution)) {
+        sendJsonError(request, 400, "invalid resolution");
         return;
     }
-    if (!connectToDevice(device)) {
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
+    const String& formatArg = request->queryArg("format");
+    if (!formatArg.isEmpty() && formatArg != "csv" && formatArg != "binary") {
+        sendJsonError(request, 400, "invalid format");
         return;
     }
+    HistoryFormat format = formatArg == "binary" ? HISTORY_BINARY : HISTORY_CSV;
+    long since = request->queryArg("since").toInt();
 
-    BLECharacteristic infoChar = device.characteristic(INFO_SERVICE);
-    if (!(infoChar && infoChar.canRead() && infoChar.read())) {
-        request->send(500, "application/json", "{\"Message\":\"Info characteristic read failed\"}");
+    // only chargers that are polled have a history, requests do not register new ones
+    void* stream = openHistoryStream(findCharger(request->pathArg(0)), resolution, max(since, 0L), format);
+    if (stream == NULL) {
+        sendJsonError(request, 404, "no history");
         return;
     }
-    Info info = convertInfo(infoChar.value());
+    request->sendStream(200, format == HISTORY_BINARY ? "application/octet-stream" : "text/csv",
+                        fillHistoryStream, closeHistoryStream, stream);
+}
 
-    uint8_t pin = 0;
-    if (doc["Values"]["DeviceMetadata"]["Password"].is<const char*>()) {
-        pin = doc["Values"]["DeviceMetadata"]["Password"].as<int>();
+void handleMetricsRequest(HttpRequest *request) {
+    // the text is only built on a scrape, so it is not kept in a static buffer
+    size_t size = metricsSize();
+    char* storage = new (std::nothrow) char[size];
+    if (storage == NULL) {
+        sendJsonError(request, 503, "out of memory");
+        return;
+    }
+    ResponseBuffer text(storage, size);
+    writeMetrics(text);
+    if (text.overflowed()) {
+        // a route got its first request while writing
+        sendJsonError(request, 503, "metrics changed, retry");
+    } else {
+        request->send(200, "text/plain; version=0.0.4", text.c_str(), text.length());
     }
+    delete[] storage;
+}
 
-    Settings setSettings = convertToSettings(info, pin);
-    if (doc["Values"]["ChargingStatus"]["Charging"].is<bool>()) {
-        setSettings.PauseCharging = doc["Values"]["ChargingStatus"]["Charging"].as<bool>() ? 0 : 1;
+void handleDevicesRequest(HttpRequest *request) {
+    static RegistryEntry entries[REGISTRY_CAPACITY];
+    int count = copyRegistry(entries, REGISTRY_CAPACITY);
+    unsigned long now = millis();
+
+    ArduinoJson::JsonDocument doc;
+    ArduinoJson::JsonArray devices = doc["Devices"].to<JsonArray>();
+    for (int i = 0; i < count; ++i) {
+        const RegistryEntry& entry = entries[i];
+        ArduinoJson::JsonObject device = devices.add<JsonObject>();
+        device["Address"] = entry.Address;
+        device["LocalName"] = entry.LocalName;
+        device["Rssi"] = entry.Rssi;
+        device["Connected"] = entry.Connected;
+        device["LastSeenMs"] = now - entry.LastSeen;
+        char advertisement[sizeof(entry.Advertisement) * 2 + 1];
+        for (int j = 0; j < entry.AdvertisementLength; ++j) {
+            sprintf(advertisement + j * 2, "%02x", entry.Advertisement[j]);
+        }
+        advertisement[entry.AdvertisementLength * 2] = 0;
+        device["Advertisement"] = advertisement;
     }
-    if (doc["Values"]["ChargingCurrent"]["Value"].is<float>() || 
-        doc["Values"]["ChargingCurrent"]["Value"].is<int>()) {
-        setSettings.Current = doc["Values"]["ChargingCurrent"]["Value"].as<int>();
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
+}
+
+void handlePriorityRequestPut(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    if (index + len != total) return;
+
+    ArduinoJson::JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, (const char*)data, len);
+    if (error || !doc["Priority"].is<int>()) {
+        request->send(400, "application/json", "{\"Message\":\"Invalid JSON\"}");
+        return;
     }
-    
-    BLECharacteristic settingsChar = device.characteristic(SETTINGS_SERVICE);
-    if (!(settingsChar && settingsChar.canWrite())) {
-        Serial.println("Settings characteristic not found or not writable");
-        request->send(500, "application/json", "{\"Message\":\"Settings characteristic not found or not writable\"}");
+    // validated before the charger is registered, an invalid request must not take a slot
+    int priority = doc["Priority"].as<int>();
+    if (priority < 0 || priority > SCHED_PRIORITY_MAX) {
+        request->send(400, "application/json", "{\"Message\":\"Invalid priority\"}");
         return;
     }
-    if (!settingsChar.writeValue((uint8_t*)&setSettings, sizeof(setSettings))) {
-        Serial.println("Failed to write settings");
-        request->send(500, "application/json", "{\"Message\":\"Failed to write settings\"}");
+    const char* slotError;
+    int slot = chargerSlot(request->pathArg(0), slotError);
+    if (slot < 0) {
+        sendJsonError(request, 404, slotError);
         return;
     }
+    setChargerPriority(slot, priority);
     request->send(200, "application/json", "{}");
 }
@@ -1,25 +1,144 @@
 #pragma once
 #include <ArduinoJson.h>
-#include <ESPAsyncWebServer.h>
+#include "http_request.h"
+#include "response_buffer.h"
+
+#include "ble_poller.h"
+#include "settings_shadow.h"
+#include "snapshot.h"
+
+/**
+ * @brief Sends the response of a request from a charger snapshot.
+ * @param request The request.
+ * @param snapshot The snapshot, Error is set if it is not usable.
+ * @param age The snapshot age in microseconds.
+ * @param context The context passed to serveSnapshot.
+ */
+typedef void (*SnapshotResponder)(HttpRequest *request, const ChargerSnapshot& snapshot, int64_t age,
+                                  const void* context);
+
+/**
+ * @brief Sends the response of a settings change.
+ * @param request The request.
+ * @param error Error message or NULL on success.
+ */
+typedef void (*WriteResponder)(HttpRequest *request, const char* error);
 
 /**
  * @brief Handles HTTP GET requests for measurements.
- * @param request The web server request pointer.
+ * @param request The request.
  */
-void handleMeasurementsRequest(AsyncWebServerRequest *request);
+void handleMeasurementsRequest(HttpRequest *request);
 
 /**
  * @brief Handles HTTP GET requests for settings.
- * @param request The web server request pointer.
+ * @param request The request.
+ */
+void handleSettingsRequest(HttpRequest *request);
+
+/**
+ * @brief Handles HTTP GET requests for all fields of all characteristics, each with its age.
+ *        Missing characteristics are read together in one BLE session.
+ * @param request The request.
  */
-void handleSettingsRequest(AsyncWebServerRequest *request);
+void handleSnapshotRequest(HttpRequest *request);
 
 /**
  * @brief Handles HTTP PUT requests to update settings.
- * @param request The web server request pointer.
+ * @param request The request.
  * @param data The data buffer received.
  * @param len The length of the data buffer.
  * @param index The index of the current data chunk.
  * @param total The total size of the data to be received.
  */
-void handleSettingsRequestPut(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+void handleSettingsRequestPut(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+
+/**
+ * @brief Handles HTTP GET requests for the BLE statistics of all polled chargers.
+ * @param request The request.
+ */
+void handleStatsRequest(HttpRequest *request);
+
+/**
+ * @brief Handles HTTP GET requests for the recorded measurements of a charger as CSV or binary stream.
+ *        Query parameters: resolution (1s, 1m or 15m), since (seconds) and format (csv or binary).
+ * @param request The request.
+ */
+void handleHistoryRequest(HttpRequest *request);
+
+/**
+ * @brief Handles HTTP GET requests for the BLE and HTTP latency histograms, error counters
+ *        and heap statistics in the Prometheus text format.
+ * @param request The request.
+ */
+void handleMetricsRequest(HttpRequest *request);
+
+/**
+ * @brief Handles HTTP GET requests for the log records still in the ring as text, one per line.
+ *        Query parameter: since (sequence number), X-Log-Next holds the value for the next request.
+ * @param request The request.
+ */
+void handleLogRequest(HttpRequest *request);
+
+/**
+ * @brief Handles HTTP GET requests for the devices found by the background scan.
+ * @param request The request.
+ */
+void handleDevicesRequest(HttpRequest *request);
+
+/**
+ * @brief Handles HTTP PUT requests to set the polling priority of a charger.
+ * @param request The request.
+ * @param data The data buffer received.
+ * @param len The length of the data buffer.
+ * @param index The index of the current data chunk.
+ * @param total The total size of the data to be received.
+ */
+void handlePriorityRequestPut(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+
+/**
+ * @brief Sends a JSON response with the age of the underlying snapshot as X-Snapshot-Age header.
+ *        A body that did not fit its buffer is answered with 500 instead of truncated JSON.
+ * @param request The request.
+ * @param code The HTTP status code.
+ * @param json The JSON body.
+ * @param age The snapshot age in microseconds, omitted if negative.
+ */
+void sendSnapshotJson(HttpRequest *request, int code, const ResponseBuffer& json, int64_t age);
+
+/**
+ * @brief Sends a JSON error response of the form {"Message":"..."}.
+ * @param request The request.
+ * @param code The HTTP status code.
+ * @param message The error message.
+ */
+void sendJsonError(HttpRequest *request, int code, const char* message);
+
+/**
+ * @brief Sends a 503 response with Retry-After header if the BLE job queue is full.
+ * @param request The request.
+ */
+void sendBusy(HttpRequest *request);
+
+/**
+ * @brief Responds to a request from the snapshot of the charger in path argument 0.
+ *        Without a usable snapshot the request is deferred and answered from the
+ *        poller task once a refresh finished. Only the missing or outdated parts are read.
+ *        Requests for a charger the registry did not see during its warm-up wait for it.
+ * @param request The request.
+ * @param parts Bitmask of SnapshotPart bits that are required.
+ * @param respond Sends the response from the snapshot.
+ * @param context Passed to respond, must outlive the request.
+ */
+void serveSnapshot(HttpRequest *request, uint8_t parts, SnapshotResponder respond, const void* context = NULL);
+
+/**
+ * @brief Queues a settings change for the charger in path argument 0.
+ *        Changes that match the known settings are answered immediately. Otherwise the request
+ *        is deferred and answered from the poller task once the (coalesced) settings were written.
+ *        Like snapshots, changes for a charger not seen yet wait for the registry warm-up.
+ * @param request The request.
+ * @param change The settings to change.
+ * @param respond Sends the response of the write.
+ */
+void submitSettingsChange(HttpRequest *request, const SettingsChange& change, WriteResponder respond);
@@ -0,0 +1,97 @@
+#pragma once
+#include <Arduino.h>
+
+struct BleAdvertisement {
+    char Address[18];
+    char LocalName[24];
+    int8_t Rssi;
+    uint8_t Length;
+    uint8_t Data[31];
+};
+
+/**
+ * @brief Called for every notification of a subscribed characteristic.
+ * @param address The MAC address of the peripheral.
+ * @param uuid The UUID of the characteristic.
+ * @param value The notified value.
+ * @param length Length of the value.
+ */
+typedef void (*BleNotifyHandler)(const char* address, const char* uuid, const uint8_t* value, size_t length);
+
+/**
+ * @brief Called when a peripheral disconnected.
+ * @param address The MAC address of the peripheral.
+ */
+typedef void (*BleDisconnectHandler)(const char* address);
+
+/**
+ * Thin interface of the BLE central role. Peripherals are addressed by their MAC address,
+ * the backend keeps the device handles. Except for the handler setters, all functions
+ * may only be called from the poller task.
+ */
+class BleCentral {
+public:
+    virtual ~BleCentral() {}
+
+    virtual void setNotifyHandler(BleNotifyHandler handler) = 0;
+    virtual void setDisconnectHandler(BleDisconnectHandler handler) = 0;
+
+    /**
+     * @brief Starts a passive scan.
+     * @param interval Scan interval in units of 0.625 ms.
+     * @param window Scan window in units of 0.625 ms.
+     * @return true if scanning.
+     */
+    virtual bool startScan(uint16_t interval, uint16_t window) = 0;
+    virtual void stopScan() = 0;
+
+    /**
+     * @brief Returns the next received advertisement.
+     * @param out Receives the advertisement.
+     * @return false if no advertisement is pending.
+     */
+    virtual bool available(BleAdvertisement& out) = 0;
+
+    /**
+     * @brief Connects to a peripheral that was seen by the scan.
+     * @param address The MAC address of the peripheral.
+     * @return true if connected.
+     */
+    virtual bool connect(const char* address) = 0;
+    virtual bool connected(const char* address) = 0;
+    virtual void disconnect(const char* address) = 0;
+    virtual bool discoverAttributes(const char* address) = 0;
+
+    /**
+     * @brief Subscribes to notifications of a characteristic.
+     * @return true if the characteristic supports notifications and was subscribed.
+     */
+    virtual bool subscribe(const char* address, const char* uuid) = 0;
+
+    /**
+     * @brief Reads a characteristic.
+     * @param address The MAC address of the peripheral.
+     * @param uuid The UUID of the characteristic.
+     * @param buffer Receives the value.
+     * @param size Size of the buffer.
+     * @return Length of the value or -1 if the read failed.
+     */
+    virtual int read(const char* address, const char* uuid, uint8_t* buffer, size_t size) = 0;
+
+    /**
+     * @brief Returns whether a characteristic exists and can be written.
+     */
+    virtual bool writable(const char* address, const char* uuid) = 0;
+    virtual bool write(const char* address, const char* uuid, const uint8_t* value, size_t length) = 0;
+
+    /**
+     * @brief Processes pending BLE events, e.g. disconnects and notifications.
+     */
+    virtual void poll() = 0;
+};
+
+/**
+ * @brief Returns the BLE central of the platform (ArduinoBLE on the ESP32, a fake on the native build).
+ * @return The BLE central.
+ */
+BleCentral& bleCentral();
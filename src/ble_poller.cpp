@@ -0,0 +1,336 @@
+#include "ble_poller.h"
+#include "ble_central.h"
+#include "ble_utils.h"
+#include "connection.h"
+#include "device_registry.h"
+#include "history.h"
+#include "log.h"
+#include "metrics.h"
+#include "modbus.h"
+#include "phase_energy.h"
+#include "push.h"
+#include "server_timing.h"
+#include "refresh.h"
+#include "scheduler.h"
+#include "settings_shadow.h"
+#include "snapshot.h"
+
+// Large enough for all characteristic values
+#define CHARACTERISTIC_BUFFER_SIZE 32
+
+static QueueHandle_t jobQueue = NULL;
+
+struct CharacteristicDef {
+    SnapshotPart Part;
+    const char* Uuid;
+    size_t Size;
+    const char* ReadError;
+};
+
+static const CharacteristicDef characteristics[PART_COUNT] = {
+    {PART_ENERGY, ENERGY_SERVICE, sizeof(Energy), "energy characteristic read failed"},
+    {PART_POWER, POWER_SERVICE, sizeof(Power), "power characteristic read failed"},
+    {PART_VOLTAGE_CURRENT, VOLTAGE_CURRENT_SERVICE, sizeof(VoltageCurrent), "voltage/current characteristic read failed"},
+    {PART_INFO, INFO_SERVICE, sizeof(Info), "info characteristic read failed"},
+};
+
+static PollerStats stats[MAX_CHARGERS];
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool storeValue(int slot, const CharacteristicDef& def, const uint8_t* data, size_t length) {
+    if (length < def.Size) {
+        return false;
+    }
+    switch (def.Part) {
+        case PART_ENERGY: {
+            Energy energy = convertEnergy(data);
+            storeSnapshot(slot, energy, reconcilePhaseEnergy(slot, energy));
+            break;
+        }
+        case PART_POWER: {
+            Power power = convertPower(data);
+            integratePhasePower(slot, power, snapshotNow());
+            storeSnapshot(slot, power);
+            recordHistory(slot, PART_POWER);
+            break;
+        }
+        case PART_VOLTAGE_CURRENT:
+            storeSnapshot(slot, convertVoltageCurrent(data));
+            recordHistory(slot, PART_VOLTAGE_CURRENT);
+            break;
+        case PART_INFO: {
+            Info info = convertInfo(data);
+            confirmSettings(slot, info);
+            storeSnapshot(slot, info);
+            break;
+        }
+        default:
+            return false;
+    }
+    markPushPending(slot, def.Part);
+    return true;
+}
+
+static void onCharacteristicUpdated(const char* address, const char* uuid, const uint8_t* value, size_t length) {
+    int slot = findCharger(address);
+    if (slot < 0) {
+        return;
+    }
+    for (const CharacteristicDef& def : characteristics) {
+        if (strcasecmp(uuid, def.Uuid) == 0) {
+            if (storeValue(slot, def, value, length)) {
+                portENTER_CRITICAL(&statsMux);
+                stats[slot].Notifications[def.Part]++;
+                portEXIT_CRITICAL(&statsMux);
+            }
+            return;
+        }
+    }
+}
+
+static void onConnectionEstablished(int slot, const char* address) {
+    for (const CharacteristicDef& def : characteristics) {
+        bool subscribed = bleCentral().subscribe(address, def.Uuid);
+        portENTER_CRITICAL(&statsMux);
+        stats[slot].Subscribed[def.Part] = subscribed;
+        portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+static const char* readParts(int slot, uint8_t parts, bool force) {
+    ChargerSnapshot snapshot;
+    if (!copySnapshot(slot, snapshot)) {
+        return "not found";
+    }
+    const char* error = acquireConnection(slot);
+    if (error) {
+        return error;
+    }
+
+    // subscribed characteristics are only read if no notification arrived for a while
+    PollerStats current;
+    getPollerStats(slot, current);
+    int64_t now = snapshotNow();
+    for (const CharacteristicDef& def : characteristics) {
+        if (!(parts & PART_BIT(def.Part))) {
+            continue;
+        }
+        bool notified = (snapshot.Valid & PART_BIT(def.Part)) &&
+            now - snapshot.ReadAt[def.Part] < NOTIFY_FALLBACK_MS * 1000LL;
+        if (!force && current.Subscribed[def.Part] && notified) {
+            continue;
+        }
+        uint8_t value[CHARACTERISTIC_BUFFER_SIZE];
+        int64_t start = snapshotNow();
+        int length = bleCentral().read(snapshot.Address, def.Uuid, value, sizeof(value));
+        int64_t duration = snapshotNow() - start;
+        recordBleLatency(BLE_OP_READ(def.Part), duration);
+        SESSION_TIMING(TIMING_READ(def.Part), duration);
+        if (length < 0) {
+            return def.ReadError;
+        }
+        TIMING_START(decodeStart);
+        bool stored = storeValue(slot, def, value, length);
+        SESSION_TIMING_SINCE(TIMING_DECODE, decodeStart);
+        if (!stored) {
+            return def.ReadError;
+        }
+        portENTER_CRITICAL(&statsMux);
+        stats[slot].Reads[def.Part]++;
+        portEXIT_CRITICAL(&statsMux);
+    }
+    return NULL;
+}
+
+static void pollCharger(int slot) {
+    const char* error = readParts(slot, PARTS_ALL, false);
+    if (error) {
+        countBleError(error);
+    }
+    setSnapshotError(slot, error ? error : "");
+}
+
+static const char* writeSettings(int slot, const SettingsChange& change) {
+    const char* error = acquireConnection(slot);
+    if (error) {
+        return error;
+    }
+    BleCentral& central = bleCentral();
+
+    // the settings frame is built from the snapshot, the charger is only read if it has no Info yet
+    ChargerSnapshot snapshot;
+    if (!copySnapshot(slot, snapshot)) {
+        return "not found";
+    }
+    Info info = snapshot.InfoData;
+    if (!(snapshot.Valid & PART_BIT(PART_INFO))) {
+        uint8_t value[CHARACTERISTIC_BUFFER_SIZE];
+        int64_t start = snapshotNow();
+        int length = central.read(snapshot.Address, INFO_SERVICE, value, sizeof(value));
+        int64_t duration = snapshotNow() - start;
+        recordBleLatency(BLE_OP_READ(PART_INFO), duration);
+        SESSION_TIMING(TIMING_READ_INFO, duration);
+        if (length < (int)sizeof(Info)) {
+            return "Info characteristic read failed";
+        }
+        info = convertInfo(value);
+        storeSnapshot(slot, info);
+    }
+
+    Settings setSettings = convertToSettings(info, change.Pin);
+    if (change.PauseCharging >= 0) {
+        setSettings.PauseCharging = change.PauseCharging;
+    }
+    if (change.Current >= 0) {
+        setSettings.Current = change.Current;
+    }
+
+    if (!central.writable(snapshot.Address, SETTINGS_SERVICE)) {
+        return "Settings characteristic not found or not writable";
+    }
+    uint8_t payload[sizeof(Settings)];
+    encodeWire(setSettings, payload);
+    int64_t start = snapshotNow();
+    bool written = central.write(snapshot.Address, SETTINGS_SERVICE, payload, sizeof(payload));
+    int64_t duration = snapshotNow() - start;
+    recordBleLatency(BLE_OP_WRITE_SETTINGS, duration);
+    SESSION_TIMING(TIMING_WRITE, duration);
+    if (!written) {
+        return "Failed to write settings";
+    }
+    return NULL;
+}
+
+static void executeJob(const BleJob& job) {
+    jobStarted(job.Slot, millis() - job.QueuedAt);
+    SESSION_TIMING_BEGIN();
+    const char* error;
+    switch (job.Type) {
+        case JOB_REFRESH:
+            error = readParts(job.Slot, refreshParts(job.Flight), true);
+            if (error) {
+                countBleError(error);
+            }
+            setSnapshotError(job.Slot, error ? error : "");
+            completeRefresh(job.Flight, error);
+            break;
+    }
+}
+
+static void writeDueSettings() {
+    int slot;
+    PendingSettings pending;
+    while (takeDueSettings(millis(), slot, pending)) {
+        SESSION_TIMING_BEGIN();
+        const char* error = writeSettings(slot, pending.Change);
+        if (error) {
+            countBleError(error);
+        }
+        settingsWritten(slot, pending.Change, error);
+        for (uint8_t i = 0; i < pending.Waiters; ++i) {
+            if (pending.Callbacks[i]) {
+                pending.Callbacks[i](pending.Contexts[i], error);
+            }
+        }
+    }
+}
+
+// A slot is released once nobody asked for its charger for CHARGER_IDLE_EXPIRY_US, or once the
+// charger was not read for CHARGER_UNREACHABLE_EXPIRY_US and the registry no longer sees it.
+// Slots with a refresh or settings write in flight are kept until it finished.
+static bool chargerExpired(const ChargerSnapshot& snapshot, int64_t now) {
+    if (now - snapshot.RequestedAt > CHARGER_IDLE_EXPIRY_US) {
+        return true;
+    }
+    int64_t lastRead = snapshot.RegisteredAt;
+    for (int part = 0; part < PART_COUNT; ++part) {
+        if ((snapshot.Valid & PART_BIT(part)) && snapshot.ReadAt[part] > lastRead) {
+            lastRead = snapshot.ReadAt[part];
+        }
+    }
+    return now - lastRead > CHARGER_UNREACHABLE_EXPIRY_US && !lookupDevice(snapshot.Address);
+}
+
+static void expireChargers() {
+    int64_t now = snapshotNow();
+    for (int slot = 0; slot < chargerCount(); ++slot) {
+        ChargerSnapshot snapshot;
+        if (!copySnapshot(slot, snapshot) || !chargerExpired(snapshot, now) || refreshActive(slot) ||
+            !releaseSettings(slot)) {
+            continue;
+        }
+        // the state of the slot is reset before the slot is freed, so a charger registered
+        // right after starts clean; a request in between only loses statistics
+        releaseConnection(slot, snapshot.Address);
+        releaseSchedule(slot);
+        releasePushState(slot);
+        releasePhaseEnergy(slot);
+        releaseHistory(slot);
+        releaseModbusUnit(slot);
+        portENTER_CRITICAL(&statsMux);
+        memset(&stats[slot], 0, sizeof(stats[slot]));
+        portEXIT_CRITICAL(&statsMux);
+        if (releaseCharger(slot, snapshot.RequestedAt)) {
+            LOG_INFO("charger released", snapshot.Address);
+        }
+    }
+}
+
+bool enqueueBleJob(const BleJob& job) {
+    BleJob queued = job;
+    queued.QueuedAt = millis();
+    return jobQueue != NULL && xQueueSend(jobQueue, &queued, 0) == pdTRUE;
+}
+
+bool getPollerStats(int slot, PollerStats& out) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return false;
+    }
+    portENTER_CRITICAL(&statsMux);
+    out = stats[slot];
+    portEXIT_CRITICAL(&statsMux);
+    return true;
+}
+
+static void pollerTask(void* parameter) {
+    BleJob job;
+    unsigned long expiryCheckAt = millis();
+    startRegistryScan();
+    for (;;) {
+        // queued jobs are served between the polls of two chargers, a charger that missed
+        // its latency budget is polled before the rest of the queue
+        while (!chargerOverdue(millis()) && xQueueReceive(jobQueue, &job, 0) == pdTRUE) {
+            executeJob(job);
+        }
+        writeDueSettings();
+
+        unsigned long waitMs;
+        unsigned long start = millis();
+        int slot = nextChargerDue(start, waitMs);
+        if (slot >= 0) {
+            pollCharger(slot);
+            ChargerSnapshot snapshot;
+            copySnapshot(slot, snapshot);
+            chargerPolled(slot, start, millis(), snapshot.PowerData.CPSignal);
+        } else if (xQueueReceive(jobQueue, &job, pdMS_TO_TICKS(min(waitMs, 10UL))) == pdTRUE) {
+            executeJob(job);
+        }
+
+        // keep processing BLE events (e.g. disconnects) and advertisements
+        bleCentral().poll();
+        updateRegistry();
+        servicePush(millis());
+        servicePhaseEnergy(millis());
+        if (millis() - expiryCheckAt >= CHARGER_EXPIRY_CHECK_MS) {
+            expiryCheckAt = millis();
+            expireChargers();
+        }
+    }
+}
+
+void startBlePoller() {
+    jobQueue = xQueueCreate(BLE_JOB_QUEUE_DEPTH, sizeof(BleJob));
+    bleCentral().setNotifyHandler(onCharacteristicUpdated);
+    initConnections(onConnectionEstablished);
+    xTaskCreatePinnedToCore(pollerTask, "ble_poller", 8192, NULL, 1, NULL, 1);
+}
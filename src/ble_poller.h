@@ -0,0 +1,66 @@
+#pragma once
+#include <Arduino.h>
+
+#include "snapshot.h"
+
+// Subscribed characteristics are read if no notification arrived within this time
+#ifndef NOTIFY_FALLBACK_MS
+#define NOTIFY_FALLBACK_MS 10000
+#endif
+
+// Maximum number of BLE jobs waiting for the poller task
+#ifndef BLE_JOB_QUEUE_DEPTH
+#define BLE_JOB_QUEUE_DEPTH 8
+#endif
+
+// Interval in which idle and unreachable chargers are released
+#ifndef CHARGER_EXPIRY_CHECK_MS
+#define CHARGER_EXPIRY_CHECK_MS 10000
+#endif
+
+struct PollerStats {
+    bool Subscribed[PART_COUNT];
+    uint32_t Notifications[PART_COUNT];
+    uint32_t Reads[PART_COUNT];
+};
+
+enum BleJobType {
+    JOB_REFRESH
+};
+
+/**
+ * @brief Called by the poller task once a job finished.
+ * @param context The context passed with the job.
+ * @param error Static error message or NULL on success.
+ */
+typedef void (*BleJobCallback)(void* context, const char* error);
+
+struct BleJob {
+    BleJobType Type;
+    int Slot;
+    int Flight;
+    BleJobCallback Callback;
+    void* Context;
+    unsigned long QueuedAt;
+};
+
+/**
+ * @brief Starts the background task that keeps the snapshots of all registered chargers fresh,
+ *        executes queued BLE jobs and pending settings writes. All BLE access happens in this task.
+ */
+void startBlePoller();
+
+/**
+ * @brief Queues a job for the poller task without blocking.
+ * @param job The job to execute.
+ * @return true if the job was queued, false if the queue is full.
+ */
+bool enqueueBleJob(const BleJob& job);
+
+/**
+ * @brief Returns how the characteristics of a charger slot are delivered.
+ * @param slot The charger slot.
+ * @param out Stats to copy into.
+ * @return true if the slot is valid, false otherwise.
+ */
+bool getPollerStats(int slot, PollerStats& out);
@@ -1,8 +1,8 @@
 #pragma once
-#include <ArduinoBLE.h>
-#include <map>
 #include <Arduino.h>
 
+#include "wire_schema.h"
+
 // UUIDs for characteristic
 #define ENERGY_SERVICE "0379e580-ad1b-11e4-8bdd-0002a5d6b15d"
 #define POWER_SERVICE "fd005380-b065-11e4-9ce2-0002a5d6b15d"
@@ -69,52 +69,88 @@ struct __attribute__((packed)) Settings {
     uint8_t PadTail[5];
 };
 
-/**
- * @brief Scans for a BLE device with the specified MAC address.
- * @param targetAddress The MAC address of the target BLE device.
- * @return BLEDevice object if found, otherwise an invalid BLEDevice.
- */
-BLEDevice scanForTargetDevice(const String& targetAddress);
+// Wire layouts of the characteristics, all multi-byte fields are big-endian
+WIRE_SCHEMA(Energy,
+    WIRE_FIELD(Energy, TotalEnergy),
+    WIRE_FIELD(Energy, EnergyLastCharge),
+    WIRE_FIELD(Energy, Energy2ndLastCharge),
+    WIRE_FIELD(Energy, Energy3rdLastCharge),
+    WIRE_FIELD(Energy, ChargingEnergyLimit));
 
-/**
- * @brief Connects to the specified BLE device.
- * @param device Reference to the BLEDevice to connect to.
- * @return true if connection is successful, false otherwise.
- */
-bool connectToDevice(BLEDevice& device);
+WIRE_SCHEMA(Power,
+    WIRE_FIELD(Power, TotalPower),
+    WIRE_FIELD(Power, L1),
+    WIRE_FIELD(Power, L2),
+    WIRE_FIELD(Power, L3),
+    WIRE_FIELD(Power, PeakPower),
+    WIRE_FIELD(Power, Frequency),
+    WIRE_FIELD(Power, Temperature),
+    WIRE_FIELD(Power, RemainingDistance),
+    WIRE_FIELD(Power, Costs),
+    WIRE_FIELD(Power, CPSignal));
+
+WIRE_SCHEMA(VoltageCurrent,
+    WIRE_FIELD(VoltageCurrent, VoltageL1),
+    WIRE_FIELD(VoltageCurrent, VoltageL2),
+    WIRE_FIELD(VoltageCurrent, VoltageL3),
+    WIRE_FIELD(VoltageCurrent, CurrentL1),
+    WIRE_FIELD(VoltageCurrent, CurrentL2),
+    WIRE_FIELD(VoltageCurrent, CurrentL3));
+
+WIRE_SCHEMA(Info,
+    WIRE_FIELD(Info, Current),
+    WIRE_FIELD(Info, KWhPer100),
+    WIRE_FIELD(Info, AmountPerKWh),
+    WIRE_FIELD(Info, FIEnabled),
+    WIRE_FIELD(Info, ErrorCode),
+    WIRE_FIELD(Info, Efficiency),
+    WIRE_FIELD(Info, ChargingActive),
+    WIRE_FIELD(Info, PauseCharging),
+    WIRE_FIELD(Info, ChargingCurrentMax),
+    WIRE_FIELD(Info, BLETransmissionPower));
+
+WIRE_SCHEMA(Settings,
+    WIRE_FIELD(Settings, PIN),
+    WIRE_FIELD(Settings, Current),
+    WIRE_FIELD(Settings, ChargingEnergyLimit),
+    WIRE_FIELD(Settings, KWhPer100),
+    WIRE_FIELD(Settings, AmountPerKWh),
+    WIRE_FIELD(Settings, Efficiency),
+    WIRE_FIELD(Settings, PauseCharging),
+    WIRE_FIELD(Settings, BLETransmissionPower));
 
 /**
  * @brief Converts a byte array to an Energy struct.
- * @param data Pointer to the byte array containing energy data.
+ * @param data Pointer to the byte array containing energy data, it is not modified.
  * @return Energy struct with parsed values.
  */
 Energy convertEnergy(const uint8_t* data);
 
 /**
  * @brief Converts a byte array to a Power struct.
- * @param data Pointer to the byte array containing power data.
+ * @param data Pointer to the byte array containing power data, it is not modified.
  * @return Power struct with parsed values.
  */
 Power convertPower(const uint8_t* data);
 
 /**
  * @brief Converts a byte array to a VoltageCurrent struct.
- * @param data Pointer to the byte array containing voltage and current data.
+ * @param data Pointer to the byte array containing voltage and current data, it is not modified.
  * @return VoltageCurrent struct with parsed values.
  */
 VoltageCurrent convertVoltageCurrent(const uint8_t* data);
 
 /**
  * @brief Converts a byte array to an Info struct.
- * @param data Pointer to the byte array containing info data.
+ * @param data Pointer to the byte array containing info data, it is not modified.
  * @return Info struct with parsed values.
  */
 Info convertInfo(const uint8_t* data);
 
 /**
- * @brief Converts Info struct and PIN to a Settings struct.
+ * @brief Converts Info struct and PIN to a Settings struct, encode it with encodeWire before writing.
  * @param info Reference to the Info struct.
  * @param pin The PIN code to use for settings.
  * @return Settings struct with values set from Info and PIN.
  */
-Settings convertToSettings(Info& info, uint16_t pin);
+Settings convertToSettings(const Info& info, uint16_t pin);
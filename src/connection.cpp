@@ -0,0 +1,180 @@
+#include "connection.h"
+#include "ble_central.h"
+#include "device_registry.h"
+#include "metrics.h"
+#include "server_timing.h"
+#include "snapshot.h"
+
+#define HOUR_BUCKETS 12
+#define HOUR_BUCKET_MS (3600000UL / HOUR_BUCKETS)
+
+// Event counter over a sliding window of one hour
+struct HourlyCounter {
+    uint32_t Total;
+    uint32_t Period;
+    uint32_t Buckets[HOUR_BUCKETS];
+};
+
+struct Connection {
+    bool Discovered;
+    uint32_t BackoffMs;
+    unsigned long NextAttempt;
+    HourlyCounter Connects;
+    HourlyCounter Discoveries;
+};
+
+static Connection connections[MAX_CHARGERS];
+static ConnectionHandler establishedHandler = NULL;
+static portMUX_TYPE connectionMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void advanceCounter(HourlyCounter& counter, uint32_t period) {
+    if (period - counter.Period >= HOUR_BUCKETS) {
+        memset(counter.Buckets, 0, sizeof(counter.Buckets));
+    } else {
+        for (uint32_t p = counter.Period + 1; p != period + 1; ++p) {
+            counter.Buckets[p % HOUR_BUCKETS] = 0;
+        }
+    }
+    counter.Period = period;
+}
+
+static void countEvent(HourlyCounter& counter) {
+    portENTER_CRITICAL(&connectionMux);
+    advanceCounter(counter, millis() / HOUR_BUCKET_MS);
+    counter.Buckets[counter.Period % HOUR_BUCKETS]++;
+    counter.Total++;
+    portEXIT_CRITICAL(&connectionMux);
+}
+
+static uint32_t countLastHour(HourlyCounter counter) {
+    advanceCounter(counter, millis() / HOUR_BUCKET_MS);
+    uint32_t sum = 0;
+    for (uint32_t bucket : counter.Buckets) {
+        sum += bucket;
+    }
+    return sum;
+}
+
+static void backoff(Connection& connection) {
+    if (connection.BackoffMs == 0) {
+        connection.BackoffMs = RECONNECT_BACKOFF_MIN_MS;
+    } else {
+        connection.BackoffMs = min(connection.BackoffMs * 2, (uint32_t)RECONNECT_BACKOFF_MAX_MS);
+    }
+    connection.NextAttempt = millis() + connection.BackoffMs;
+}
+
+static void onDisconnected(const char* address) {
+    int slot = findCharger(address);
+    if (slot >= 0) {
+        connections[slot].Discovered = false;
+    }
+    setDeviceConnected(address, false);
+}
+
+void initConnections(ConnectionHandler onEstablished) {
+    establishedHandler = onEstablished;
+    bleCentral().setDisconnectHandler(onDisconnected);
+}
+
+const char* acquireConnection(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return "not found";
+    }
+    ChargerSnapshot snapshot;
+    if (!copySnapshot(slot, snapshot)) {
+        return "not found";
+    }
+    BleCentral& central = bleCentral();
+    Connection& connection = connections[slot];
+    if (connection.Discovered) {
+        if (central.connected(snapshot.Address)) {
+            return NULL;
+        }
+        // disconnect without event
+        connection.Discovered = false;
+    }
+    if (connection.BackoffMs > 0 && (long)(millis() - connection.NextAttempt) < 0) {
+        return "connect failed";
+    }
+
+    if (!lookupDevice(snapshot.Address)) {
+        return "not found";
+    }
+    if (!central.connected(snapshot.Address)) {
+        countEvent(connection.Connects);
+        stopRegistryScan();
+        int64_t start = snapshotNow();
+        bool connected = central.connect(snapshot.Address);
+        int64_t duration = snapshotNow() - start;
+        recordBleLatency(BLE_OP_CONNECT, duration);
+        SESSION_TIMING(TIMING_CONNECT, duration);
+        startRegistryScan();
+        if (!connected) {
+            backoff(connection);
+            return "connect failed";
+        }
+    }
+
+    int retries = 3;
+    bool discovered = false;
+    for (int i = 0; i < retries; ++i) {
+        countEvent(connection.Discoveries);
+        int64_t start = snapshotNow();
+        bool success = central.discoverAttributes(snapshot.Address);
+        int64_t duration = snapshotNow() - start;
+        recordBleLatency(BLE_OP_DISCOVER, duration);
+        SESSION_TIMING(TIMING_DISCOVER, duration);
+        if (success) {
+            discovered = true;
+            break;
+        } else {
+            delay(100);
+        }
+    }
+    if (!discovered) {
+        central.disconnect(snapshot.Address);
+        backoff(connection);
+        return "discovery failed";
+    }
+
+    connection.Discovered = true;
+    setDeviceConnected(snapshot.Address, true);
+    connection.BackoffMs = 0;
+    if (establishedHandler) {
+        establishedHandler(slot, snapshot.Address);
+    }
+    return NULL;
+}
+
+void releaseConnection(int slot, const char* address) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    BleCentral& central = bleCentral();
+    if (central.connected(address)) {
+        central.disconnect(address);
+        setDeviceConnected(address, false);
+    }
+    portENTER_CRITICAL(&connectionMux);
+    memset(&connections[slot], 0, sizeof(connections[slot]));
+    portEXIT_CRITICAL(&connectionMux);
+}
+
+bool getConnectionStats(int slot, ConnectionStats& out) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return false;
+    }
+    Connection& connection = connections[slot];
+    portENTER_CRITICAL(&connectionMux);
+    HourlyCounter connects = connection.Connects;
+    HourlyCounter discoveries = connection.Discoveries;
+    portEXIT_CRITICAL(&connectionMux);
+    out.Connected = connection.Discovered;
+    out.BackoffMs = connection.BackoffMs;
+    out.Connects = connects.Total;
+    out.Discoveries = discoveries.Total;
+    out.ConnectsLastHour = countLastHour(connects);
+    out.DiscoveriesLastHour = countLastHour(discoveries);
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+
+// Delay before the first reconnect attempt after a failed connect
+#ifndef RECONNECT_BACKOFF_MIN_MS
+#define RECONNECT_BACKOFF_MIN_MS 1000
+#endif
+
+// Upper bound of the exponential reconnect backoff
+#ifndef RECONNECT_BACKOFF_MAX_MS
+#define RECONNECT_BACKOFF_MAX_MS 60000
+#endif
+
+struct ConnectionStats {
+    bool Connected;
+    uint32_t BackoffMs;
+    uint32_t Connects;
+    uint32_t Discoveries;
+    uint32_t ConnectsLastHour;
+    uint32_t DiscoveriesLastHour;
+};
+
+/**
+ * @brief Called after a connection was established and its attributes were discovered.
+ * @param slot The charger slot.
+ * @param address The MAC address of the connected device.
+ */
+typedef void (*ConnectionHandler)(int slot, const char* address);
+
+/**
+ * @brief Registers the BLE event handlers used to detect disconnects.
+ * @param onEstablished Called for every newly established connection.
+ */
+void initConnections(ConnectionHandler onEstablished);
+
+/**
+ * @brief Returns the long-lived connection of a charger slot.
+ *        Attributes are discovered once per connection. If the charger is not connected,
+ *        a reconnect is attempted unless the slot is still in its backoff period.
+ * @param slot The charger slot.
+ * @return Error message or NULL if the device is connected.
+ */
+const char* acquireConnection(int slot);
+
+/**
+ * @brief Disconnects a charger whose slot is released and resets the state of the slot.
+ *        Only called by the poller task.
+ * @param slot The charger slot.
+ * @param address The MAC address of the charger.
+ */
+void releaseConnection(int slot, const char* address);
+
+/**
+ * @brief Returns the connection statistics of a charger slot.
+ * @param slot The charger slot.
+ * @param out Stats to copy into.
+ * @return true if the slot is valid, false otherwise.
+ */
+bool getConnectionStats(int slot, ConnectionStats& out);
@@ -0,0 +1,272 @@
+#include "device_registry.h"
+#include "ble_central.h"
+#include "metrics.h"
+#include "snapshot.h"
+
+// Number of slots probed for an address, bounds lookups and inserts
+#define REGISTRY_PROBES 4
+
+static RegistryEntry entries[REGISTRY_CAPACITY];
+static uint64_t keys[REGISTRY_CAPACITY];
+static uint64_t requestedKeys[REGISTRY_REQUESTS];
+static unsigned long requestedAt[REGISTRY_REQUESTS];
+static int nextRequest = 0;
+static bool scanning = false;
+// time the first scan was attempted, 0 before
+static unsigned long firstScanAt = 0;
+
+struct DeviceWaiter {
+    uint64_t Key;
+    DeviceWaitCallback Callback;
+    void* Context;
+    // the wait ends REGISTRY_WARMUP_MS after it started, also if the warm-up does not
+    unsigned long Since;
+};
+
+static DeviceWaiter waiters[REGISTRY_WAITERS];
+static portMUX_TYPE registryMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint64_t parseAddress(const char* address) {
+    uint64_t key = 0;
+    int digits = 0;
+    for (const char* c = address; *c; ++c) {
+        int value;
+        if (*c >= '0' && *c <= '9') {
+            value = *c - '0';
+        } else if (*c >= 'a' && *c <= 'f') {
+            value = *c - 'a' + 10;
+        } else if (*c >= 'A' && *c <= 'F') {
+            value = *c - 'A' + 10;
+        } else if (*c == ':') {
+            continue;
+        } else {
+            return 0;
+        }
+        key = (key << 4) | value;
+        digits++;
+    }
+    // an unused slot has key 0, so 0 doubles as invalid address
+    return digits == 12 ? key : 0;
+}
+
+static unsigned int hashAddress(uint64_t key) {
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (REGISTRY_CAPACITY - 1);
+}
+
+static bool expired(const RegistryEntry& entry, unsigned long now) {
+    return !entry.Connected && now - entry.LastSeen > REGISTRY_EXPIRY_MS;
+}
+
+static int findLocked(uint64_t key) {
+    unsigned int index = hashAddress(key);
+    for (int i = 0; i < REGISTRY_PROBES; ++i) {
+        unsigned int slot = (index + i) & (REGISTRY_CAPACITY - 1);
+        if (keys[slot] == key) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+// returns the slot of the address, a free slot or the least recently seen slot
+static int insertSlotLocked(uint64_t key) {
+    unsigned int index = hashAddress(key);
+    int oldest = -1;
+    for (int i = 0; i < REGISTRY_PROBES; ++i) {
+        unsigned int slot = (index + i) & (REGISTRY_CAPACITY - 1);
+        if (keys[slot] == key || keys[slot] == 0) {
+            return slot;
+        }
+        if (entries[slot].Connected) {
+            continue;
+        }
+        if (oldest < 0 || (long)(entries[slot].LastSeen - entries[oldest].LastSeen) < 0) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+static bool requestedLocked(uint64_t key, unsigned long now) {
+    for (int i = 0; i < REGISTRY_REQUESTS; ++i) {
+        if (requestedKeys[i] == key && now - requestedAt[i] <= REGISTRY_EXPIRY_MS) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void startRegistryScan() {
+    if (scanning) {
+        return;
+    }
+    // the warm-up runs from the first attempt, a radio that never scans must not keep it going
+    if (firstScanAt == 0) {
+        portENTER_CRITICAL(&registryMux);
+        firstScanAt = max(millis(), 1UL);
+        portEXIT_CRITICAL(&registryMux);
+    }
+    int64_t start = snapshotNow();
+    scanning = bleCentral().startScan(REGISTRY_SCAN_INTERVAL, REGISTRY_SCAN_WINDOW);
+    recordBleLatency(BLE_OP_SCAN, snapshotNow() - start);
+}
+
+void stopRegistryScan() {
+    if (!scanning) {
+        return;
+    }
+    bleCentral().stopScan();
+    scanning = false;
+}
+
+// before the poller attempted a scan the warm-up is counted from boot; the difference is signed
+// because firstScanAt is rounded up to 1 ms when the scan starts right at boot
+static bool warmingUpLocked(unsigned long now) {
+    return firstScanAt == 0 ? now < REGISTRY_WARMUP_MS : (long)(now - firstScanAt) < REGISTRY_WARMUP_MS;
+}
+
+// Calls back the waiters whose device was seen or whose wait ended, outside of the lock
+static void serviceWaiters() {
+    for (int i = 0; i < REGISTRY_WAITERS; ++i) {
+        portENTER_CRITICAL(&registryMux);
+        // read under the lock, a waiter added in between must not look older than the time
+        unsigned long now = millis();
+        DeviceWaiter waiter = waiters[i];
+        bool done = waiter.Key != 0 && (!warmingUpLocked(now) || now - waiter.Since >= REGISTRY_WARMUP_MS ||
+                                        findLocked(waiter.Key) >= 0);
+        if (done) {
+            waiters[i].Key = 0;
+        }
+        portEXIT_CRITICAL(&registryMux);
+        if (done) {
+            waiter.Callback(waiter.Context);
+        }
+    }
+}
+
+void updateRegistry() {
+    BleAdvertisement advertisement;
+    while (scanning && bleCentral().available(advertisement)) {
+        uint64_t key = parseAddress(advertisement.Address);
+        if (key == 0) {
+            continue;
+        }
+        if (strncmp(advertisement.LocalName, NRGKICK_NAME_PREFIX, strlen(NRGKICK_NAME_PREFIX)) != 0 &&
+            findCharger(advertisement.Address) < 0) {
+            portENTER_CRITICAL(&registryMux);
+            bool requested = requestedLocked(key, millis());
+            portEXIT_CRITICAL(&registryMux);
+            if (!requested) {
+                continue;
+            }
+        }
+
+        RegistryEntry entry = {};
+        strlcpy(entry.Address, advertisement.Address, sizeof(entry.Address));
+        strlcpy(entry.LocalName, advertisement.LocalName, sizeof(entry.LocalName));
+        entry.Rssi = advertisement.Rssi;
+        entry.LastSeen = millis();
+        entry.AdvertisementLength = advertisement.Length;
+        memcpy(entry.Advertisement, advertisement.Data, advertisement.Length);
+
+        portENTER_CRITICAL(&registryMux);
+        int slot = insertSlotLocked(key);
+        if (slot >= 0) {
+            entry.Connected = keys[slot] == key && entries[slot].Connected;
+            if (keys[slot] == key && entry.LocalName[0] == 0) {
+                // names are often only part of the scan response
+                strcpy(entry.LocalName, entries[slot].LocalName);
+            }
+            keys[slot] = key;
+            entries[slot] = entry;
+        }
+        portEXIT_CRITICAL(&registryMux);
+    }
+    serviceWaiters();
+}
+
+bool lookupDevice(const char* address) {
+    uint64_t key = parseAddress(address);
+    if (key == 0) {
+        return false;
+    }
+    portENTER_CRITICAL(&registryMux);
+    int slot = findLocked(key);
+    if (slot >= 0 && expired(entries[slot], millis())) {
+        slot = -1;
+    }
+    portEXIT_CRITICAL(&registryMux);
+    return slot >= 0;
+}
+
+void requestDevice(const char* address) {
+    uint64_t key = parseAddress(address);
+    if (key == 0) {
+        return;
+    }
+    unsigned long now = millis();
+    portENTER_CRITICAL(&registryMux);
+    if (!requestedLocked(key, now)) {
+        requestedKeys[nextRequest] = key;
+        nextRequest = (nextRequest + 1) % REGISTRY_REQUESTS;
+    }
+    for (int i = 0; i < REGISTRY_REQUESTS; ++i) {
+        if (requestedKeys[i] == key) {
+            requestedAt[i] = now;
+        }
+    }
+    portEXIT_CRITICAL(&registryMux);
+}
+
+bool registryWarmingUp() {
+    portENTER_CRITICAL(&registryMux);
+    bool warmingUp = warmingUpLocked(millis());
+    portEXIT_CRITICAL(&registryMux);
+    return warmingUp;
+}
+
+bool waitForDevice(const char* address, DeviceWaitCallback callback, void* context) {
+    uint64_t key = parseAddress(address);
+    if (key == 0) {
+        return false;
+    }
+    bool waiting = false;
+    portENTER_CRITICAL(&registryMux);
+    for (int i = 0; i < REGISTRY_WAITERS && !waiting; ++i) {
+        if (waiters[i].Key == 0) {
+            waiters[i].Key = key;
+            waiters[i].Callback = callback;
+            waiters[i].Context = context;
+            waiters[i].Since = millis();
+            waiting = true;
+        }
+    }
+    portEXIT_CRITICAL(&registryMux);
+    return waiting;
+}
+
+void setDeviceConnected(const char* address, bool connected) {
+    uint64_t key = parseAddress(address);
+    if (key == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&registryMux);
+    int slot = findLocked(key);
+    if (slot >= 0) {
+        entries[slot].Connected = connected;
+        entries[slot].LastSeen = millis();
+    }
+    portEXIT_CRITICAL(&registryMux);
+}
+
+int copyRegistry(RegistryEntry* out, int max) {
+    int count = 0;
+    portENTER_CRITICAL(&registryMux);
+    for (int slot = 0; slot < REGISTRY_CAPACITY && count < max; ++slot) {
+        if (keys[slot] != 0) {
+            out[count++] = entries[slot];
+        }
+    }
+    portEXIT_CRITICAL(&registryMux);
+    return count;
+}
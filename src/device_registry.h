@@ -0,0 +1,123 @@
+#pragma once
+#include <Arduino.h>
+
+// Number of devices kept in the registry, must be a power of two
+#ifndef REGISTRY_CAPACITY
+#define REGISTRY_CAPACITY 16
+#endif
+
+// Devices that were not seen for this time are considered gone (unless connected)
+#ifndef REGISTRY_EXPIRY_MS
+#define REGISTRY_EXPIRY_MS 120000
+#endif
+
+// Devices with this local name prefix are registered without being requested
+#ifndef NRGKICK_NAME_PREFIX
+#define NRGKICK_NAME_PREFIX "NRGkick"
+#endif
+
+// Number of requested addresses whose advertisements are registered although they are not
+// named like an NRGkick; older requests are replaced
+#ifndef REGISTRY_REQUESTS
+#define REGISTRY_REQUESTS 4
+#endif
+
+// Time after the first scan started in which requests for a device that was not seen yet wait
+// for it instead of failing, covers a few scan intervals (in milliseconds)
+#ifndef REGISTRY_WARMUP_MS
+#define REGISTRY_WARMUP_MS 5000
+#endif
+
+// Number of requests that can wait for a device during the warm-up
+#ifndef REGISTRY_WAITERS
+#define REGISTRY_WAITERS 8
+#endif
+
+// Passive scan interval and window in units of 0.625 ms (default 1 s / 30 ms)
+#ifndef REGISTRY_SCAN_INTERVAL
+#define REGISTRY_SCAN_INTERVAL 0x0640
+#endif
+#ifndef REGISTRY_SCAN_WINDOW
+#define REGISTRY_SCAN_WINDOW 0x0030
+#endif
+
+struct RegistryEntry {
+    char Address[18];
+    char LocalName[24];
+    int8_t Rssi;
+    bool Connected;
+    unsigned long LastSeen;
+    uint8_t AdvertisementLength;
+    uint8_t Advertisement[31];
+};
+
+/**
+ * @brief Called once a device that was waited for was seen or the warm-up ended.
+ * @param context The context passed to waitForDevice.
+ */
+typedef void (*DeviceWaitCallback)(void* context);
+
+/**
+ * @brief Starts the low duty cycle passive background scan. Does nothing if already scanning.
+ */
+void startRegistryScan();
+
+/**
+ * @brief Stops the background scan, e.g. while a connection is established.
+ */
+void stopRegistryScan();
+
+/**
+ * @brief Moves received advertisements of NRGkick and requested devices into the registry
+ *        and calls back the waiters whose device was seen or whose wait ended.
+ */
+void updateRegistry();
+
+/**
+ * @brief Looks up a device that was seen recently or is connected.
+ * @param address The MAC address of the device.
+ * @return true if the device is known, false otherwise.
+ */
+bool lookupDevice(const char* address);
+
+/**
+ * @brief Registers the advertisements of a device for REGISTRY_EXPIRY_MS even if it is not
+ *        named like an NRGkick, so a request for it finds it once it was seen.
+ * @param address The MAC address of the device.
+ */
+void requestDevice(const char* address);
+
+/**
+ * @brief Tells if the registry may not have seen all devices yet, i.e. the first scan was attempted
+ *        less than REGISTRY_WARMUP_MS ago, or it was not attempted yet and the device booted less
+ *        than REGISTRY_WARMUP_MS ago.
+ * @return true while warming up.
+ */
+bool registryWarmingUp();
+
+/**
+ * @brief Waits for a device that was not seen yet. The callback is called exactly once from the
+ *        poller task, when the device was seen, at the end of the warm-up or at the latest
+ *        REGISTRY_WARMUP_MS after the wait started.
+ * @param address The MAC address of the device.
+ * @param callback Called when the wait ended.
+ * @param context Passed to the callback.
+ * @return false if too many requests are waiting, the callback is not called then.
+ */
+bool waitForDevice(const char* address, DeviceWaitCallback callback, void* context);
+
+/**
+ * @brief Marks a registered device as connected or disconnected.
+ *        Connected devices do not advertise and never expire.
+ * @param address The MAC address of the device.
+ * @param connected The connection state.
+ */
+void setDeviceConnected(const char* address, bool connected);
+
+/**
+ * @brief Copies the registry contents.
+ * @param out Array to copy into.
+ * @param max Size of the array.
+ * @return Number of copied entries.
+ */
+int copyRegistry(RegistryEntry* out, int max);
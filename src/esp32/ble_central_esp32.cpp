@@ -0,0 +1,177 @@
+#include <ArduinoBLE.h>
+#include <utility/HCI.h>
+
+#include "ble_central.h"
+
+// Number of scanned devices whose handles are kept for connecting
+#ifndef BLE_DEVICE_CACHE_SIZE
+#define BLE_DEVICE_CACHE_SIZE 16
+#endif
+
+struct CachedDevice {
+    char Address[18];
+    unsigned long LastUsed;
+    BLEDevice Device;
+};
+
+class ArduinoBleCentral : public BleCentral {
+public:
+    void setNotifyHandler(BleNotifyHandler handler) override {
+        notifyHandler = handler;
+    }
+
+    void setDisconnectHandler(BleDisconnectHandler handler) override {
+        disconnectHandler = handler;
+        BLE.setEventHandler(BLEDisconnected, onDisconnected);
+    }
+
+    bool startScan(uint16_t interval, uint16_t window) override {
+        // ArduinoBLE always scans actively with a full duty cycle, so the scan
+        // parameters are replaced by a passive scan with the given window
+        if (!BLE.scan(true)) {
+            return false;
+        }
+        HCI.leSetScanEnable(0x00, 0x00);
+        HCI.leSetScanParameters(0x00, interval, window, 0x00, 0x00);
+        HCI.leSetScanEnable(0x01, 0x00);
+        return true;
+    }
+
+    void stopScan() override {
+        BLE.stopScan();
+    }
+
+    bool available(BleAdvertisement& out) override {
+        BLEDevice device = BLE.available();
+        if (!device) {
+            return false;
+        }
+        String address = device.address();
+        strlcpy(out.Address, address.c_str(), sizeof(out.Address));
+        strlcpy(out.LocalName, device.hasLocalName() ? device.localName().c_str() : "", sizeof(out.LocalName));
+        out.Rssi = device.rssi();
+        out.Length = device.advertisementData(out.Data, sizeof(out.Data));
+        cache(address.c_str(), device);
+        return true;
+    }
+
+    bool connect(const char* address) override {
+        CachedDevice* cached = find(address);
+        return cached != NULL && (cached->Device.connected() || cached->Device.connect());
+    }
+
+    bool connected(const char* address) override {
+        CachedDevice* cached = find(address);
+        return cached != NULL && cached->Device.connected();
+    }
+
+    void disconnect(const char* address) override {
+        CachedDevice* cached = find(address);
+        if (cached != NULL) {
+            cached->Device.disconnect();
+        }
+    }
+
+    bool discoverAttributes(const char* address) override {
+        CachedDevice* cached = find(address);
+        return cached != NULL && cached->Device.discoverAttributes();
+    }
+
+    bool subscribe(const char* address, const char* uuid) override {
+        BLECharacteristic characteristic = lookup(address, uuid);
+        if (!(characteristic && characteristic.canSubscribe())) {
+            return false;
+        }
+        characteristic.setEventHandler(BLEUpdated, onUpdated);
+        return characteristic.subscribe();
+    }
+
+    int read(const char* address, const char* uuid, uint8_t* buffer, size_t size) override {
+        BLECharacteristic characteristic = lookup(address, uuid);
+        if (!(characteristic && characteristic.canRead() && characteristic.read())) {
+            return -1;
+        }
+        size_t length = min((size_t)characteristic.valueLength(), size);
+        memcpy(buffer, characteristic.value(), length);
+        return length;
+    }
+
+    bool writable(const char* address, const char* uuid) override {
+        BLECharacteristic characteristic = lookup(address, uuid);
+        return characteristic && characteristic.canWrite();
+    }
+
+    bool write(const char* address, const char* uuid, const uint8_t* value, size_t length) override {
+        BLECharacteristic characteristic = lookup(address, uuid);
+        return characteristic && characteristic.writeValue(value, length);
+    }
+
+    void poll() override {
+        BLE.poll();
+    }
+
+private:
+    static BleNotifyHandler notifyHandler;
+    static BleDisconnectHandler disconnectHandler;
+    CachedDevice devices[BLE_DEVICE_CACHE_SIZE];
+
+    static void onUpdated(BLEDevice device, BLECharacteristic characteristic) {
+        if (notifyHandler) {
+            notifyHandler(device.address().c_str(), characteristic.uuid(), characteristic.value(), characteristic.valueLength());
+        }
+    }
+
+    static void onDisconnected(BLEDevice device) {
+        if (disconnectHandler) {
+            disconnectHandler(device.address().c_str());
+        }
+    }
+
+    CachedDevice* find(const char* address) {
+        for (CachedDevice& cached : devices) {
+            if (strcasecmp(cached.Address, address) == 0) {
+                cached.LastUsed = millis();
+                return &cached;
+            }
+        }
+        return NULL;
+    }
+
+    // replaces the entry of the address, a free entry or the least recently used unconnected entry
+    void cache(const char* address, BLEDevice& device) {
+        CachedDevice* slot = find(address);
+        if (slot == NULL) {
+            for (CachedDevice& cached : devices) {
+                if (cached.Address[0] == 0) {
+                    slot = &cached;
+                    break;
+                }
+                if (!cached.Device.connected() && (slot == NULL || (long)(cached.LastUsed - slot->LastUsed) < 0)) {
+                    slot = &cached;
+                }
+            }
+        }
+        if (slot == NULL) {
+            return;
+        }
+        strlcpy(slot->Address, address, sizeof(slot->Address));
+        slot->LastUsed = millis();
+        slot->Device = device;
+    }
+
+    BLECharacteristic lookup(const char* address, const char* uuid) {
+        CachedDevice* cached = find(address);
+        if (cached == NULL) {
+            return BLECharacteristic();
+        }
+        return cached->Device.characteristic(uuid);
+    }
+};
+
+BleNotifyHandler ArduinoBleCentral::notifyHandler = NULL;
+BleDisconnectHandler ArduinoBleCentral::disconnectHandler = NULL;
+
+BleCentral& bleCentral() {
+    static ArduinoBleCentral central;
+    return central;
+}
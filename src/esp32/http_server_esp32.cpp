@@ -0,0 +1,265 @@
+#include "http_server_esp32.h"
+
+#include "log.h"
+#include "router.h"
+
+// Bodies of the responses in flight, the web server reads them while the client acknowledges
+struct ResponseSlot {
+    char Body[RESPONSE_BUFFER_SIZE];
+    bool Used;
+};
+
+static ResponseSlot responseSlots[HTTP_RESPONSE_SLOTS];
+static portMUX_TYPE responseSlotMux = portMUX_INITIALIZER_UNLOCKED;
+
+static ResponseSlot* acquireResponseSlot(size_t length) {
+    if (length > sizeof(responseSlots[0].Body)) {
+        return NULL;
+    }
+    ResponseSlot* acquired = NULL;
+    portENTER_CRITICAL(&responseSlotMux);
+    for (ResponseSlot& slot : responseSlots) {
+        if (!slot.Used) {
+            slot.Used = true;
+            acquired = &slot;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&responseSlotMux);
+    return acquired;
+}
+
+static void releaseResponseSlot(ResponseSlot* slot) {
+    portENTER_CRITICAL(&responseSlotMux);
+    slot->Used = false;
+    portEXIT_CRITICAL(&responseSlotMux);
+}
+
+// The web server deletes the response with the request, also if the client is gone. Releasing
+// from the destructor leaves the single disconnect callback of the request to its other users.
+class SlotResponse : public AsyncProgmemResponse {
+public:
+    SlotResponse(int code, const char* contentType, ResponseSlot* slot, size_t length)
+        : AsyncProgmemResponse(code, contentType, (const uint8_t*)slot->Body, length), slot(slot) {
+    }
+
+    ~SlotResponse() override {
+        releaseResponseSlot(slot);
+    }
+
+private:
+    ResponseSlot* slot;
+};
+
+class StreamResponse : public AsyncChunkedResponse {
+public:
+    StreamResponse(const char* contentType, StreamFiller fill, StreamRelease release, void* context)
+        : AsyncChunkedResponse(contentType,
+                               [fill, context](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                                   return fill(context, buffer, maxLen);
+                               }),
+          release(release), context(context) {
+    }
+
+    ~StreamResponse() override {
+        release(context);
+    }
+
+private:
+    StreamRelease release;
+    void* context;
+};
+
+AsyncHttpRequest::AsyncHttpRequest(AsyncWebServerRequest *request) : request(request), headerCount(0) {
+}
+
+AsyncHttpRequest::AsyncHttpRequest(AsyncWebServerRequestPtr request) : request(NULL), paused(request), headerCount(0) {
+}
+
+// The values are copied while the paused request is locked, it may be freed on the AsyncTCP
+// task as soon as the lock is released
+String AsyncHttpRequest::url() const {
+    AsyncWebServerRequest *target = request;
+    auto locked = paused.lock();
+    if (target == NULL) {
+        target = locked.get();
+    }
+    return target ? target->url() : String();
+}
+
+String AsyncHttpRequest::queryArg(const char* name) const {
+    AsyncWebServerRequest *target = request;
+    auto locked = paused.lock();
+    if (target == NULL) {
+        target = locked.get();
+    }
+    const AsyncWebParameter* parameter = target ? target->getParam(name) : NULL;
+    return parameter ? parameter->value() : String();
+}
+
+String AsyncHttpRequest::header(const char* name) const {
+    AsyncWebServerRequest *target = request;
+    auto locked = paused.lock();
+    if (target == NULL) {
+        target = locked.get();
+    }
+    const AsyncWebHeader* header = target ? target->getHeader(name) : NULL;
+    return header ? header->value() : String();
+}
+
+uint32_t AsyncHttpRequest::clientId() const {
+    AsyncWebServerRequest *target = request;
+    auto locked = paused.lock();
+    if (target == NULL) {
+        target = locked.get();
+    }
+    return target && target->client() ? (uint32_t)target->client()->remoteIP() : 0;
+}
+
+void AsyncHttpRequest::addHeader(const char* name, const char* value) {
+    if (headerCount < HTTP_MAX_HEADERS) {
+        headerNames[headerCount] = name;
+        strlcpy(headerValues[headerCount], value, sizeof(headerValues[headerCount]));
+        headerCount++;
+    }
+}
+
+void AsyncHttpRequest::send(int code, const char* contentType, const char* body, size_t length) {
+    stopTiming();
+    // a paused request is only valid as long as the client is connected
+    std::shared_ptr<AsyncWebServerRequest> locked;
+    AsyncWebServerRequest *target = request;
+    if (target == NULL) {
+        locked = paused.lock();
+        target = locked.get();
+    }
+    if (target != NULL) {
+        // the body is sent from a slot without copying it to the heap, the slot is free again
+        // once the request is done; large bodies or all slots in use fall back to a heap copy
+        AsyncWebServerResponse *response;
+        ResponseSlot* slot = acquireResponseSlot(length);
+        if (slot) {
+            memcpy(slot->Body, body, length);
+            response = new SlotResponse(code, contentType, slot, length);
+        } else {
+            response = target->beginResponse(code, contentType, String(body, length));
+        }
+        for (uint8_t i = 0; i < headerCount; ++i) {
+            response->addHeader(headerNames[i], headerValues[i]);
+        }
+        target->send(response);
+    }
+    headerCount = 0;
+}
+
+void AsyncHttpRequest::sendStream(int code, const char* contentType, StreamFiller fill, StreamRelease release,
+                                  void* context) {
+    stopTiming();
+    std::shared_ptr<AsyncWebServerRequest> locked;
+    AsyncWebServerRequest *target = request;
+    if (target == NULL) {
+        locked = paused.lock();
+        target = locked.get();
+    }
+    if (target == NULL) {
+        release(context);
+        headerCount = 0;
+        return;
+    }
+    // the web server pulls the body in chunks while the client acknowledges, the
+    // context lives until the request is done
+    AsyncWebServerResponse *response = new StreamResponse(contentType, fill, release, context);
+    response->setCode(code);
+    for (uint8_t i = 0; i < headerCount; ++i) {
+        response->addHeader(headerNames[i], headerValues[i]);
+    }
+    target->send(response);
+    headerCount = 0;
+}
+
+HttpRequest* AsyncHttpRequest::defer() {
+    AsyncHttpRequest* deferred = new AsyncHttpRequest(request->pause());
+    deferred->timedRoute = timedRoute;
+    deferred->receivedAt = receivedAt;
+    memcpy(deferred->pathArgs, pathArgs, sizeof(pathArgs));
+#if SERVER_TIMING_ENABLED
+    deferred->serverTiming = serverTiming;
+#endif
+    return deferred;
+}
+
+static bool toRouteMethod(WebRequestMethodComposite method, RouteMethod& out) {
+    switch (method) {
+        case HTTP_GET:
+            out = ROUTE_GET;
+            return true;
+        case HTTP_PUT:
+            out = ROUTE_PUT;
+            return true;
+        case HTTP_POST:
+            out = ROUTE_POST;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Serves all routes with one handler, the web server asks it once per request
+ * instead of trying a pattern per route.
+ */
+class RouterHandler : public AsyncWebHandler {
+public:
+    explicit RouterHandler(const Route* routes) : routes(routes) {
+    }
+
+    bool canHandle(AsyncWebServerRequest *request) const override {
+        RouteMatch match;
+        return matchRequest(request, match);
+    }
+
+    void handleRequest(AsyncWebServerRequest *request) override {
+        RouteMatch match;
+        // body routes answer from handleBody
+        if (!matchRequest(request, match) || routes[match.Route].Handler == NULL) {
+            return;
+        }
+        AsyncHttpRequest wrapped(request);
+        wrapped.startTiming(match.Route);
+        setPathArgs(wrapped, request->url().c_str(), match);
+        routes[match.Route].Handler(&wrapped);
+    }
+
+    void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override {
+        RouteMatch match;
+        if (!matchRequest(request, match) || routes[match.Route].Body == NULL) {
+            return;
+        }
+        AsyncHttpRequest wrapped(request);
+        wrapped.startTiming(match.Route);
+        setPathArgs(wrapped, request->url().c_str(), match);
+        routes[match.Route].Body(&wrapped, data, len, index, total);
+    }
+
+    bool isRequestHandlerTrivial() const override {
+        return false;
+    }
+
+private:
+    // matching is cheap enough to repeat for each body chunk instead of storing it in the request
+    bool matchRequest(AsyncWebServerRequest *request, RouteMatch& out) const {
+        RouteMethod method;
+        const String& url = request->url();
+        return toRouteMethod(request->method(), method) && matchRoute(method, url.c_str(), url.length(), out);
+    }
+
+    const Route* routes;
+};
+
+void registerRoutes(AsyncWebServer& server, const Route* routes, size_t count) {
+    if (!buildRouter(routes, count)) {
+        LOG_ERROR("route patterns do not fit the router", NULL);
+        return;
+    }
+    server.addHandler(new RouterHandler(routes));
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <ESPAsyncWebServer.h>
+
+#include "http_request.h"
+#include "response_buffer.h"
+#include "routes.h"
+
+// Number of response bodies that can be in flight without a heap copy
+#ifndef HTTP_RESPONSE_SLOTS
+#define HTTP_RESPONSE_SLOTS 4
+#endif
+
+/**
+ * HttpRequest backed by an ESPAsyncWebServer request.
+ */
+class AsyncHttpRequest : public HttpRequest {
+public:
+    /**
+     * @brief Wraps a request for the duration of a handler call.
+     * @param request The web server request pointer.
+     */
+    explicit AsyncHttpRequest(AsyncWebServerRequest *request);
+
+    /**
+     * @brief Wraps a paused request that may be answered from another task.
+     * @param request The pointer returned by AsyncWebServerRequest::pause().
+     */
+    explicit AsyncHttpRequest(AsyncWebServerRequestPtr request);
+
+    using HttpRequest::addHeader;
+    using HttpRequest::send;
+
+    String url() const override;
+    String queryArg(const char* name) const override;
+    String header(const char* name) const override;
+    uint32_t clientId() const override;
+    void addHeader(const char* name, const char* value) override;
+    void send(int code, const char* contentType, const char* body, size_t length) override;
+    void sendStream(int code, const char* contentType, StreamFiller fill, StreamRelease release,
+                    void* context) override;
+    HttpRequest* defer() override;
+
+private:
+    AsyncWebServerRequest *request;
+    AsyncWebServerRequestPtr paused;
+    const char* headerNames[HTTP_MAX_HEADERS];
+    char headerValues[HTTP_MAX_HEADERS][HTTP_MAX_HEADER_VALUE];
+    uint8_t headerCount;
+};
+
+/**
+ * @brief Registers the platform independent routes with the web server. One handler
+ *        dispatches all of them through the route trie, see buildRouter.
+ * @param server The web server.
+ * @param routes The routes.
+ * @param count Number of routes.
+ */
+void registerRoutes(AsyncWebServer& server, const Route* routes, size_t count);
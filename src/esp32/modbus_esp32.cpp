@@ -0,0 +1,48 @@
+#include "modbus_esp32.h"
+
+#include <AsyncTCP.h>
+#include <new>
+
+#if MODBUS_ENABLED
+
+static AsyncServer modbusServer(MODBUS_PORT);
+// only changed in the AsyncTCP task
+static size_t clientCount = 0;
+
+static void sendResponse(void* context, const uint8_t* frame, size_t length) {
+    ((AsyncClient*)context)->write((const char*)frame, length);
+}
+
+static void onModbusClient(void* arg, AsyncClient* client) {
+    ModbusConnection* connection = NULL;
+    if (clientCount < MODBUS_MAX_CLIENTS) {
+        connection = new (std::nothrow) ModbusConnection();
+    }
+    // the client is freed once it disconnected, also when it is rejected
+    client->onDisconnect([](void* arg, AsyncClient* client) {
+        if (arg) {
+            delete (ModbusConnection*)arg;
+            clientCount--;
+        }
+        delete client;
+    }, connection);
+    if (connection == NULL) {
+        client->close(true);
+        return;
+    }
+    clientCount++;
+    client->setNoDelay(true);
+    client->onData([](void* arg, AsyncClient* client, void* data, size_t length) {
+        if (!receiveModbusData(*(ModbusConnection*)arg, (const uint8_t*)data, length, sendResponse, client)) {
+            client->close();
+        }
+    }, connection);
+}
+
+void startModbusServer() {
+    modbusServer.onClient(onModbusClient, NULL);
+    modbusServer.setNoDelay(true);
+    modbusServer.begin();
+}
+
+#endif
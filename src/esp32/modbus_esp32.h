@@ -0,0 +1,9 @@
+#pragma once
+
+#include "modbus.h"
+
+/**
+ * @brief Starts the Modbus TCP server on MODBUS_PORT. Requests are answered in the
+ *        AsyncTCP task from the snapshots.
+ */
+void startModbusServer();
@@ -0,0 +1,54 @@
+#include <Preferences.h>
+
+#include "phase_energy.h"
+
+// NVS namespace of the phase energy records
+#define PHASE_ENERGY_NAMESPACE "phase_energy"
+
+class PreferencesPhaseEnergyStore : public PhaseEnergyStore {
+public:
+    bool load(const char* address, PhaseEnergyRecord& out) override {
+        char key[13];
+        Preferences preferences;
+        if (!recordKey(address, key) || !preferences.begin(PHASE_ENERGY_NAMESPACE, true)) {
+            return false;
+        }
+        size_t length = preferences.isKey(key) ? preferences.getBytes(key, &out, sizeof(out)) : 0;
+        preferences.end();
+        // records of an older layout are dropped
+        return length == sizeof(out) && strcasecmp(out.Address, address) == 0;
+    }
+
+    bool save(const PhaseEnergyRecord& record) override {
+        char key[13];
+        Preferences preferences;
+        if (!recordKey(record.Address, key) || !preferences.begin(PHASE_ENERGY_NAMESPACE, false)) {
+            return false;
+        }
+        size_t length = preferences.putBytes(key, &record, sizeof(record));
+        preferences.end();
+        return length == sizeof(record);
+    }
+
+private:
+    // NVS keys are limited to 15 characters, the address is stored without colons
+    static bool recordKey(const char* address, char* key) {
+        size_t length = 0;
+        for (const char* c = address; *c; ++c) {
+            if (*c == ':') {
+                continue;
+            }
+            if (length == 12) {
+                return false;
+            }
+            key[length++] = tolower(*c);
+        }
+        key[length] = 0;
+        return length == 12;
+    }
+};
+
+PhaseEnergyStore& phaseEnergyStore() {
+    static PreferencesPhaseEnergyStore store;
+    return store;
+}
@@ -0,0 +1,60 @@
+#include "push_esp32.h"
+
+EventSourcePushChannel::EventSourcePushChannel(const char* path) : events(path) {
+    // new subscribers get all fields of every charger, the deltas after that build on them
+    events.onConnect([](AsyncEventSourceClient* client) { requestPushState(); });
+}
+
+AsyncWebHandler* EventSourcePushChannel::handler() {
+    return &events;
+}
+
+size_t EventSourcePushChannel::subscriberCount() {
+    return events.count();
+}
+
+void EventSourcePushChannel::broadcast(const char* message, size_t length, uint32_t sequence) {
+    // queued per client, clients that fall too far behind drop messages and catch up with
+    // the next full one; the sequence is the event id
+    events.send(message, "measurements", sequence);
+}
+
+WebSocketPushChannel::WebSocketPushChannel(const char* path) : socket(path) {
+    socket.onEvent([](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg,
+                      uint8_t* data, size_t length) {
+        if (type == WS_EVT_CONNECT) {
+            requestPushState();
+        }
+    });
+}
+
+AsyncWebHandler* WebSocketPushChannel::handler() {
+    return &socket;
+}
+
+void WebSocketPushChannel::cleanup() {
+    socket.cleanupClients();
+}
+
+size_t WebSocketPushChannel::subscriberCount() {
+    return socket.count();
+}
+
+void WebSocketPushChannel::broadcast(const char* message, size_t length, uint32_t sequence) {
+    // the frame is copied once into a buffer shared by the queues of all clients
+    socket.textAll(message, length);
+}
+
+static EventSourcePushChannel eventsChannel(PUSH_EVENTS_PATH);
+static WebSocketPushChannel webSocketChannel(PUSH_WEBSOCKET_PATH);
+
+void registerPushChannels(AsyncWebServer& server) {
+    server.addHandler(eventsChannel.handler());
+    server.addHandler(webSocketChannel.handler());
+    addPushChannel(&eventsChannel);
+    addPushChannel(&webSocketChannel);
+}
+
+void servicePushChannels() {
+    webSocketChannel.cleanup();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <ESPAsyncWebServer.h>
+
+#include "push.h"
+
+// Paths of the push endpoints
+#ifndef PUSH_EVENTS_PATH
+#define PUSH_EVENTS_PATH "/api/events"
+#endif
+
+#ifndef PUSH_WEBSOCKET_PATH
+#define PUSH_WEBSOCKET_PATH "/api/live"
+#endif
+
+/**
+ * PushChannel sending each message as Server-Sent Event "measurements".
+ */
+class EventSourcePushChannel : public PushChannel {
+public:
+    /**
+     * @param path The path of the event stream.
+     */
+    explicit EventSourcePushChannel(const char* path);
+
+    /**
+     * @brief Returns the handler to add to the web server.
+     */
+    AsyncWebHandler* handler();
+
+    size_t subscriberCount() override;
+    void broadcast(const char* message, size_t length, uint32_t sequence) override;
+
+private:
+    AsyncEventSource events;
+};
+
+/**
+ * PushChannel sending each message as WebSocket text frame.
+ */
+class WebSocketPushChannel : public PushChannel {
+public:
+    /**
+     * @param path The path of the WebSocket.
+     */
+    explicit WebSocketPushChannel(const char* path);
+
+    /**
+     * @brief Returns the handler to add to the web server.
+     */
+    AsyncWebHandler* handler();
+
+    /**
+     * @brief Frees the clients that disconnected, called periodically.
+     */
+    void cleanup();
+
+    size_t subscriberCount() override;
+    void broadcast(const char* message, size_t length, uint32_t sequence) override;
+
+private:
+    AsyncWebSocket socket;
+};
+
+/**
+ * @brief Adds the Server-Sent Events and WebSocket endpoints to the web server and
+ *        registers them as push channels.
+ * @param server The web server.
+ */
+void registerPushChannels(AsyncWebServer& server);
+
+/**
+ * @brief Maintains the push endpoints, called from the Arduino loop.
+ */
+void servicePushChannels();
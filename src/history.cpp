@@ -0,0 +1,330 @@
+#include <new>
+
+#include "history.h"
+#include "response_buffer.h"
+#include "snapshot_fields.h"
+
+struct HistorySignal {
+    SnapshotFieldId Field;
+    const char* Name;
+    // decimal places of the raw value, like in the measurements response
+    uint8_t Decimals;
+};
+
+static const HistorySignal signals[] = {
+    {FIELD_POWER_TOTAL_POWER, "TotalPower", 2},
+    {FIELD_POWER_L1, "PowerL1", 2},
+    {FIELD_POWER_L2, "PowerL2", 2},
+    {FIELD_POWER_L3, "PowerL3", 2},
+    {FIELD_VOLTAGE_L1, "VoltageL1", 1},
+    {FIELD_VOLTAGE_L2, "VoltageL2", 1},
+    {FIELD_VOLTAGE_L3, "VoltageL3", 1},
+    {FIELD_CURRENT_L1, "CurrentL1", 2},
+    {FIELD_CURRENT_L2, "CurrentL2", 2},
+    {FIELD_CURRENT_L3, "CurrentL3", 2},
+    {FIELD_POWER_FREQUENCY, "Frequency", 2},
+    {FIELD_POWER_TEMPERATURE, "Temperature", 0},
+    {FIELD_POWER_CP_SIGNAL, "CPSignal", 0},
+};
+
+#define HISTORY_SIGNALS (sizeof(signals) / sizeof(signals[0]))
+
+// Characteristics whose values are recorded, each bucket counts their samples separately
+#define HISTORY_SOURCES 2
+
+#define HISTORY_BUCKETS (HISTORY_SECOND_BUCKETS + HISTORY_MINUTE_BUCKETS + HISTORY_QUARTER_BUCKETS)
+
+struct HistoryTier {
+    uint32_t PeriodS;
+    // position of the ring of the resolution in the bucket arrays
+    uint16_t Offset;
+    uint16_t Size;
+    const char* Name;
+};
+
+static const HistoryTier tiers[HISTORY_RESOLUTION_COUNT] = {
+    {1, 0, HISTORY_SECOND_BUCKETS, "1s"},
+    {60, HISTORY_SECOND_BUCKETS, HISTORY_MINUTE_BUCKETS, "1m"},
+    {900, HISTORY_SECOND_BUCKETS + HISTORY_MINUTE_BUCKETS, HISTORY_QUARTER_BUCKETS, "15m"},
+};
+
+// Struct of arrays, the values of a signal are contiguous over all buckets of a resolution.
+// A bucket is aggregated while it is the newest one of its ring, samples are never kept.
+struct ChargerHistory {
+    // start of the bucket in seconds since boot divided by the period
+    uint32_t Bucket[HISTORY_BUCKETS];
+    uint16_t Samples[HISTORY_SOURCES][HISTORY_BUCKETS];
+    int16_t Min[HISTORY_SIGNALS][HISTORY_BUCKETS];
+    int16_t Avg[HISTORY_SIGNALS][HISTORY_BUCKETS];
+    int16_t Max[HISTORY_SIGNALS][HISTORY_BUCKETS];
+    // sums of the newest bucket of each resolution
+    int32_t Sum[HISTORY_RESOLUTION_COUNT][HISTORY_SIGNALS];
+    uint16_t Head[HISTORY_RESOLUTION_COUNT];
+    uint16_t Count[HISTORY_RESOLUTION_COUNT];
+};
+
+// Large enough for the CSV header
+#define HISTORY_ROW_SIZE 768
+
+// "NRGH", format version, number of signals and period in seconds
+#define HISTORY_BINARY_VERSION 1
+
+struct HistoryStream {
+    int Slot;
+    HistoryResolution Resolution;
+    HistoryFormat Format;
+    // first bucket that was not streamed yet
+    uint32_t Next;
+    // ages are relative to the time the stream was opened
+    uint32_t Now;
+    bool HeaderDone;
+    char Row[HISTORY_ROW_SIZE];
+    size_t RowLength;
+    size_t RowOffset;
+};
+
+struct HistoryRow {
+    uint32_t Bucket;
+    int16_t Min[HISTORY_SIGNALS];
+    int16_t Avg[HISTORY_SIGNALS];
+    int16_t Max[HISTORY_SIGNALS];
+};
+
+static ChargerHistory histories[HISTORY_MAX_CHARGERS];
+static portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int historySource(SnapshotPart part) {
+    switch (part) {
+        case PART_POWER:
+            return 0;
+        case PART_VOLTAGE_CURRENT:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+static int16_t clampSample(int64_t value) {
+    // HISTORY_MISSING is reserved
+    return (int16_t)max((int64_t)INT16_MIN + 1, min(value, (int64_t)INT16_MAX));
+}
+
+// starts the next bucket of a resolution, overwriting the oldest one once the ring is full
+static void openBucketLocked(ChargerHistory& history, int tier, uint32_t bucket) {
+    const HistoryTier& def = tiers[tier];
+    history.Head[tier] = history.Count[tier] == 0 ? 0 : (history.Head[tier] + 1) % def.Size;
+    if (history.Count[tier] < def.Size) {
+        history.Count[tier]++;
+    }
+    int index = def.Offset + history.Head[tier];
+    history.Bucket[index] = bucket;
+    for (int source = 0; source < HISTORY_SOURCES; ++source) {
+        history.Samples[source][index] = 0;
+    }
+    for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+        history.Min[signal][index] = HISTORY_MISSING;
+        history.Avg[signal][index] = HISTORY_MISSING;
+        history.Max[signal][index] = HISTORY_MISSING;
+        history.Sum[tier][signal] = 0;
+    }
+}
+
+void releaseHistory(int slot) {
+    if (slot < 0 || slot >= HISTORY_MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&historyMux);
+    memset(&histories[slot], 0, sizeof(histories[slot]));
+    portEXIT_CRITICAL(&historyMux);
+}
+
+void recordHistory(int slot, SnapshotPart part) {
+    int source = historySource(part);
+    ChargerSnapshot snapshot;
+    if (slot < 0 || slot >= HISTORY_MAX_CHARGERS || source < 0 || !copySnapshot(slot, snapshot)) {
+        return;
+    }
+    int16_t values[HISTORY_SIGNALS];
+    for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+        const SnapshotField& field = snapshotFields[signals[signal].Field];
+        values[signal] = field.Part == part ? clampSample(readSnapshotField(snapshot, field)) : 0;
+    }
+    uint32_t now = snapshot.ReadAt[part] / 1000000;
+
+    ChargerHistory& history = histories[slot];
+    portENTER_CRITICAL(&historyMux);
+    for (int tier = 0; tier < HISTORY_RESOLUTION_COUNT; ++tier) {
+        const HistoryTier& def = tiers[tier];
+        uint32_t bucket = now / def.PeriodS;
+        if (history.Count[tier] == 0 || history.Bucket[def.Offset + history.Head[tier]] != bucket) {
+            openBucketLocked(history, tier, bucket);
+        }
+        int index = def.Offset + history.Head[tier];
+        uint16_t samples = history.Samples[source][index];
+        if (samples == UINT16_MAX) {
+            continue;
+        }
+        for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+            if (snapshotFields[signals[signal].Field].Part != part) {
+                continue;
+            }
+            int16_t value = values[signal];
+            int32_t& sum = history.Sum[tier][signal];
+            sum += value;
+            history.Avg[signal][index] = sum / (samples + 1);
+            if (samples == 0 || value < history.Min[signal][index]) {
+                history.Min[signal][index] = value;
+            }
+            if (samples == 0 || value > history.Max[signal][index]) {
+                history.Max[signal][index] = value;
+            }
+        }
+        history.Samples[source][index] = samples + 1;
+    }
+    portEXIT_CRITICAL(&historyMux);
+}
+
+bool parseHistoryResolution(const String& text, HistoryResolution& out) {
+    for (int tier = 0; tier < HISTORY_RESOLUTION_COUNT; ++tier) {
+        if (text == tiers[tier].Name) {
+            out = (HistoryResolution)tier;
+            return true;
+        }
+    }
+    return false;
+}
+
+// copies the oldest bucket at or after stream.Next
+static bool readRow(const HistoryStream& stream, HistoryRow& row) {
+    const HistoryTier& def = tiers[stream.Resolution];
+    const ChargerHistory& history = histories[stream.Slot];
+    bool found = false;
+    portENTER_CRITICAL(&historyMux);
+    uint16_t count = history.Count[stream.Resolution];
+    int oldest = count < def.Size ? 0 : (history.Head[stream.Resolution] + 1) % def.Size;
+    for (uint16_t i = 0; i < count && !found; ++i) {
+        int index = def.Offset + (oldest + i) % def.Size;
+        if (history.Bucket[index] < stream.Next) {
+            continue;
+        }
+        row.Bucket = history.Bucket[index];
+        for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+            row.Min[signal] = history.Min[signal][index];
+            row.Avg[signal] = history.Avg[signal][index];
+            row.Max[signal] = history.Max[signal][index];
+        }
+        found = true;
+    }
+    portEXIT_CRITICAL(&historyMux);
+    return found;
+}
+
+static void appendLittleEndian(ResponseBuffer& out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out.append((char)(value >> (8 * i)));
+    }
+}
+
+static void appendCsvValue(ResponseBuffer& out, int16_t value, uint8_t decimals) {
+    out.append(',');
+    if (value != HISTORY_MISSING) {
+        out.appendFixed(value, decimals);
+    }
+}
+
+static void formatHeader(const HistoryStream& stream, ResponseBuffer& out) {
+    if (stream.Format == HISTORY_BINARY) {
+        out.append("NRGH");
+        appendLittleEndian(out, HISTORY_BINARY_VERSION, 1);
+        appendLittleEndian(out, HISTORY_SIGNALS, 1);
+        appendLittleEndian(out, tiers[stream.Resolution].PeriodS, 2);
+        return;
+    }
+    out.append("Age");
+    for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+        static const char* const suffixes[] = {"Min", "Avg", "Max"};
+        for (const char* suffix : suffixes) {
+            out.append(',');
+            out.append(signals[signal].Name);
+            out.append(suffix);
+        }
+    }
+    out.append('\n');
+}
+
+static void formatRow(const HistoryStream& stream, const HistoryRow& row, ResponseBuffer& out) {
+    // seconds between the start of the bucket and opening the stream
+    uint32_t age = stream.Now - row.Bucket * tiers[stream.Resolution].PeriodS;
+    if (stream.Format == HISTORY_BINARY) {
+        appendLittleEndian(out, age, 4);
+        for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+            appendLittleEndian(out, (uint16_t)row.Min[signal], 2);
+            appendLittleEndian(out, (uint16_t)row.Avg[signal], 2);
+            appendLittleEndian(out, (uint16_t)row.Max[signal], 2);
+        }
+        return;
+    }
+    out.appendUnsigned(age);
+    for (size_t signal = 0; signal < HISTORY_SIGNALS; ++signal) {
+        uint8_t decimals = signals[signal].Decimals;
+        appendCsvValue(out, row.Min[signal], decimals);
+        appendCsvValue(out, row.Avg[signal], decimals);
+        appendCsvValue(out, row.Max[signal], decimals);
+    }
+    out.append('\n');
+}
+
+static bool nextRow(HistoryStream& stream) {
+    ResponseBuffer out(stream.Row, sizeof(stream.Row));
+    if (!stream.HeaderDone) {
+        formatHeader(stream, out);
+        stream.HeaderDone = true;
+    } else {
+        HistoryRow row;
+        if (!readRow(stream, row)) {
+            return false;
+        }
+        formatRow(stream, row, out);
+        stream.Next = row.Bucket + 1;
+    }
+    stream.RowLength = out.length();
+    stream.RowOffset = 0;
+    return true;
+}
+
+void* openHistoryStream(int slot, HistoryResolution resolution, uint32_t sinceS, HistoryFormat format) {
+    if (slot < 0 || slot >= HISTORY_MAX_CHARGERS || resolution < 0 || resolution >= HISTORY_RESOLUTION_COUNT) {
+        return NULL;
+    }
+    HistoryStream* stream = new (std::nothrow) HistoryStream();
+    if (stream == NULL) {
+        return NULL;
+    }
+    stream->Slot = slot;
+    stream->Resolution = resolution;
+    stream->Format = format;
+    stream->Now = snapshotNow() / 1000000;
+    if (sinceS > 0 && sinceS < stream->Now) {
+        stream->Next = (stream->Now - sinceS) / tiers[resolution].PeriodS;
+    }
+    return stream;
+}
+
+size_t fillHistoryStream(void* context, uint8_t* buffer, size_t size) {
+    HistoryStream& stream = *(HistoryStream*)context;
+    size_t written = 0;
+    while (written < size) {
+        if (stream.RowOffset == stream.RowLength && !nextRow(stream)) {
+            break;
+        }
+        size_t length = min(size - written, stream.RowLength - stream.RowOffset);
+        memcpy(buffer + written, stream.Row + stream.RowOffset, length);
+        stream.RowOffset += length;
+        written += length;
+    }
+    return written;
+}
+
+void closeHistoryStream(void* stream) {
+    delete (HistoryStream*)stream;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <Arduino.h>
+
+#include "snapshot.h"
+
+// Number of charger slots with a history, the first slots registered get one
+#ifndef HISTORY_MAX_CHARGERS
+#define HISTORY_MAX_CHARGERS 2
+#endif
+
+// Number of buckets kept per resolution: 1 minute of 1 s, 1 hour of 1 min and 24 hours of 15 min
+#ifndef HISTORY_SECOND_BUCKETS
+#define HISTORY_SECOND_BUCKETS 60
+#endif
+
+#ifndef HISTORY_MINUTE_BUCKETS
+#define HISTORY_MINUTE_BUCKETS 60
+#endif
+
+#ifndef HISTORY_QUARTER_BUCKETS
+#define HISTORY_QUARTER_BUCKETS 96
+#endif
+
+// Value of a signal in a bucket without samples of its characteristic
+#define HISTORY_MISSING INT16_MIN
+
+enum HistoryResolution {
+    HISTORY_1S,
+    HISTORY_1MIN,
+    HISTORY_15MIN,
+    HISTORY_RESOLUTION_COUNT
+};
+
+enum HistoryFormat {
+    HISTORY_CSV,
+    HISTORY_BINARY
+};
+
+/**
+ * @brief Adds the values of a characteristic that was just stored in the snapshot
+ *        to the open buckets of all resolutions. Only called by the poller task.
+ * @param slot The charger slot.
+ * @param part The characteristic, only Power and VoltageCurrent are recorded.
+ */
+void recordHistory(int slot, SnapshotPart part);
+
+/**
+ * @brief Drops the history of a released charger slot.
+ * @param slot The charger slot.
+ */
+void releaseHistory(int slot);
+
+/**
+ * @brief Parses a resolution as given in a query, e.g. "1s", "1m" or "15m".
+ * @param text The resolution.
+ * @param out Receives the resolution.
+ * @return false if the text is no known resolution.
+ */
+bool parseHistoryResolution(const String& text, HistoryResolution& out);
+
+/**
+ * @brief Starts streaming the buckets of a charger, oldest first. Buckets are read one at a time
+ *        while streaming, nothing is copied up front.
+ * @param slot The charger slot.
+ * @param resolution The resolution.
+ * @param sinceS Only buckets that started within this many seconds, 0 for all.
+ * @param format The output format.
+ * @return The stream or NULL if the slot has no history or no memory is left.
+ */
+void* openHistoryStream(int slot, HistoryResolution resolution, uint32_t sinceS, HistoryFormat format);
+
+/**
+ * @brief Writes the next part of a history stream, rows may be split between calls.
+ * @param stream The stream.
+ * @param buffer Receives the data.
+ * @param size Size of the buffer.
+ * @return Number of bytes written, 0 at the end.
+ */
+size_t fillHistoryStream(void* stream, uint8_t* buffer, size_t size);
+
+/**
+ * @brief Frees a history stream.
+ * @param stream The stream.
+ */
+void closeHistoryStream(void* stream);
@@ -0,0 +1,209 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "metrics.h"
+#include "server_timing.h"
+
+// Maximum number of headers added to a response, e.g. X-Snapshot-Age, ETag, Cache-Control and Server-Timing
+#ifndef HTTP_MAX_HEADERS
+#define HTTP_MAX_HEADERS 4
+#endif
+
+// Maximum length of a header value added to a response, Server-Timing is the longest
+#ifndef HTTP_MAX_HEADER_VALUE
+#if SERVER_TIMING_ENABLED
+#define HTTP_MAX_HEADER_VALUE 256
+#else
+#define HTTP_MAX_HEADER_VALUE 48
+#endif
+#endif
+
+// Maximum number of captures of a route pattern
+#define HTTP_MAX_PATH_ARGS 2
+
+// Longest captured value including the terminator, a MAC address
+#define HTTP_MAX_PATH_ARG_SIZE 18
+
+/**
+ * @brief Writes the next part of a streamed response body.
+ * @param context The context passed to sendStream.
+ * @param buffer Receives the data.
+ * @param size Size of the buffer.
+ * @return Number of bytes written, 0 at the end of the body.
+ */
+typedef size_t (*StreamFiller)(void* context, uint8_t* buffer, size_t size);
+
+/**
+ * @brief Releases the context of a streamed response once it was sent or the client is gone.
+ * @param context The context passed to sendStream.
+ */
+typedef void (*StreamRelease)(void* context);
+
+/**
+ * Thin interface of an HTTP request and its response, implemented on top of
+ * ESPAsyncWebServer on the ESP32 and by an in-process fake on the native build.
+ */
+class HttpRequest {
+public:
+    HttpRequest() : timedRoute(-1), receivedAt(0) {
+        memset(pathArgs, 0, sizeof(pathArgs));
+#if SERVER_TIMING_ENABLED
+        startServerTiming(serverTiming, 0);
+#endif
+    }
+    virtual ~HttpRequest() {}
+
+    /**
+     * @brief Starts timing the response, the latency is recorded for the route once it is sent.
+     *        Deferred handles keep timing the same request.
+     * @param route Index of the route in the routes table.
+     */
+    void startTiming(int route) {
+        timedRoute = route;
+        receivedAt = esp_timer_get_time();
+#if SERVER_TIMING_ENABLED
+        startServerTiming(serverTiming, receivedAt);
+#endif
+    }
+
+#if SERVER_TIMING_ENABLED
+    /**
+     * @brief Returns the phases of the request reported in its Server-Timing header.
+     * @return The timing, carried over to deferred handles.
+     */
+    ServerTiming& timing() {
+        return serverTiming;
+    }
+
+    /**
+     * @brief Adds the Server-Timing header with the phases recorded so far to the response.
+     */
+    void addServerTimingHeader() {
+        char value[HTTP_MAX_HEADER_VALUE];
+        formatServerTiming(serverTiming, value, sizeof(value));
+        addHeader("Server-Timing", value);
+    }
+#endif
+
+    /**
+     * @brief Returns a capture of the matched route pattern, e.g. {mac}.
+     * @param index Index of the capture in the pattern.
+     * @return The captured value or an empty string, copied to deferred handles.
+     */
+    const char* pathArg(size_t index) const {
+        return index < HTTP_MAX_PATH_ARGS ? pathArgs[index] : "";
+    }
+
+    /**
+     * @brief Sets a capture of the matched route pattern, called before the handler.
+     * @param index Index of the capture in the pattern.
+     * @param value The captured value, not terminated, truncated to HTTP_MAX_PATH_ARG_SIZE.
+     * @param length Length of the value.
+     */
+    void setPathArg(size_t index, const char* value, size_t length) {
+        if (index < HTTP_MAX_PATH_ARGS) {
+            length = min(length, sizeof(pathArgs[index]) - 1);
+            memcpy(pathArgs[index], value, length);
+            pathArgs[index][length] = 0;
+        }
+    }
+
+    /**
+     * @brief Returns the path of the request. Values are returned as copies, the request
+     *        behind a deferred handle can be freed as soon as the client disconnects.
+     * @return The path without the query.
+     */
+    virtual String url() const = 0;
+
+    /**
+     * @brief Returns a query parameter of the request.
+     * @param name The parameter name.
+     * @return The value or an empty string if the parameter is missing.
+     */
+    virtual String queryArg(const char* name) const = 0;
+
+    /**
+     * @brief Returns a header of the request.
+     * @param name The header name, case-insensitive.
+     * @return The value or an empty string if the header is missing.
+     */
+    virtual String header(const char* name) const = 0;
+
+    /**
+     * @brief Returns the route being served.
+     * @return Index of the route in the routes table, -1 once the response was sent.
+     */
+    int route() const {
+        return timedRoute;
+    }
+
+    /**
+     * @brief Identifies the client of the request, e.g. by its IPv4 address.
+     * @return The client id.
+     */
+    virtual uint32_t clientId() const = 0;
+
+    /**
+     * @brief Adds a header to the response sent next.
+     * @param name The header name, must outlive the response.
+     * @param value The header value, copied and truncated to HTTP_MAX_HEADER_VALUE.
+     */
+    virtual void addHeader(const char* name, const char* value) = 0;
+
+    void addHeader(const char* name, const String& value) {
+        addHeader(name, value.c_str());
+    }
+
+    /**
+     * @brief Sends the response. Does nothing if the client is gone.
+     * @param code The HTTP status code.
+     * @param contentType The content type.
+     * @param body The response body, copied before the call returns.
+     * @param length Length of the body.
+     */
+    virtual void send(int code, const char* contentType, const char* body, size_t length) = 0;
+
+    void send(int code, const char* contentType, const char* body) {
+        send(code, contentType, body, strlen(body));
+    }
+
+    void send(int code, const char* contentType, const String& body) {
+        send(code, contentType, body.c_str(), body.length());
+    }
+
+    /**
+     * @brief Sends a response whose body is produced while it is sent, without its full size in memory.
+     * @param code The HTTP status code.
+     * @param contentType The content type.
+     * @param fill Called for each part of the body, possibly from another task after the handler returned.
+     * @param release Called exactly once when the body is no longer needed, also if the client is gone.
+     * @param context Passed to fill and release.
+     */
+    virtual void sendStream(int code, const char* contentType, StreamFiller fill, StreamRelease release,
+                            void* context) = 0;
+
+    /**
+     * @brief Keeps the request open after the handler returned. Must be called from the handler.
+     * @return A handle owned by the caller that sends the response later, possibly from another task.
+     */
+    virtual HttpRequest* defer() = 0;
+
+protected:
+    /**
+     * @brief Records the latency of the response, called by send() implementations.
+     */
+    void stopTiming() {
+        if (timedRoute >= 0) {
+            recordHttpLatency(timedRoute, esp_timer_get_time() - receivedAt);
+            timedRoute = -1;
+        }
+    }
+
+    int timedRoute;
+    int64_t receivedAt;
+    char pathArgs[HTTP_MAX_PATH_ARGS][HTTP_MAX_PATH_ARG_SIZE];
+#if SERVER_TIMING_ENABLED
+    ServerTiming serverTiming;
+#endif
+};
@@ -0,0 +1,174 @@
+#include "log.h"
+
+#include <atomic>
+#include <new>
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+// Time the log task waits for new records
+#define LOG_DRAIN_INTERVAL_MS 20
+
+// Longest formatted record
+#define LOG_LINE_SIZE (LOG_DETAIL_SIZE + 96)
+
+// A record in the ring. State is odd while a producer writes the record and
+// 2 * (sequence + 1) once it is complete, readers copy the record out and
+// check that State did not change meanwhile.
+struct LogSlot {
+    std::atomic<uint32_t> State;
+    uint32_t TimeMs;
+    const char* Message;
+    uint8_t Level;
+    char Detail[LOG_DETAIL_SIZE];
+};
+
+struct LogEntry {
+    uint32_t Sequence;
+    uint32_t TimeMs;
+    const char* Message;
+    uint8_t Level;
+    char Detail[LOG_DETAIL_SIZE];
+};
+
+struct LogStream {
+    uint32_t Next;
+    uint32_t End;
+    char Line[LOG_LINE_SIZE];
+    size_t Length;
+    size_t Offset;
+};
+
+static LogSlot ring[LOG_RING_SIZE];
+// sequence number of the next record, producers claim their slot by incrementing it
+static std::atomic<uint32_t> head(0);
+static std::atomic<uint32_t> dropped(0);
+
+static const char levelNames[] = {'-', 'E', 'W', 'I', 'D'};
+
+void logRecord(uint8_t level, const char* message, const char* detail) {
+    uint32_t sequence = head.fetch_add(1, std::memory_order_relaxed);
+    LogSlot& slot = ring[sequence % LOG_RING_SIZE];
+    slot.State.store(sequence * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.TimeMs = millis();
+    slot.Message = message;
+    slot.Level = level;
+    strlcpy(slot.Detail, detail ? detail : "", sizeof(slot.Detail));
+    slot.State.store(sequence * 2 + 2, std::memory_order_release);
+}
+
+// Copies a record out of the ring, false if it is still written or was overwritten
+static bool readRecord(uint32_t sequence, LogEntry& out) {
+    const LogSlot& slot = ring[sequence % LOG_RING_SIZE];
+    uint32_t complete = sequence * 2 + 2;
+    if (slot.State.load(std::memory_order_acquire) != complete) {
+        return false;
+    }
+    out.Sequence = sequence;
+    out.TimeMs = slot.TimeMs;
+    out.Message = slot.Message;
+    out.Level = slot.Level;
+    memcpy(out.Detail, slot.Detail, sizeof(out.Detail));
+    out.Detail[sizeof(out.Detail) - 1] = 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.State.load(std::memory_order_relaxed) == complete;
+}
+
+// Whether the record is not complete yet, as opposed to overwritten by a newer one
+static bool recordPending(uint32_t sequence) {
+    uint32_t state = ring[sequence % LOG_RING_SIZE].State.load(std::memory_order_acquire);
+    return (int32_t)(state - (sequence * 2 + 2)) < 0;
+}
+
+static size_t formatEntry(const LogEntry& entry, char* line, size_t size) {
+    int length = snprintf(line, size, "%lu %lu %c %s%s%s\n", (unsigned long)entry.Sequence,
+                          (unsigned long)entry.TimeMs, levelNames[min(entry.Level, (uint8_t)LOG_LEVEL_DEBUG)],
+                          entry.Message, entry.Detail[0] ? " " : "", entry.Detail);
+    return length < 0 ? 0 : min((size_t)length, size - 1);
+}
+
+// Records that were overwritten before they were read are skipped
+static uint32_t oldestRecord(uint32_t from, uint32_t end) {
+    if ((int32_t)(end - from) > LOG_RING_SIZE) {
+        return end - LOG_RING_SIZE;
+    }
+    return from;
+}
+
+static void logTask(void* parameter) {
+    uint32_t next = 0;
+    char line[LOG_LINE_SIZE];
+    for (;;) {
+        uint32_t end = head.load(std::memory_order_acquire);
+        uint32_t oldest = oldestRecord(next, end);
+        dropped.fetch_add(oldest - next, std::memory_order_relaxed);
+        next = oldest;
+        while (next != end) {
+            LogEntry entry;
+            if (!readRecord(next, entry)) {
+                if (recordPending(next)) {
+                    break;
+                }
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // Serial blocks while the bytes drain, only this task waits for it
+                formatEntry(entry, line, sizeof(line));
+                Serial.print(line);
+            }
+            next++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+
+void startLogTask() {
+    // lowest priority, records are printed whenever nothing else runs
+    xTaskCreatePinnedToCore(logTask, "log", 3072, NULL, 0, NULL, 0);
+}
+
+void* openLogStream(uint32_t since, uint32_t& next) {
+    LogStream* stream = new (std::nothrow) LogStream;
+    if (stream == NULL) {
+        return NULL;
+    }
+    // records logged while streaming are left for the next request
+    stream->End = head.load(std::memory_order_acquire);
+    stream->Next = (int32_t)(stream->End - since) < 0 ? stream->End : oldestRecord(since, stream->End);
+    stream->Length = 0;
+    stream->Offset = 0;
+    next = stream->End;
+    return stream;
+}
+
+size_t fillLogStream(void* context, uint8_t* buffer, size_t size) {
+    LogStream* stream = (LogStream*)context;
+    size_t written = 0;
+    while (written < size) {
+        if (stream->Offset == stream->Length) {
+            LogEntry entry;
+            bool found = false;
+            while (!found && stream->Next != stream->End) {
+                found = readRecord(stream->Next++, entry);
+            }
+            if (!found) {
+                break;
+            }
+            stream->Length = formatEntry(entry, stream->Line, sizeof(stream->Line));
+            stream->Offset = 0;
+        }
+        size_t copied = min(size - written, stream->Length - stream->Offset);
+        memcpy(buffer + written, stream->Line + stream->Offset, copied);
+        stream->Offset += copied;
+        written += copied;
+    }
+    return written;
+}
+
+void closeLogStream(void* stream) {
+    delete (LogStream*)stream;
+}
+
+void getLogStats(LogStats& out) {
+    out.Written = head.load(std::memory_order_relaxed);
+    out.Dropped = dropped.load(std::memory_order_relaxed);
+}
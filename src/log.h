@@ -0,0 +1,95 @@
+#pragma once
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Records above this level are compiled out, their arguments are not evaluated
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Number of records kept, a power of two
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64
+#endif
+
+// Longest detail kept in a record, longer ones are truncated
+#define LOG_DETAIL_SIZE 48
+
+struct LogStats {
+    uint32_t Written;
+    // records overwritten before the log task printed them
+    uint32_t Dropped;
+};
+
+/**
+ * @brief Adds a record to the log ring without blocking or allocating. Can be called from any task.
+ *        Use the LOG_* macros instead, they are compiled out below LOG_LEVEL.
+ * @param level The level, e.g. LOG_LEVEL_INFO.
+ * @param message The message, a string literal, only the pointer is stored.
+ * @param detail Copied into the record, e.g. a MAC address, may be NULL.
+ */
+void logRecord(uint8_t level, const char* message, const char* detail);
+
+/**
+ * @brief Starts the low priority task printing the log records to Serial.
+ */
+void startLogTask();
+
+/**
+ * @brief Starts streaming the records still in the ring, oldest first, one line each:
+ *        "sequence uptimeMs level message detail".
+ * @param since Only records with at least this sequence number.
+ * @param next Receives the sequence number after the last streamed record, to resume from.
+ * @return The stream or NULL if no memory is left.
+ */
+void* openLogStream(uint32_t since, uint32_t& next);
+
+/**
+ * @brief Writes the next part of a log stream, lines may be split between calls.
+ * @param stream The stream.
+ * @param buffer Receives the data.
+ * @param size Size of the buffer.
+ * @return Number of bytes written, 0 at the end.
+ */
+size_t fillLogStream(void* stream, uint8_t* buffer, size_t size);
+
+/**
+ * @brief Frees a log stream.
+ * @param stream The stream.
+ */
+void closeLogStream(void* stream);
+
+/**
+ * @brief Returns the log statistics.
+ * @param out Stats to copy into.
+ */
+void getLogStats(LogStats& out);
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(message, detail) logRecord(LOG_LEVEL_ERROR, message, detail)
+#else
+#define LOG_ERROR(message, detail)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(message, detail) logRecord(LOG_LEVEL_WARN, message, detail)
+#else
+#define LOG_WARN(message, detail)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(message, detail) logRecord(LOG_LEVEL_INFO, message, detail)
+#else
+#define LOG_INFO(message, detail)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(message, detail) logRecord(LOG_LEVEL_DEBUG, message, detail)
+#else
+#define LOG_DEBUG(message, detail)
+#endif
@@ -7,9 +7,12 @@
 #include <map>
 #include <ElegantOTA.h>
 
-#include "ble_utils.h"
-#include "api.h"
-#include "pantabox_api.h"
+#include "ble_poller.h"
+#include "log.h"
+#include "routes.h"
+#include "esp32/http_server_esp32.h"
+#include "esp32/modbus_esp32.h"
+#include "esp32/push_esp32.h"
 
 // Ethernet server on port 80
 AsyncWebServer server(80);
@@ -26,14 +29,16 @@ void handleNotFound(AsyncWebServerRequest *request) {
  * @brief Arduino setup function. Initializes serial, Ethernet, BLE, and web server.
  */
 void setup() {
-    Serial.begin(9600);
+    Serial.begin(115200);
     while (!Serial);
+    startLogTask();
     ETH.begin();
     if (!BLE.begin()) {
         Serial.println("starting BLE failed!");
         while (1);
     }
     Serial.println("BLE Central - Starting");
+    startBlePoller();
     Serial.print("Waiting for Ethernet connection");
     while (!ETH.linkUp()) {
         delay(500);
@@ -42,25 +47,21 @@ void setup() {
     Serial.println();
     Serial.print("Connected! IP address: ");
     Serial.println(ETH.localIP());
-    server.on("^\\/api\\/measurements\\/(.+)$", HTTP_GET, handleMeasurementsRequest);
-    server.on("^\\/api\\/settings\\/(.+)$", HTTP_GET, handleSettingsRequest);
-    server.on("^\\/api\\/settings\\/(.+)$", HTTP_PUT, [](AsyncWebServerRequest *request){}, NULL, handleSettingsRequestPut);
-
-    server.on("^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/state$", HTTP_GET, handlePantaboxChargerState);
-    server.on("^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/enabled$", HTTP_GET, handlePantaboxChargerEnabled);
-    server.on("^\\/pantabox\\/(.+)\\/(.+)\\/api\\/meter\\/power$", HTTP_GET, handlePantaboxMeterPower);
-    server.on("^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/maxcurrent$", HTTP_GET, handlePantaboxChargerMaxCurrent);
-    server.on("^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/enable$", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL, handlePantaboxChargerEnableSet);
-    server.on("^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/current$", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL, handlePantaboxChargerCurrentSet);
+    registerRoutes(server, routes, routeCount);
+    registerPushChannels(server);
     server.onNotFound(handleNotFound);
     ElegantOTA.begin(&server);
     server.begin();
+#if MODBUS_ENABLED
+    startModbusServer();
+#endif
     esp_task_wdt_init(30, true);
 }
 
 /**
- * @brief Arduino loop function. Handles OTA updates.
+ * @brief Arduino loop function. Handles OTA updates and maintains the push endpoints.
  */
 void loop() {
     ElegantOTA.loop();
+    servicePushChannels();
 }
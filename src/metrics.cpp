@@ -0,0 +1,305 @@
+#include "metrics.h"
+
+#include <atomic>
+
+#include "routes.h"
+
+// Upper bounds of the latency buckets, the last bucket counts everything above
+#define LATENCY_BUCKETS 12
+
+static const uint32_t latencyBoundsUs[LATENCY_BUCKETS - 1] = {
+    100, 250, 1000, 2500, 10000, 25000, 100000, 250000, 1000000, 2500000, 10000000,
+};
+
+static const char* const latencyBoundLabels[LATENCY_BUCKETS] = {
+    "0.0001", "0.00025", "0.001", "0.0025", "0.01", "0.025", "0.1", "0.25", "1", "2.5", "10", "+Inf",
+};
+
+// Buckets are not cumulative, the count is their sum. The ESP32 has no lock-free 64 bit
+// atomics, so the sum wraps after 71 minutes of accumulated latency which Prometheus
+// treats like a counter reset.
+struct LatencyHistogram {
+    std::atomic<uint32_t> Buckets[LATENCY_BUCKETS];
+    std::atomic<uint32_t> SumUs;
+};
+
+// Errors produced by the BLE sessions and sent to clients, anything else is counted as "other"
+static const char* const errorMessages[] = {
+    "not found",
+    "connect failed",
+    "discovery failed",
+    "energy characteristic read failed",
+    "power characteristic read failed",
+    "voltage/current characteristic read failed",
+    "info characteristic read failed",
+    "Info characteristic read failed",
+    "Settings characteristic not found or not writable",
+    "Failed to write settings",
+    "too many chargers",
+    "no data yet",
+    "data outdated",
+    "BLE queue full",
+    "other",
+};
+
+#define ERROR_COUNT (sizeof(errorMessages) / sizeof(errorMessages[0]))
+
+struct BleOperationLabels {
+    const char* Operation;
+    const char* Characteristic;
+};
+
+static const BleOperationLabels bleOperationLabels[BLE_OP_COUNT] = {
+    {"scan", NULL},
+    {"connect", NULL},
+    {"discover", NULL},
+    {"read", "Energy"},
+    {"read", "Power"},
+    {"read", "VoltageCurrent"},
+    {"read", "Info"},
+    {"write", "Settings"},
+};
+
+// Longest line without the route pattern, e.g. a bucket of the HTTP histogram
+#define METRICS_LINE_SIZE 112
+
+// Size of the HELP and TYPE lines of all metrics
+#define METRICS_HEADER_SIZE 1536
+
+static LatencyHistogram bleLatency[BLE_OP_COUNT];
+static LatencyHistogram httpLatency[METRICS_MAX_ROUTES];
+static std::atomic<uint32_t> httpCacheHits[METRICS_MAX_ROUTES];
+static std::atomic<uint32_t> httpCacheMisses[METRICS_MAX_ROUTES];
+static std::atomic<uint32_t> bleErrors[ERROR_COUNT];
+static std::atomic<uint32_t> httpErrors[ERROR_COUNT];
+
+static void observe(LatencyHistogram& histogram, int64_t durationUs) {
+    uint32_t duration = durationUs < 0 ? 0 : durationUs > UINT32_MAX ? UINT32_MAX : (uint32_t)durationUs;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && duration > latencyBoundsUs[bucket]) {
+        bucket++;
+    }
+    histogram.Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram.SumUs.fetch_add(duration, std::memory_order_relaxed);
+}
+
+static size_t errorIndex(const char* error) {
+    for (size_t i = 0; i < ERROR_COUNT - 1; ++i) {
+        if (strcmp(errorMessages[i], error) == 0) {
+            return i;
+        }
+    }
+    return ERROR_COUNT - 1;
+}
+
+void recordBleLatency(BleOperation operation, int64_t durationUs) {
+    if (operation >= 0 && operation < BLE_OP_COUNT) {
+        observe(bleLatency[operation], durationUs);
+    }
+}
+
+void recordHttpLatency(int route, int64_t durationUs) {
+    if (route >= 0 && route < METRICS_MAX_ROUTES) {
+        observe(httpLatency[route], durationUs);
+    }
+}
+
+void recordHttpCache(int route, bool hit) {
+    if (route >= 0 && route < METRICS_MAX_ROUTES) {
+        (hit ? httpCacheHits : httpCacheMisses)[route].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void getHttpCacheStats(int route, HttpCacheStats& out) {
+    bool recorded = route >= 0 && route < METRICS_MAX_ROUTES;
+    out.Hits = recorded ? httpCacheHits[route].load(std::memory_order_relaxed) : 0;
+    out.Misses = recorded ? httpCacheMisses[route].load(std::memory_order_relaxed) : 0;
+}
+
+void countBleError(const char* error) {
+    bleErrors[errorIndex(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void countHttpError(const char* error) {
+    httpErrors[errorIndex(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint32_t histogramCount(const LatencyHistogram& histogram) {
+    uint32_t count = 0;
+    for (const std::atomic<uint32_t>& bucket : histogram.Buckets) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+static size_t routeCountRecorded() {
+    return min(routeCount, (size_t)METRICS_MAX_ROUTES);
+}
+
+size_t metricsSize() {
+    size_t lines = BLE_OP_COUNT * (LATENCY_BUCKETS + 2) + 2 * ERROR_COUNT + 3;
+    size_t size = METRICS_HEADER_SIZE;
+    for (size_t route = 0; route < routeCountRecorded(); ++route) {
+        // routes without requests are left out, one is reserved for a request arriving meanwhile
+        if (histogramCount(httpLatency[route]) > 0) {
+            size += (LATENCY_BUCKETS + 2) * (METRICS_LINE_SIZE + strlen(routes[route].Pattern));
+        }
+        // a hit and a miss line, the counters of all routes may change meanwhile
+        size += 2 * (METRICS_LINE_SIZE + strlen(routes[route].Pattern));
+    }
+    size_t longestPattern = 0;
+    for (size_t route = 0; route < routeCount; ++route) {
+        longestPattern = max(longestPattern, strlen(routes[route].Pattern));
+    }
+    size += (LATENCY_BUCKETS + 2) * (METRICS_LINE_SIZE + longestPattern);
+    return size + lines * METRICS_LINE_SIZE;
+}
+
+static void appendHeader(ResponseBuffer& out, const char* name, const char* type, const char* help) {
+    out.append("# HELP ");
+    out.append(name);
+    out.append(' ');
+    out.append(help);
+    out.append("\n# TYPE ");
+    out.append(name);
+    out.append(' ');
+    out.append(type);
+    out.append('\n');
+}
+
+static void appendLabel(ResponseBuffer& out, const char* name, const char* value) {
+    out.append(name);
+    out.append("=\"");
+    for (const char* c = value; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out.append('\\');
+        }
+        out.append(*c);
+    }
+    out.append("\",");
+}
+
+// "/pantabox/{mac}/{pin}/api/charger/state" is labeled as "/pantabox/*/*/api/charger/state",
+// like the regex patterns the routes had before
+static void appendRouteLabels(ResponseBuffer& out, const Route& route) {
+    static const char* const methods[] = {"GET", "PUT", "POST"};
+    appendLabel(out, "method", methods[route.Method]);
+    out.append("route=\"");
+    for (const char* c = route.Pattern; *c; ++c) {
+        if (*c == '{') {
+            out.append('*');
+            c = strchr(c, '}');
+        } else if (*c != '"') {
+            out.append(*c);
+        }
+    }
+    out.append("\",");
+}
+
+// labels are the ones of the series, each followed by a comma
+static void appendHistogram(ResponseBuffer& out, const char* name, const char* labels, size_t labelsLength,
+                            const LatencyHistogram& histogram) {
+    uint32_t cumulative = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        cumulative += histogram.Buckets[bucket].load(std::memory_order_relaxed);
+        out.append(name);
+        out.append("_bucket{");
+        out.append(labels, labelsLength);
+        out.append("le=\"");
+        out.append(latencyBoundLabels[bucket]);
+        out.append("\"} ");
+        out.appendUnsigned(cumulative);
+        out.append('\n');
+    }
+    // the last series of a label set must not end with a comma
+    size_t trimmed = labelsLength > 0 ? labelsLength - 1 : 0;
+    out.append(name);
+    out.append("_sum{");
+    out.append(labels, trimmed);
+    out.append("} ");
+    out.appendFixed(histogram.SumUs.load(std::memory_order_relaxed), 6);
+    out.append('\n');
+    out.append(name);
+    out.append("_count{");
+    out.append(labels, trimmed);
+    out.append("} ");
+    out.appendUnsigned(cumulative);
+    out.append('\n');
+}
+
+static void appendErrors(ResponseBuffer& out, const char* name, const std::atomic<uint32_t>* counters) {
+    for (size_t i = 0; i < ERROR_COUNT; ++i) {
+        out.append(name);
+        out.append("{error=\"");
+        out.append(errorMessages[i]);
+        out.append("\"} ");
+        out.appendUnsigned(counters[i].load(std::memory_order_relaxed));
+        out.append('\n');
+    }
+}
+
+static void appendGauge(ResponseBuffer& out, const char* name, const char* help, uint32_t value) {
+    appendHeader(out, name, "gauge", help);
+    out.append(name);
+    out.append(' ');
+    out.appendUnsigned(value);
+    out.append('\n');
+}
+
+void writeMetrics(ResponseBuffer& out) {
+    char labelStorage[METRICS_LINE_SIZE * 2];
+    ResponseBuffer labels(labelStorage, sizeof(labelStorage));
+
+    appendHeader(out, "nrg_ble_operation_seconds", "histogram",
+                 "Duration of BLE scans, connects, discoveries, characteristic reads and writes.");
+    for (int operation = 0; operation < BLE_OP_COUNT; ++operation) {
+        labels.clear();
+        appendLabel(labels, "op", bleOperationLabels[operation].Operation);
+        if (bleOperationLabels[operation].Characteristic) {
+            appendLabel(labels, "characteristic", bleOperationLabels[operation].Characteristic);
+        }
+        appendHistogram(out, "nrg_ble_operation_seconds", labels.c_str(), labels.length(), bleLatency[operation]);
+    }
+
+    appendHeader(out, "nrg_http_response_seconds", "histogram",
+                 "Time from receiving a request until its response was sent, including BLE reads it waited for.");
+    for (size_t route = 0; route < routeCountRecorded(); ++route) {
+        if (histogramCount(httpLatency[route]) == 0) {
+            continue;
+        }
+        labels.clear();
+        appendRouteLabels(labels, routes[route]);
+        appendHistogram(out, "nrg_http_response_seconds", labels.c_str(), labels.length(), httpLatency[route]);
+    }
+
+    appendHeader(out, "nrg_http_cache_responses_total", "counter",
+                 "Responses of routes with an ETag, result hit for 304 Not Modified and miss for the full body.");
+    for (size_t route = 0; route < routeCountRecorded(); ++route) {
+        HttpCacheStats cache;
+        getHttpCacheStats(route, cache);
+        if (cache.Hits == 0 && cache.Misses == 0) {
+            continue;
+        }
+        labels.clear();
+        appendRouteLabels(labels, routes[route]);
+        out.append("nrg_http_cache_responses_total{");
+        out.append(labels.c_str(), labels.length());
+        out.append("result=\"hit\"} ");
+        out.appendUnsigned(cache.Hits);
+        out.append("\nnrg_http_cache_responses_total{");
+        out.append(labels.c_str(), labels.length());
+        out.append("result=\"miss\"} ");
+        out.appendUnsigned(cache.Misses);
+        out.append('\n');
+    }
+
+    appendHeader(out, "nrg_ble_errors_total", "counter", "Failed BLE sessions by error.");
+    appendErrors(out, "nrg_ble_errors_total", bleErrors);
+    appendHeader(out, "nrg_http_errors_total", "counter", "Error responses by error.");
+    appendErrors(out, "nrg_http_errors_total", httpErrors);
+
+    appendGauge(out, "nrg_heap_free_bytes", "Free heap.", ESP.getFreeHeap());
+    appendGauge(out, "nrg_heap_largest_free_block_bytes", "Largest block that can be allocated.",
+                ESP.getMaxAllocHeap());
+    appendGauge(out, "nrg_heap_min_free_bytes", "Lowest free heap since boot.", ESP.getMinFreeHeap());
+}
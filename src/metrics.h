@@ -0,0 +1,86 @@
+#pragma once
+#include <Arduino.h>
+
+#include "response_buffer.h"
+
+// Maximum number of routes whose response latency is recorded
+#ifndef METRICS_MAX_ROUTES
+#define METRICS_MAX_ROUTES 24
+#endif
+
+// BLE operations with a latency histogram, reads are recorded per characteristic
+enum BleOperation {
+    BLE_OP_SCAN,
+    BLE_OP_CONNECT,
+    BLE_OP_DISCOVER,
+    BLE_OP_READ_ENERGY,
+    BLE_OP_READ_POWER,
+    BLE_OP_READ_VOLTAGE_CURRENT,
+    BLE_OP_READ_INFO,
+    BLE_OP_WRITE_SETTINGS,
+    BLE_OP_COUNT
+};
+
+// The read of the characteristic holding a SnapshotPart
+#define BLE_OP_READ(part) ((BleOperation)(BLE_OP_READ_ENERGY + (part)))
+
+/**
+ * @brief Records the duration of a BLE operation. Lock-free and without allocations.
+ * @param operation The operation.
+ * @param durationUs The duration in microseconds, including failed attempts.
+ */
+void recordBleLatency(BleOperation operation, int64_t durationUs);
+
+/**
+ * @brief Records the time from receiving a request until its response was sent.
+ *        Lock-free and without allocations.
+ * @param route Index of the route in the routes table.
+ * @param durationUs The duration in microseconds.
+ */
+void recordHttpLatency(int route, int64_t durationUs);
+
+// Responses of a route that can be revalidated with its ETag
+struct HttpCacheStats {
+    // answered with 304 Not Modified
+    uint32_t Hits;
+    // answered with the full body
+    uint32_t Misses;
+};
+
+/**
+ * @brief Counts a response of a route that carries an ETag. Lock-free and without allocations.
+ * @param route Index of the route in the routes table.
+ * @param hit true if the client's copy was still current and 304 was sent.
+ */
+void recordHttpCache(int route, bool hit);
+
+/**
+ * @brief Returns the cache counters of a route.
+ * @param route Index of the route in the routes table.
+ * @param out Stats to copy into.
+ */
+void getHttpCacheStats(int route, HttpCacheStats& out);
+
+/**
+ * @brief Counts an error of a BLE session, e.g. a failed connect or read.
+ * @param error The error message.
+ */
+void countBleError(const char* error);
+
+/**
+ * @brief Counts an error sent to a client, e.g. a snapshot that is not usable.
+ * @param error The error message.
+ */
+void countHttpError(const char* error);
+
+/**
+ * @brief Returns an upper bound of the size of the metrics in the Prometheus text format.
+ * @return The size in bytes including the terminator.
+ */
+size_t metricsSize();
+
+/**
+ * @brief Writes all metrics in the Prometheus text format.
+ * @param out Buffer of at least metricsSize() bytes.
+ */
+void writeMetrics(ResponseBuffer& out);
@@ -0,0 +1,286 @@
+#include "modbus.h"
+
+#include <esp_timer.h>
+
+#include "refresh.h"
+#include "settings_shadow.h"
+#include "snapshot.h"
+#include "snapshot_fields.h"
+
+#define FUNCTION_READ_HOLDING 0x03
+#define FUNCTION_READ_INPUT 0x04
+#define FUNCTION_WRITE_SINGLE 0x06
+#define FUNCTION_WRITE_MULTIPLE 0x10
+
+#define EXCEPTION_ILLEGAL_FUNCTION 0x01
+#define EXCEPTION_ILLEGAL_ADDRESS 0x02
+#define EXCEPTION_ILLEGAL_VALUE 0x03
+#define EXCEPTION_BUSY 0x06
+#define EXCEPTION_GATEWAY_PATH 0x0A
+#define EXCEPTION_GATEWAY_TARGET 0x0B
+
+// Transaction id, protocol id, length and unit id
+#define MBAP_SIZE 7
+
+// Limits of the standard for one request
+#define MAX_READ_REGISTERS 125
+#define MAX_WRITE_REGISTERS 123
+
+#define FIELD_REGISTER_COUNT (SNAPSHOT_FIELD_COUNT * 2)
+#define STATUS_REGISTER_COUNT (1 + PART_COUNT)
+#define HOLDING_REGISTER_COUNT 3
+
+// Counts the releases of each unit, PINs written before a release are void
+static uint32_t unitReleases[MAX_CHARGERS];
+static ModbusStats stats;
+static portMUX_TYPE modbusMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint16_t readU16(const uint8_t* data) {
+    return (data[0] << 8) | data[1];
+}
+
+static void writeU16(uint8_t* data, uint16_t value) {
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+static size_t exception(uint8_t* pdu, uint8_t code) {
+    pdu[0] |= 0x80;
+    pdu[1] = code;
+    portENTER_CRITICAL(&modbusMux);
+    stats.Exceptions++;
+    portEXIT_CRITICAL(&modbusMux);
+    return 2;
+}
+
+// Loads the snapshot parts a request needs, stale parts are refreshed in the background
+// for the next request; returns an exception code or 0
+static uint8_t loadParts(int slot, uint8_t parts, ChargerSnapshot& snapshot) {
+    int64_t age;
+    bool usable = loadSnapshot(slot, parts, snapshot, age);
+    uint8_t stale = staleParts(snapshot, parts, snapshotNow());
+    if (stale) {
+        requestRefresh(slot, stale, NULL, NULL);
+    }
+    return usable || parts == 0 ? 0 : EXCEPTION_GATEWAY_TARGET;
+}
+
+// Two registers per snapshot field as signed 32 bit value, high word first,
+// followed by the valid parts and the age of each part in seconds
+static size_t readInputRegisters(int slot, uint16_t start, uint16_t count, uint8_t* pdu) {
+    bool fields = start + count <= FIELD_REGISTER_COUNT;
+    bool status = start >= MODBUS_STATUS_REGISTER && start + count <= MODBUS_STATUS_REGISTER + STATUS_REGISTER_COUNT;
+    if (!fields && !status) {
+        return exception(pdu, EXCEPTION_ILLEGAL_ADDRESS);
+    }
+    uint8_t parts = 0;
+    for (uint16_t i = start; fields && i < start + count; ++i) {
+        parts |= PART_BIT(snapshotFields[i / 2].Part);
+    }
+    ChargerSnapshot snapshot;
+    uint8_t code = loadParts(slot, parts, snapshot);
+    if (code) {
+        return exception(pdu, code);
+    }
+
+    int64_t now = snapshotNow();
+    pdu[1] = count * 2;
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t address = start + i;
+        uint16_t value;
+        if (fields) {
+            uint32_t field = (uint32_t)(int32_t)readSnapshotField(snapshot, snapshotFields[address / 2]);
+            value = address % 2 == 0 ? field >> 16 : field & 0xFFFF;
+        } else if (address == MODBUS_STATUS_REGISTER) {
+            value = snapshot.Valid;
+        } else {
+            int part = address - MODBUS_STATUS_REGISTER - 1;
+            int64_t ageS = (now - snapshot.ReadAt[part]) / 1000000;
+            value = (snapshot.Valid & PART_BIT(part)) ? (uint16_t)min(ageS, (int64_t)0xFFFE) : 0xFFFF;
+        }
+        writeU16(pdu + 2 + i * 2, value);
+    }
+    return 2 + count * 2;
+}
+
+static size_t readHoldingRegisters(int slot, uint16_t start, uint16_t count, uint8_t* pdu) {
+    if (start + count > HOLDING_REGISTER_COUNT) {
+        return exception(pdu, EXCEPTION_ILLEGAL_ADDRESS);
+    }
+    ChargerSnapshot snapshot;
+    uint8_t code = loadParts(slot, PART_BIT(PART_INFO), snapshot);
+    if (code) {
+        return exception(pdu, code);
+    }
+    pdu[1] = count * 2;
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t address = start + i;
+        uint16_t value = 0;
+        if (address == MODBUS_REGISTER_CURRENT) {
+            value = snapshot.InfoData.Current;
+        } else if (address == MODBUS_REGISTER_ENABLED) {
+            value = snapshot.InfoData.PauseCharging ? 0 : 1;
+        }
+        // the PIN reads as 0
+        writeU16(pdu + 2 + i * 2, value);
+    }
+    return 2 + count * 2;
+}
+
+// Applies written holding registers, current and enabled are queued as one settings change.
+// The PIN is kept per connection like the HTTP API takes it per request, a client cannot
+// write with the PIN another client wrote.
+static uint8_t writeRegisters(ModbusConnection& connection, int slot, uint16_t start, uint16_t count,
+                              const uint8_t* values) {
+    if (start + count > HOLDING_REGISTER_COUNT) {
+        return EXCEPTION_ILLEGAL_ADDRESS;
+    }
+    SettingsChange change = {0, -1, -1};
+    uint16_t pin = 0;
+    bool pinWritten = false;
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t value = readU16(values + i * 2);
+        switch (start + i) {
+            case MODBUS_REGISTER_CURRENT:
+                if (value < 6 || value > 32) {
+                    return EXCEPTION_ILLEGAL_VALUE;
+                }
+                change.Current = value;
+                break;
+            case MODBUS_REGISTER_ENABLED:
+                if (value > 1) {
+                    return EXCEPTION_ILLEGAL_VALUE;
+                }
+                change.PauseCharging = value ? 0 : 1;
+                break;
+            default:
+                pin = value;
+                pinWritten = true;
+                break;
+        }
+    }
+    portENTER_CRITICAL(&modbusMux);
+    if (pinWritten) {
+        connection.Pins[slot] = pin;
+        connection.PinUnits[slot] = unitReleases[slot];
+    }
+    change.Pin = connection.PinUnits[slot] == unitReleases[slot] ? connection.Pins[slot] : 0;
+    portEXIT_CRITICAL(&modbusMux);
+
+    if ((change.Current < 0 && change.PauseCharging < 0) || settingsUnchanged(slot, change)) {
+        return 0;
+    }
+    // acknowledged once queued, the result shows in the registers after the write
+    if (queueSettingsChange(slot, change, NULL, NULL) != SETTINGS_QUEUED) {
+        return EXCEPTION_BUSY;
+    }
+    portENTER_CRITICAL(&modbusMux);
+    stats.Writes++;
+    portEXIT_CRITICAL(&modbusMux);
+    return 0;
+}
+
+static size_t handlePdu(ModbusConnection& connection, int slot, uint8_t* pdu, size_t length) {
+    if (pdu[0] != FUNCTION_READ_HOLDING && pdu[0] != FUNCTION_READ_INPUT && pdu[0] != FUNCTION_WRITE_SINGLE &&
+        pdu[0] != FUNCTION_WRITE_MULTIPLE) {
+        return exception(pdu, EXCEPTION_ILLEGAL_FUNCTION);
+    }
+    // all supported functions start with an address and a count or value
+    if (length < 5) {
+        return exception(pdu, EXCEPTION_ILLEGAL_VALUE);
+    }
+    uint16_t start = readU16(pdu + 1);
+    uint16_t count = readU16(pdu + 3);
+    switch (pdu[0]) {
+        case FUNCTION_READ_HOLDING:
+        case FUNCTION_READ_INPUT:
+            if (count < 1 || count > MAX_READ_REGISTERS) {
+                return exception(pdu, EXCEPTION_ILLEGAL_VALUE);
+            }
+            return pdu[0] == FUNCTION_READ_INPUT ? readInputRegisters(slot, start, count, pdu)
+                                                 : readHoldingRegisters(slot, start, count, pdu);
+        case FUNCTION_WRITE_SINGLE: {
+            // the value takes the place of the count, the response echoes the request
+            uint8_t code = writeRegisters(connection, slot, start, 1, pdu + 3);
+            return code ? exception(pdu, code) : 5;
+        }
+        default: {
+            // FUNCTION_WRITE_MULTIPLE
+            if (count < 1 || count > MAX_WRITE_REGISTERS || length < 6 || pdu[5] != count * 2 ||
+                length < 6 + (size_t)count * 2) {
+                return exception(pdu, EXCEPTION_ILLEGAL_VALUE);
+            }
+            uint8_t code = writeRegisters(connection, slot, start, count, pdu + 6);
+            return code ? exception(pdu, code) : 5;
+        }
+    }
+}
+
+size_t handleModbusFrame(ModbusConnection& connection, const uint8_t* request, size_t length, uint8_t* response) {
+    int64_t start = esp_timer_get_time();
+    // the response keeps the header and function code, the PDU is answered in place
+    memcpy(response, request, length);
+    uint8_t* pdu = response + MBAP_SIZE;
+    size_t pduLength = length - MBAP_SIZE;
+
+    // unit 1 is the first registered charger, unit 0 is the broadcast address
+    int slot = response[6] - 1;
+    if (!chargerRegistered(slot)) {
+        pduLength = exception(pdu, EXCEPTION_GATEWAY_PATH);
+    } else {
+        // Modbus clients keep a charger registered like HTTP clients
+        touchCharger(slot);
+        pduLength = handlePdu(connection, slot, pdu, pduLength);
+    }
+    writeU16(response + 4, pduLength + 1);
+
+    uint32_t durationUs = (uint32_t)(esp_timer_get_time() - start);
+    portENTER_CRITICAL(&modbusMux);
+    stats.Requests++;
+    stats.MaxResponseUs = max(stats.MaxResponseUs, durationUs);
+    portEXIT_CRITICAL(&modbusMux);
+    return MBAP_SIZE + pduLength;
+}
+
+bool receiveModbusData(ModbusConnection& connection, const uint8_t* data, size_t length, ModbusSender send,
+                       void* context) {
+    uint8_t response[MODBUS_MAX_FRAME];
+    while (length > 0) {
+        size_t copied = min(length, sizeof(connection.Buffer) - connection.Length);
+        memcpy(connection.Buffer + connection.Length, data, copied);
+        connection.Length += copied;
+        data += copied;
+        length -= copied;
+
+        // requests may arrive split or several in one segment
+        while (connection.Length >= MBAP_SIZE) {
+            uint16_t protocol = readU16(connection.Buffer + 2);
+            uint16_t frameLength = 6 + readU16(connection.Buffer + 4);
+            if (protocol != 0 || frameLength < MBAP_SIZE + 1 || frameLength > MODBUS_MAX_FRAME) {
+                return false;
+            }
+            if (connection.Length < frameLength) {
+                break;
+            }
+            send(context, response, handleModbusFrame(connection, connection.Buffer, frameLength, response));
+            connection.Length -= frameLength;
+            memmove(connection.Buffer, connection.Buffer + frameLength, connection.Length);
+        }
+    }
+    return true;
+}
+
+void releaseModbusUnit(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&modbusMux);
+    unitReleases[slot]++;
+    portEXIT_CRITICAL(&modbusMux);
+}
+
+void getModbusStats(ModbusStats& out) {
+    portENTER_CRITICAL(&modbusMux);
+    out = stats;
+    portEXIT_CRITICAL(&modbusMux);
+}
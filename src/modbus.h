@@ -0,0 +1,91 @@
+#pragma once
+#include <Arduino.h>
+
+#include "snapshot.h"
+
+// Set to 0 to compile the Modbus TCP server out
+#ifndef MODBUS_ENABLED
+#define MODBUS_ENABLED 1
+#endif
+
+#ifndef MODBUS_PORT
+#define MODBUS_PORT 502
+#endif
+
+// Maximum number of Modbus TCP connections at the same time
+#ifndef MODBUS_MAX_CLIENTS
+#define MODBUS_MAX_CLIENTS 4
+#endif
+
+// MBAP header and the largest PDU
+#define MODBUS_MAX_FRAME 260
+
+// Input registers holding the status of a charger, after the two registers of each snapshot field
+#define MODBUS_STATUS_REGISTER 100
+
+// Holding registers
+#define MODBUS_REGISTER_CURRENT 0
+#define MODBUS_REGISTER_ENABLED 1
+#define MODBUS_REGISTER_PIN 2
+
+// A Modbus TCP connection, zeroed when it is opened
+struct ModbusConnection {
+    // bytes received that do not form a complete request yet
+    uint8_t Buffer[MODBUS_MAX_FRAME];
+    size_t Length;
+    // PIN written to MODBUS_REGISTER_PIN per unit, only used for the writes of this connection
+    uint16_t Pins[MAX_CHARGERS];
+    // release count of the unit when its PIN was written, the PIN of a released unit is void
+    uint32_t PinUnits[MAX_CHARGERS];
+};
+
+struct ModbusStats {
+    uint32_t Requests;
+    uint32_t Exceptions;
+    uint32_t Writes;
+    // longest time to answer a request in microseconds
+    uint32_t MaxResponseUs;
+};
+
+/**
+ * @brief Called with each response of a connection.
+ * @param context The context passed to receiveModbusData.
+ * @param frame The response frame.
+ * @param length Length of the frame.
+ */
+typedef void (*ModbusSender)(void* context, const uint8_t* frame, size_t length);
+
+/**
+ * @brief Answers a Modbus TCP request frame from the snapshots, writes are queued as settings
+ *        changes and acknowledged without waiting for the BLE write.
+ * @param connection The connection of the request, holds the PINs it wrote.
+ * @param request The request frame including the MBAP header.
+ * @param length Length of the request frame.
+ * @param response Receives the response frame, MODBUS_MAX_FRAME bytes.
+ * @return Length of the response.
+ */
+size_t handleModbusFrame(ModbusConnection& connection, const uint8_t* request, size_t length, uint8_t* response);
+
+/**
+ * @brief Appends data received on a connection and answers the complete requests in it.
+ * @param connection The connection, Length is 0 for a new one.
+ * @param data The received data.
+ * @param length Length of the data.
+ * @param send Called with each response.
+ * @param context Passed to send.
+ * @return false if the data is no Modbus TCP, the connection should be closed.
+ */
+bool receiveModbusData(ModbusConnection& connection, const uint8_t* data, size_t length, ModbusSender send,
+                       void* context);
+
+/**
+ * @brief Voids the PINs all connections wrote for the unit of a released charger slot.
+ * @param slot The charger slot.
+ */
+void releaseModbusUnit(int slot);
+
+/**
+ * @brief Returns the Modbus statistics.
+ * @param out Stats to copy into.
+ */
+void getModbusStats(ModbusStats& out);
@@ -0,0 +1,133 @@
+#pragma once
+// Minimal Arduino and FreeRTOS API for the native build.
+// Only what the platform independent gateway code uses is provided.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+using std::max;
+using std::min;
+
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 38
+size_t strlcpy(char* destination, const char* source, size_t size);
+#endif
+
+class String {
+public:
+    String() {}
+    String(const char* value) : value(value ? value : "") {}
+    String(const char* value, size_t length) : value(value, length) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(int number) : value(std::to_string(number)) {}
+    explicit String(unsigned int number) : value(std::to_string(number)) {}
+    explicit String(long number) : value(std::to_string(number)) {}
+    explicit String(unsigned long number) : value(std::to_string(number)) {}
+    explicit String(long long number) : value(std::to_string(number)) {}
+    explicit String(unsigned long long number) : value(std::to_string(number)) {}
+    explicit String(double number, unsigned int decimals = 2);
+
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    void reserve(unsigned int size) { value.reserve(size); }
+    long toInt() const { return atol(value.c_str()); }
+    bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+
+    bool concat(const char* text) { value += text; return true; }
+    bool concat(const char* text, unsigned int length) { value.append(text, length); return true; }
+    bool concat(char c) { value += c; return true; }
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* text) { value += text; return *this; }
+    String& operator+=(char c) { value += c; return *this; }
+
+    bool operator==(const String& other) const { return value == other.value; }
+    bool operator==(const char* text) const { return value == text; }
+    bool operator!=(const String& other) const { return value != other.value; }
+    char operator[](unsigned int index) const { return value[index]; }
+
+private:
+    std::string value;
+};
+
+inline String operator+(const String& a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, const char* b) { String s(a); s += b; return s; }
+inline String operator+(const char* a, const String& b) { String s(a); s += b; return s; }
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    void setOutput(FILE* out) { output = out; }
+    size_t print(const char* text);
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t print(int number) { return print((long)number); }
+    size_t print(unsigned int number) { return print((unsigned long)number); }
+    size_t print(long number);
+    size_t print(unsigned long number);
+    size_t print(double number);
+    size_t println(const char* text = "");
+    size_t println(const String& text) { return println(text.c_str()); }
+    size_t println(int number) { return println((long)number); }
+    size_t println(unsigned int number) { return println((unsigned long)number); }
+    size_t println(long number);
+    size_t println(unsigned long number);
+    size_t println(double number);
+    operator bool() const { return true; }
+
+private:
+    FILE* output = stderr;
+};
+
+extern HardwareSerial Serial;
+
+// Heap of the ESP32, simulated from the operator new allocations of the process
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getMinFreeHeap();
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// FreeRTOS
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef struct NativeQueue* QueueHandle_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// critical sections are mutexes, the ESP32 spinlocks may be taken recursively as well
+struct portMUX_TYPE {
+    std::recursive_mutex Mutex;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->Mutex.lock()
+#define portEXIT_CRITICAL(mux) (mux)->Mutex.unlock()
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackSize, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
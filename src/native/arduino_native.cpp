@@ -0,0 +1,151 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "heap_counter.h"
+
+// Heap available to the firmware on an ESP32 without PSRAM
+#define NATIVE_HEAP_SIZE (300 * 1024)
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 38
+size_t strlcpy(char* destination, const char* source, size_t size) {
+    size_t length = strlen(source);
+    if (size > 0) {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(destination, source, copied);
+        destination[copied] = 0;
+    }
+    return length;
+}
+#endif
+
+String::String(double number, unsigned int decimals) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+    value = buffer;
+}
+
+static uint32_t remainingHeap(int64_t used) {
+    return used >= NATIVE_HEAP_SIZE ? 0 : (uint32_t)(NATIVE_HEAP_SIZE - used);
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return remainingHeap(getHeapStats().CurrentBytes);
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    // the host heap does not fragment
+    return getFreeHeap();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return remainingHeap(getHeapStats().PeakBytes);
+}
+
+size_t HardwareSerial::print(const char* text) {
+    return output ? fprintf(output, "%s", text) : 0;
+}
+
+size_t HardwareSerial::print(long number) {
+    return output ? fprintf(output, "%ld", number) : 0;
+}
+
+size_t HardwareSerial::print(unsigned long number) {
+    return output ? fprintf(output, "%lu", number) : 0;
+}
+
+size_t HardwareSerial::print(double number) {
+    return output ? fprintf(output, "%.2f", number) : 0;
+}
+
+size_t HardwareSerial::println(const char* text) {
+    return output ? fprintf(output, "%s\n", text) : 0;
+}
+
+size_t HardwareSerial::println(long number) {
+    return output ? fprintf(output, "%ld\n", number) : 0;
+}
+
+size_t HardwareSerial::println(unsigned long number) {
+    return output ? fprintf(output, "%lu\n", number) : 0;
+}
+
+size_t HardwareSerial::println(double number) {
+    return output ? fprintf(output, "%.2f\n", number) : 0;
+}
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long millis() {
+    return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)esp_timer_get_time();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+struct NativeQueue {
+    size_t Length;
+    size_t ItemSize;
+    std::deque<std::vector<uint8_t>> Items;
+    std::mutex Mutex;
+    std::condition_variable Available;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    NativeQueue* queue = new NativeQueue();
+    queue->Length = length;
+    queue->ItemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+    // senders never block in the gateway, so a full queue fails immediately
+    std::lock_guard<std::mutex> lock(queue->Mutex);
+    if (queue->Items.size() >= queue->Length) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->Items.emplace_back(bytes, bytes + queue->ItemSize);
+    queue->Available.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(queue->Mutex);
+    auto ready = [queue] { return !queue->Items.empty(); };
+    if (wait == portMAX_DELAY) {
+        queue->Available.wait(lock, ready);
+    } else if (!queue->Available.wait_for(lock, std::chrono::milliseconds(wait), ready)) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->Items.front().data(), queue->ItemSize);
+    queue->Items.pop_front();
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackSize, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    std::thread(task, parameter).detach();
+    return pdPASS;
+}
@@ -0,0 +1,270 @@
+#include "codec.h"
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "ble_utils.h"
+
+// Payloads in the documented big-endian layout of a charging and an idle charger, padding zeroed
+static const uint8_t energyPayload[] = {
+    0x00, 0x12, 0xD6, 0x87,  // TotalEnergy 1234567 Wh
+    0x00, 0x00, 0x20, 0xE4,  // EnergyLastCharge 8420 Wh
+    0x00, 0x00, 0x2F, 0x12,  // Energy2ndLastCharge 12050 Wh
+    0x00, 0x00, 0x14, 0xBE,  // Energy3rdLastCharge 5310 Wh
+    0x4E, 0x1D,              // ChargingEnergyLimit 19997 (disabled)
+    0x00,
+};
+
+static const uint8_t chargingPowerPayload[] = {
+    0x04, 0x50,  // TotalPower 1104
+    0x01, 0x70,  // L1 368
+    0x01, 0x71,  // L2 369
+    0x01, 0x6F,  // L3 367
+    0x04, 0x56,  // PeakPower 1110
+    0x13, 0x89,  // Frequency 5001
+    0x00, 0x26,  // Temperature 38
+    0x00, 0x78,  // RemainingDistance 120
+    0x00, 0xFA,  // Costs 250
+    0x04,        // CPSignal 4
+};
+
+static const uint8_t idlePowerPayload[] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x13, 0x86,  // Frequency 4998
+    0xFF, 0xFB,  // Temperature -5
+    0x00, 0x00, 0x00, 0x00,
+    0xFE,        // CPSignal -2
+};
+
+static const uint8_t voltageCurrentPayload[] = {
+    0x08, 0xFD, 0x08, 0xF7, 0x09, 0x06,  // VoltageL1..L3 2301, 2295, 2310
+    0x06, 0x42, 0x06, 0x3E, 0x06, 0x45,  // CurrentL1..L3 1602, 1598, 1605
+    0x00, 0x00,
+};
+
+static const uint8_t infoPayload[] = {
+    0x10,        // Current 16
+    0x07, 0xD0,  // KWhPer100 2000
+    0x1E,        // AmountPerKWh 30
+    0x01,        // FIEnabled
+    0x00,        // ErrorCode
+    0x5A,        // Efficiency 90
+    0x01,        // ChargingActive
+    0x00,        // PauseCharging
+    0x20,        // ChargingCurrentMax 32
+    0x03,        // BLETransmissionPower 3
+    0x00, 0x00,
+};
+
+// What the gateway writes for infoPayload with PIN 1234
+static const uint8_t settingsPayload[] = {
+    0x04, 0xD2,  // PIN 1234
+    0x10,        // Current 16
+    0x4E, 0x1D,  // ChargingEnergyLimit 19997 (disabled)
+    0x07, 0xD0,  // KWhPer100 2000
+    0x1E,        // AmountPerKWh 30
+    0x00, 0x00,
+    0x5A,        // Efficiency 90
+    0x00,        // PauseCharging
+    0x03,        // BLETransmissionPower 3
+    0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static_assert(sizeof(energyPayload) == sizeof(Energy), "Energy payload size");
+static_assert(sizeof(chargingPowerPayload) == sizeof(Power), "Power payload size");
+static_assert(sizeof(idlePowerPayload) == sizeof(Power), "Power payload size");
+static_assert(sizeof(voltageCurrentPayload) == sizeof(VoltageCurrent), "VoltageCurrent payload size");
+static_assert(sizeof(infoPayload) == sizeof(Info), "Info payload size");
+static_assert(sizeof(settingsPayload) == sizeof(Settings), "Settings payload size");
+
+struct CodecChecks {
+    uint32_t Payloads;
+    uint32_t Mismatches;
+};
+
+static void fail(CodecChecks& checks, const char* payload, const char* check) {
+    fprintf(stderr, "%s: %s\n", payload, check);
+    checks.Mismatches++;
+}
+
+// Decodes the payload from an aligned and an unaligned copy, compares the value with the
+// expected one and encodes it back
+template <typename T>
+static void checkPayload(CodecChecks& checks, const char* name, const uint8_t* payload, const T& expected) {
+    checks.Payloads++;
+    uint8_t buffer[sizeof(T) + 1];
+    memcpy(buffer + 1, payload, sizeof(T));
+    T value = decodeWire<T>(payload);
+    T unaligned = decodeWire<T>(buffer + 1);
+    if (memcmp(&value, &expected, sizeof(T)) != 0) {
+        fail(checks, name, "decoded value differs");
+    }
+    if (memcmp(&unaligned, &value, sizeof(T)) != 0 || memcmp(buffer + 1, payload, sizeof(T)) != 0) {
+        fail(checks, name, "unaligned decode differs or changed the payload");
+    }
+    T again = decodeWire<T>(payload);
+    if (memcmp(&again, &value, sizeof(T)) != 0) {
+        fail(checks, name, "second decode differs");
+    }
+    uint8_t encoded[sizeof(T)];
+    encodeWire(value, encoded);
+    if (memcmp(encoded, payload, sizeof(T)) != 0) {
+        fail(checks, name, "encoded payload differs");
+    }
+}
+
+static CodecChecks checkPayloads() {
+    CodecChecks checks = {};
+
+    Energy energy;
+    memset(&energy, 0, sizeof(energy));
+    energy.TotalEnergy = 1234567;
+    energy.EnergyLastCharge = 8420;
+    energy.Energy2ndLastCharge = 12050;
+    energy.Energy3rdLastCharge = 5310;
+    energy.ChargingEnergyLimit = 19997;
+    checkPayload(checks, "Energy", energyPayload, energy);
+
+    Power power;
+    memset(&power, 0, sizeof(power));
+    power.TotalPower = 1104;
+    power.L1 = 368;
+    power.L2 = 369;
+    power.L3 = 367;
+    power.PeakPower = 1110;
+    power.Frequency = 5001;
+    power.Temperature = 38;
+    power.RemainingDistance = 120;
+    power.Costs = 250;
+    power.CPSignal = 4;
+    checkPayload(checks, "Power (charging)", chargingPowerPayload, power);
+
+    memset(&power, 0, sizeof(power));
+    power.Frequency = 4998;
+    power.Temperature = -5;
+    power.CPSignal = -2;
+    checkPayload(checks, "Power (idle)", idlePowerPayload, power);
+
+    VoltageCurrent voltageCurrent;
+    memset(&voltageCurrent, 0, sizeof(voltageCurrent));
+    voltageCurrent.VoltageL1 = 2301;
+    voltageCurrent.VoltageL2 = 2295;
+    voltageCurrent.VoltageL3 = 2310;
+    voltageCurrent.CurrentL1 = 1602;
+    voltageCurrent.CurrentL2 = 1598;
+    voltageCurrent.CurrentL3 = 1605;
+    checkPayload(checks, "VoltageCurrent", voltageCurrentPayload, voltageCurrent);
+
+    Info info;
+    memset(&info, 0, sizeof(info));
+    info.Current = 16;
+    info.KWhPer100 = 2000;
+    info.AmountPerKWh = 30;
+    info.FIEnabled = 1;
+    info.Efficiency = 90;
+    info.ChargingActive = 1;
+    info.ChargingCurrentMax = 32;
+    info.BLETransmissionPower = 3;
+    checkPayload(checks, "Info", infoPayload, info);
+
+    // the write the gateway builds from the decoded Info
+    Settings settings = convertToSettings(convertInfo(infoPayload), 1234);
+    checkPayload(checks, "Settings", settingsPayload, settings);
+    return checks;
+}
+
+// The decoders before the wire schemas swapped the payload in place, so each decode
+// needs its own copy of the payload
+static Power decodePowerInPlace(uint8_t* data) {
+    Power* power = (Power*)data;
+    power->TotalPower = __builtin_bswap16(power->TotalPower);
+    power->L1 = __builtin_bswap16(power->L1);
+    power->L2 = __builtin_bswap16(power->L2);
+    power->L3 = __builtin_bswap16(power->L3);
+    power->PeakPower = __builtin_bswap16(power->PeakPower);
+    power->Frequency = __builtin_bswap16(power->Frequency);
+    power->Temperature = (int16_t)__builtin_bswap16((uint16_t)power->Temperature);
+    power->RemainingDistance = __builtin_bswap16(power->RemainingDistance);
+    power->Costs = __builtin_bswap16(power->Costs);
+    return *power;
+}
+
+static Energy decodeEnergyInPlace(uint8_t* data) {
+    Energy* energy = (Energy*)data;
+    energy->TotalEnergy = __builtin_bswap32(energy->TotalEnergy);
+    energy->EnergyLastCharge = __builtin_bswap32(energy->EnergyLastCharge);
+    energy->Energy2ndLastCharge = __builtin_bswap32(energy->Energy2ndLastCharge);
+    energy->Energy3rdLastCharge = __builtin_bswap32(energy->Energy3rdLastCharge);
+    energy->ChargingEnergyLimit = __builtin_bswap16(energy->ChargingEnergyLimit);
+    return *energy;
+}
+
+static void encodeSettingsSwapped(const Settings& settings, uint8_t* data) {
+    Settings swapped = settings;
+    swapped.PIN = __builtin_bswap16(settings.PIN);
+    swapped.ChargingEnergyLimit = __builtin_bswap16(settings.ChargingEnergyLimit);
+    swapped.KWhPer100 = __builtin_bswap16(settings.KWhPer100);
+    memcpy(data, &swapped, sizeof(swapped));
+}
+
+// Both variants copy the payload and vary one byte per iteration, so the compiler can
+// neither hoist the decode out of the loop nor drop it
+template <size_t Size, typename Codec>
+static double measureNs(uint32_t iterations, const uint8_t* payload, Codec codec) {
+    volatile uint32_t sink = 0;
+    uint8_t buffer[Size];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        memcpy(buffer, payload, Size);
+        buffer[1] ^= (uint8_t)iteration;
+        sink = sink + codec(buffer);
+    }
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsedNs / iterations;
+}
+
+static void printResult(const char* name, const char* baseline, double schemaNs, double baselineNs, bool last) {
+    printf("    \"%s\": {\"schemaNs\": %.1f, \"%sNs\": %.1f}%s\n", name, schemaNs, baseline, baselineNs,
+           last ? "" : ",");
+}
+
+bool runCodecBenchmark(uint32_t iterations) {
+    CodecChecks checks = checkPayloads();
+
+    double powerSchema = measureNs<sizeof(Power)>(iterations, chargingPowerPayload, [](uint8_t* data) {
+        Power power = decodeWire<Power>(data);
+        return (uint32_t)power.TotalPower + power.L1 + power.Costs;
+    });
+    double powerInPlace = measureNs<sizeof(Power)>(iterations, chargingPowerPayload, [](uint8_t* data) {
+        Power power = decodePowerInPlace(data);
+        return (uint32_t)power.TotalPower + power.L1 + power.Costs;
+    });
+    double energySchema = measureNs<sizeof(Energy)>(iterations, energyPayload, [](uint8_t* data) {
+        Energy energy = decodeWire<Energy>(data);
+        return energy.TotalEnergy + energy.EnergyLastCharge;
+    });
+    double energyInPlace = measureNs<sizeof(Energy)>(iterations, energyPayload, [](uint8_t* data) {
+        Energy energy = decodeEnergyInPlace(data);
+        return energy.TotalEnergy + energy.EnergyLastCharge;
+    });
+    double settingsSchema = measureNs<sizeof(Info)>(iterations, infoPayload, [](uint8_t* data) {
+        uint8_t encoded[sizeof(Settings)];
+        encodeWire(convertToSettings(convertInfo(data), 1234), encoded);
+        return (uint32_t)encoded[2] + encoded[5];
+    });
+    double settingsSwapped = measureNs<sizeof(Info)>(iterations, infoPayload, [](uint8_t* data) {
+        uint8_t encoded[sizeof(Settings)];
+        encodeSettingsSwapped(convertToSettings(convertInfo(data), 1234), encoded);
+        return (uint32_t)encoded[2] + encoded[5];
+    });
+
+    printf("{\n  \"codec\": {\n");
+    printf("    \"iterations\": %u,\n", iterations);
+    printf("    \"roundTrip\": {\"payloads\": %u, \"mismatches\": %u},\n", checks.Payloads, checks.Mismatches);
+    printResult("decodePower", "inPlace", powerSchema, powerInPlace, false);
+    printResult("decodeEnergy", "inPlace", energySchema, energyInPlace, false);
+    printResult("encodeSettings", "byteSwap", settingsSchema, settingsSwapped, true);
+    printf("  }\n}\n");
+    return checks.Mismatches == 0;
+}
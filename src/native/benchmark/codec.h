@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Checks the wire schema decoders and the Settings encoder against reference payloads,
+ *        then compares their speed with the in-place byte swapping they replaced and prints
+ *        the results as JSON.
+ * @param iterations Number of decodes and encodes per measurement.
+ * @return false if a payload did not decode or round-trip as expected.
+ */
+bool runCodecBenchmark(uint32_t iterations);
@@ -0,0 +1,401 @@
+// Load generator for the native build: replays evcc and Home Assistant polling
+// against simulated chargers and prints latency, BLE and heap figures as JSON.
+//
+//   .pio/build/native_bench/program --clients=8 --mix=mixed --duration=30 > result.json
+//   .pio/build/native_bench/program --routing=100000 > routing.json
+//   .pio/build/native_bench/program --codec=10000000 > codec.json
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "ble_poller.h"
+#include "codec.h"
+#include "fake_ble_central.h"
+#include "fake_http.h"
+#include "heap_counter.h"
+#include "prefetch.h"
+#include "routing.h"
+#include "simulated_charger.h"
+
+// Time to wait for deferred responses before a request counts as timed out
+#define BENCH_RESPONSE_TIMEOUT_MS 30000
+
+// Interval of the simulated charge and its notifications
+#define BENCH_SIMULATION_PERIOD_MS 1000
+
+enum ClientMix {
+    MIX_EVCC,
+    MIX_HOME_ASSISTANT,
+    MIX_MIXED
+};
+
+struct BenchOptions {
+    uint32_t Clients;
+    uint32_t Chargers;
+    uint32_t DurationS;
+    uint32_t WarmupS;
+    // time between two polling cycles of a client
+    uint32_t IntervalMs;
+    ClientMix Mix;
+    // clients revalidate with the ETag of their last response
+    bool Conditional;
+    // passes of the routing comparison, 0 runs the load test instead
+    uint32_t RoutingIterations;
+    // decodes of the codec checks and comparison, 0 runs the load test instead
+    uint32_t CodecIterations;
+    SimulationOptions Simulation;
+};
+
+// A request of a polling cycle, {mac} and {pin} are replaced per client
+struct BenchRequest {
+    const char* Name;
+    RouteMethod Method;
+    const char* Url;
+    const char* Body;
+    // the request is sent every Every-th cycle
+    uint32_t Every;
+};
+
+// evcc with the pantabox charger template polls all four values every cycle
+// and adjusts the current now and then
+static const BenchRequest evccCycle[] = {
+    {"evcc_state", ROUTE_GET, "/pantabox/{mac}/{pin}/api/charger/state", NULL, 1},
+    {"evcc_enabled", ROUTE_GET, "/pantabox/{mac}/{pin}/api/charger/enabled", NULL, 1},
+    {"evcc_power", ROUTE_GET, "/pantabox/{mac}/{pin}/api/meter/power", NULL, 1},
+    {"evcc_maxcurrent", ROUTE_GET, "/pantabox/{mac}/{pin}/api/charger/maxcurrent", NULL, 1},
+    {"evcc_current", ROUTE_POST, "/pantabox/{mac}/{pin}/api/charger/current", "16", 6},
+    {"evcc_enable", ROUTE_POST, "/pantabox/{mac}/{pin}/api/charger/enable", "true", 30},
+};
+
+// Home Assistant REST sensors poll the measurements often and the settings rarely
+static const BenchRequest homeAssistantCycle[] = {
+    {"ha_measurements", ROUTE_GET, "/api/measurements/{mac}", NULL, 1},
+    {"ha_settings", ROUTE_GET, "/api/settings/{mac}", NULL, 6},
+};
+
+struct Sample {
+    uint16_t Request;
+    int16_t Code;
+    uint32_t LatencyUs;
+    uint32_t HandlerAllocations;
+};
+
+struct ClientResult {
+    std::vector<Sample> Samples;
+};
+
+static std::atomic<bool> measuring(false);
+static std::atomic<bool> stopping(false);
+
+static const BenchRequest* allRequests[] = {
+    &evccCycle[0], &evccCycle[1], &evccCycle[2], &evccCycle[3], &evccCycle[4], &evccCycle[5],
+    &homeAssistantCycle[0], &homeAssistantCycle[1],
+};
+static const size_t requestCount = sizeof(allRequests) / sizeof(allRequests[0]);
+
+static uint16_t requestIndex(const BenchRequest* request) {
+    for (size_t i = 0; i < requestCount; ++i) {
+        if (allRequests[i] == request) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+static std::string chargerAddress(uint32_t charger) {
+    char address[18];
+    snprintf(address, sizeof(address), "00:11:22:33:44:%02X", 0x55 + charger);
+    return address;
+}
+
+static std::string expand(const char* url, const std::string& address, uint16_t pin) {
+    std::string result(url);
+    size_t position;
+    if ((position = result.find("{mac}")) != std::string::npos) {
+        result.replace(position, 5, address);
+    }
+    if ((position = result.find("{pin}")) != std::string::npos) {
+        result.replace(position, 5, std::to_string(pin));
+    }
+    return result;
+}
+
+static void runClient(uint32_t client, const BenchOptions& options, ClientResult& result) {
+    ClientMix mix = options.Mix;
+    if (mix == MIX_MIXED) {
+        mix = client % 2 == 0 ? MIX_EVCC : MIX_HOME_ASSISTANT;
+    }
+    const BenchRequest* cycle = mix == MIX_EVCC ? evccCycle : homeAssistantCycle;
+    size_t cycleLength = mix == MIX_EVCC ? sizeof(evccCycle) / sizeof(evccCycle[0])
+                                         : sizeof(homeAssistantCycle) / sizeof(homeAssistantCycle[0]);
+    std::string address = chargerAddress(client % options.Chargers);
+    std::vector<std::string> etags(cycleLength);
+    FakeHttpHeaders headers;
+
+    // clients are spread over the interval like independent pollers
+    delay(options.IntervalMs * client / options.Clients);
+    for (uint32_t iteration = 0; !stopping; ++iteration) {
+        auto cycleStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < cycleLength && !stopping; ++i) {
+            const BenchRequest& request = cycle[i];
+            if (iteration % request.Every != 0) {
+                continue;
+            }
+            std::string url = expand(request.Url, address, options.Simulation.Pin);
+            const char* body = request.Body ? request.Body : "";
+            headers.clear();
+            if (options.Conditional && !etags[i].empty()) {
+                headers.emplace_back("If-None-Match", etags[i]);
+            }
+            FakeHttpResponse response;
+            auto start = std::chrono::steady_clock::now();
+            bool answered = dispatchRequest(request.Method, url.c_str(), body, strlen(body),
+                                            BENCH_RESPONSE_TIMEOUT_MS, response, client + 1, &headers);
+            auto end = std::chrono::steady_clock::now();
+            for (const auto& header : response.Headers) {
+                if (header.first == "ETag") {
+                    etags[i] = header.second;
+                }
+            }
+            if (measuring) {
+                Sample sample;
+                sample.Request = requestIndex(&request);
+                sample.Code = answered ? response.Code : -1;
+                sample.LatencyUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+                sample.HandlerAllocations = answered ? response.HandlerAllocations : 0;
+                result.Samples.push_back(sample);
+            }
+        }
+        std::this_thread::sleep_until(cycleStart + std::chrono::milliseconds(options.IntervalMs));
+    }
+}
+
+static bool parseBenchOption(const char* arg, BenchOptions& options) {
+    unsigned long value;
+    if (sscanf(arg, "--clients=%lu", &value) == 1) {
+        options.Clients = max(value, 1UL);
+    } else if (sscanf(arg, "--chargers=%lu", &value) == 1) {
+        options.Chargers = min(max(value, 1UL), (unsigned long)MAX_CHARGERS);
+    } else if (sscanf(arg, "--duration=%lu", &value) == 1) {
+        options.DurationS = value;
+    } else if (sscanf(arg, "--warmup=%lu", &value) == 1) {
+        options.WarmupS = value;
+    } else if (sscanf(arg, "--interval=%lu", &value) == 1) {
+        options.IntervalMs = max(value, 1UL);
+    } else if (strcmp(arg, "--conditional") == 0) {
+        options.Conditional = true;
+    } else if (sscanf(arg, "--routing=%lu", &value) == 1) {
+        options.RoutingIterations = max(value, 1UL);
+    } else if (strcmp(arg, "--routing") == 0) {
+        options.RoutingIterations = 100000;
+    } else if (sscanf(arg, "--codec=%lu", &value) == 1) {
+        options.CodecIterations = max(value, 1UL);
+    } else if (strcmp(arg, "--codec") == 0) {
+        options.CodecIterations = 10000000;
+    } else if (strcmp(arg, "--mix=evcc") == 0) {
+        options.Mix = MIX_EVCC;
+    } else if (strcmp(arg, "--mix=ha") == 0) {
+        options.Mix = MIX_HOME_ASSISTANT;
+    } else if (strcmp(arg, "--mix=mixed") == 0) {
+        options.Mix = MIX_MIXED;
+    } else {
+        return parseSimulationOption(arg, options.Simulation);
+    }
+    return true;
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+static void printLatency(const char* indent, std::vector<uint32_t>& latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    printf("%s\"latencyUs\": {\"p50\": %u, \"p95\": %u, \"p99\": %u, \"max\": %u}", indent,
+           percentile(latencies, 0.50), percentile(latencies, 0.95), percentile(latencies, 0.99),
+           latencies.empty() ? 0 : latencies.back());
+}
+
+static const char* mixName(ClientMix mix) {
+    switch (mix) {
+        case MIX_EVCC:
+            return "evcc";
+        case MIX_HOME_ASSISTANT:
+            return "ha";
+        default:
+            return "mixed";
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = {};
+    options.Clients = 4;
+    options.Chargers = 1;
+    options.DurationS = 30;
+    options.WarmupS = 5;
+    options.IntervalMs = 1000;
+    options.Mix = MIX_MIXED;
+    options.Simulation = defaultSimulationOptions();
+    options.Simulation.Vehicle = VEHICLE_CHARGING;
+    for (int i = 1; i < argc; ++i) {
+        if (!parseBenchOption(argv[i], options)) {
+            fprintf(stderr, "usage: %s [options]\n", argv[0]);
+            fprintf(stderr, "  --clients=N --chargers=N --duration=S --warmup=S --interval=MS --mix=evcc|ha|mixed\n");
+            fprintf(stderr, "  --conditional  revalidate with If-None-Match\n");
+            fprintf(stderr, "  --routing[=N]  compare the route trie with the regex routes instead\n");
+            fprintf(stderr, "  --codec[=N]    check the payload codecs and compare them with byte swapping instead\n");
+            printSimulationOptions(stderr);
+            return 1;
+        }
+    }
+    if (options.RoutingIterations > 0) {
+        runRoutingBenchmark(options.RoutingIterations);
+        return 0;
+    }
+    if (options.CodecIterations > 0) {
+        return runCodecBenchmark(options.CodecIterations) ? 0 : 1;
+    }
+    // the request log of the handlers would dominate the measurement
+    Serial.setOutput(NULL);
+
+    std::vector<SimulatedCharger*> chargers;
+    std::vector<std::string> addresses;
+    for (uint32_t i = 0; i < options.Chargers; ++i) {
+        SimulatedCharger* charger = new SimulatedCharger(options.Simulation.Pin, options.Simulation.Seed + i);
+        charger->setFaults(options.Simulation.Faults);
+        charger->setNotifications(options.Simulation.Notifications);
+        charger->setVehicle(options.Simulation.Vehicle);
+        chargers.push_back(charger);
+        addresses.push_back(chargerAddress(i));
+    }
+    for (uint32_t i = 0; i < options.Chargers; ++i) {
+        fakeBleCentral().addPeripheral(addresses[i].c_str(), "NRGkick", chargers[i]);
+        startSimulation(fakeBleCentral(), addresses[i].c_str(), *chargers[i], BENCH_SIMULATION_PERIOD_MS);
+    }
+    startBlePoller();
+
+    std::vector<ClientResult> results(options.Clients);
+    std::vector<std::thread> clients;
+    for (uint32_t i = 0; i < options.Clients; ++i) {
+        // keeps the sample storage out of the heap figures of the measurement
+        results[i].Samples.reserve((options.WarmupS + options.DurationS) * 1000UL / options.IntervalMs * 8 + 64);
+        clients.emplace_back(runClient, i, std::cref(options), std::ref(results[i]));
+    }
+
+    delay(options.WarmupS * 1000UL);
+    FakeBleStats bleStart = fakeBleCentral().getStats();
+    PrefetchStats prefetchStart;
+    getPrefetchStats(prefetchStart);
+    HeapStats heapStart = getHeapStats();
+    resetHeapPeak();
+    auto start = std::chrono::steady_clock::now();
+    measuring = true;
+    delay(options.DurationS * 1000UL);
+    measuring = false;
+    auto end = std::chrono::steady_clock::now();
+    FakeBleStats bleEnd = fakeBleCentral().getStats();
+    PrefetchStats prefetchEnd;
+    getPrefetchStats(prefetchEnd);
+    HeapStats heapEnd = getHeapStats();
+    stopping = true;
+    for (std::thread& client : clients) {
+        client.join();
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::vector<uint32_t> latencies;
+    std::vector<std::vector<uint32_t>> routeLatencies(requestCount);
+    std::vector<uint32_t> routeErrors(requestCount);
+    std::vector<uint32_t> routeNotModified(requestCount);
+    std::vector<uint64_t> routeAllocations(requestCount);
+    uint64_t handlerAllocations = 0;
+    uint32_t errors = 0;
+    uint32_t timeouts = 0;
+    uint32_t notModified = 0;
+    for (const ClientResult& result : results) {
+        for (const Sample& sample : result.Samples) {
+            latencies.push_back(sample.LatencyUs);
+            routeLatencies[sample.Request].push_back(sample.LatencyUs);
+            routeAllocations[sample.Request] += sample.HandlerAllocations;
+            handlerAllocations += sample.HandlerAllocations;
+            if (sample.Code < 0) {
+                timeouts++;
+            }
+            if (sample.Code == 304) {
+                notModified++;
+                routeNotModified[sample.Request]++;
+            } else if (sample.Code < 200 || sample.Code >= 300) {
+                errors++;
+                routeErrors[sample.Request]++;
+            }
+        }
+    }
+    size_t requests = latencies.size();
+    uint32_t transactions = (bleEnd.Connects - bleStart.Connects) + (bleEnd.Discoveries - bleStart.Discoveries) +
+                            (bleEnd.Reads - bleStart.Reads) + (bleEnd.Writes - bleStart.Writes);
+
+    const SimulationFaults& faults = options.Simulation.Faults;
+    printf("{\n");
+    printf("  \"config\": {\"clients\": %u, \"chargers\": %u, \"mix\": \"%s\", \"intervalMs\": %u, \"durationS\": %u, "
+           "\"notifications\": %s, \"conditional\": %s, \"connectLatencyMs\": %u, \"readLatencyMs\": %u, \"writeLatencyMs\": %u, "
+           "\"jitterMs\": %u, \"readFailureRate\": %.3f, \"dropRate\": %.3f, \"seed\": %u},\n",
+           options.Clients, options.Chargers, mixName(options.Mix), options.IntervalMs, options.DurationS,
+           options.Simulation.Notifications ? "true" : "false", options.Conditional ? "true" : "false",
+           faults.ConnectLatencyMs, faults.ReadLatencyMs,
+           faults.WriteLatencyMs, faults.JitterMs, faults.ReadFailureRate, faults.DropRate, options.Simulation.Seed);
+    printf("  \"requests\": %zu,\n", requests);
+    printf("  \"errors\": %u,\n", errors);
+    printf("  \"notModified\": %u,\n", notModified);
+    printf("  \"timeouts\": %u,\n", timeouts);
+    printf("  \"throughputRps\": %.2f,\n", requests / seconds);
+    printLatency("  ", latencies);
+    printf(",\n");
+    printf("  \"ble\": {\"connects\": %u, \"discoveries\": %u, \"reads\": %u, \"writes\": %u, \"notifications\": %u, "
+           "\"transactionsPerRequest\": %.4f},\n",
+           bleEnd.Connects - bleStart.Connects, bleEnd.Discoveries - bleStart.Discoveries,
+           bleEnd.Reads - bleStart.Reads, bleEnd.Writes - bleStart.Writes,
+           bleEnd.Notifications - bleStart.Notifications, requests ? (double)transactions / requests : 0.0);
+    uint32_t followUps = (prefetchEnd.Hits - prefetchStart.Hits) + (prefetchEnd.Shared - prefetchStart.Shared) +
+                         (prefetchEnd.Misses - prefetchStart.Misses);
+    printf("  \"prefetch\": {\"bursts\": %u, \"prefetches\": %u, \"hits\": %u, \"shared\": %u, \"misses\": %u, "
+           "\"wasted\": %u, \"hitRate\": %.4f, \"cacheHits\": %u, \"cacheMisses\": %u},\n",
+           prefetchEnd.Bursts - prefetchStart.Bursts, prefetchEnd.Prefetches - prefetchStart.Prefetches,
+           prefetchEnd.Hits - prefetchStart.Hits, prefetchEnd.Shared - prefetchStart.Shared,
+           prefetchEnd.Misses - prefetchStart.Misses, prefetchEnd.Wasted - prefetchStart.Wasted,
+           followUps ? (double)(prefetchEnd.Hits - prefetchStart.Hits) / followUps : 0.0,
+           prefetchEnd.CacheHits - prefetchStart.CacheHits, prefetchEnd.CacheMisses - prefetchStart.CacheMisses);
+    printf("  \"heap\": {\"peakBytes\": %lld, \"growthBytes\": %lld, \"allocations\": %llu, \"allocationsPerRequest\": %.2f, "
+           "\"handlerAllocationsPerRequest\": %.2f},\n",
+           (long long)heapEnd.PeakBytes, (long long)(heapEnd.CurrentBytes - heapStart.CurrentBytes),
+           (unsigned long long)(heapEnd.Allocations - heapStart.Allocations),
+           requests ? (double)(heapEnd.Allocations - heapStart.Allocations) / requests : 0.0,
+           requests ? (double)handlerAllocations / requests : 0.0);
+    printf("  \"routes\": {");
+    bool first = true;
+    for (size_t i = 0; i < requestCount; ++i) {
+        if (routeLatencies[i].empty()) {
+            continue;
+        }
+        printf("%s\n    \"%s\": {\"requests\": %zu, \"errors\": %u, \"notModified\": %u, \"handlerAllocations\": %.2f, ",
+               first ? "" : ",", allRequests[i]->Name, routeLatencies[i].size(), routeErrors[i], routeNotModified[i],
+               (double)routeAllocations[i] / routeLatencies[i].size());
+        printLatency("", routeLatencies[i]);
+        printf("}");
+        first = false;
+    }
+    printf("\n  }\n}\n");
+
+    // the poller and simulation threads never end
+    fflush(stdout);
+    _exit(0);
+}
@@ -0,0 +1,194 @@
+#include "routing.h"
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "heap_counter.h"
+#include "router.h"
+
+// The routes table as regular expressions, in the same order, like they were registered
+// with the web server built with ASYNCWEBSERVER_REGEX
+static const char* const regexPatterns[] = {
+    "^\\/api\\/measurements\\/(.+)$",
+    "^\\/api\\/settings\\/(.+)$",
+    "^\\/api\\/snapshot\\/(.+)$",
+    "^\\/api\\/history\\/(.+)$",
+    "/api/stats",
+    "/api/devices",
+    "/metrics",
+    "/api/log",
+    "^\\/api\\/priority\\/(.+)$",
+    "^\\/api\\/settings\\/(.+)$",
+    "^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/state$",
+    "^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/enabled$",
+    "^\\/pantabox\\/(.+)\\/(.+)\\/api\\/meter\\/power$",
+    "^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/maxcurrent$",
+    "^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/enable$",
+    "^\\/pantabox\\/(.+)\\/(.+)\\/api\\/charger\\/current$",
+};
+static const size_t regexPatternCount = sizeof(regexPatterns) / sizeof(regexPatterns[0]);
+
+struct RoutedPath {
+    RouteMethod Method;
+    const char* Path;
+    // index in the routes table, -1 if no route serves the path
+    int Route;
+};
+
+// The requests of an evcc and a Home Assistant polling cycle and two the routes do not serve
+static const RoutedPath routedPaths[] = {
+    {ROUTE_GET, "/pantabox/00:11:22:33:44:55/1234/api/charger/state", 10},
+    {ROUTE_GET, "/pantabox/00:11:22:33:44:55/1234/api/charger/enabled", 11},
+    {ROUTE_GET, "/pantabox/00:11:22:33:44:55/1234/api/meter/power", 12},
+    {ROUTE_GET, "/pantabox/00:11:22:33:44:55/1234/api/charger/maxcurrent", 13},
+    {ROUTE_POST, "/pantabox/00:11:22:33:44:55/1234/api/charger/current", 15},
+    {ROUTE_GET, "/api/measurements/00:11:22:33:44:55", 0},
+    {ROUTE_GET, "/api/settings/00:11:22:33:44:55", 1},
+    {ROUTE_GET, "/metrics", 6},
+    {ROUTE_GET, "/update", -1},
+    {ROUTE_GET, "/favicon.ico", -1},
+};
+static const size_t routedPathCount = sizeof(routedPaths) / sizeof(routedPaths[0]);
+
+struct RoutingResult {
+    double NsPerRequest;
+    double AllocationsPerRequest;
+    // heap kept between requests, e.g. compiled patterns
+    int64_t HeapBytes;
+    // paths routed to another route than expected
+    uint32_t Mismatches;
+};
+
+// What the web server does per request and registered handler: the pattern is compiled
+// on each check and the captures are copied into Strings
+static int routeWithRegex(const RoutedPath& request, std::vector<String>& pathArgs) {
+    String url(request.Path);
+    for (size_t i = 0; i < regexPatternCount; ++i) {
+        if (routes[i].Method != request.Method) {
+            continue;
+        }
+        String uri(regexPatterns[i]);
+        if (uri.startsWith("^")) {
+            std::regex pattern(uri.c_str());
+            std::smatch matches;
+            std::string s(url.c_str());
+            if (!std::regex_search(s, matches, pattern)) {
+                continue;
+            }
+            for (size_t group = 1; group < matches.size(); ++group) {
+                pathArgs.emplace_back(matches[group].str().c_str());
+            }
+            return i;
+        }
+        if (uri == url || url.startsWith(uri + "/")) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The patterns compiled once, like the native fake did
+static int routeWithCompiledRegex(const RoutedPath& request, const std::vector<std::regex>& compiled,
+                                  std::vector<std::string>& pathArgs) {
+    for (size_t i = 0; i < regexPatternCount; ++i) {
+        if (routes[i].Method != request.Method) {
+            continue;
+        }
+        if (regexPatterns[i][0] != '^') {
+            if (strcmp(request.Path, regexPatterns[i]) == 0) {
+                return i;
+            }
+            continue;
+        }
+        std::cmatch match;
+        if (std::regex_match(request.Path, match, compiled[i])) {
+            for (size_t group = 1; group < match.size(); ++group) {
+                pathArgs.push_back(match[group].str());
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int routeWithTrie(const RoutedPath& request, char (&pathArgs)[HTTP_MAX_PATH_ARGS][HTTP_MAX_PATH_ARG_SIZE]) {
+    RouteMatch match;
+    size_t length = strlen(request.Path);
+    if (!matchRoute(request.Method, request.Path, length, match)) {
+        return -1;
+    }
+    for (uint8_t i = 0; i < match.ArgCount; ++i) {
+        memcpy(pathArgs[i], request.Path + match.ArgStart[i], match.ArgLength[i]);
+        pathArgs[i][match.ArgLength[i]] = 0;
+    }
+    return match.Route;
+}
+
+template <typename Lookup>
+static RoutingResult measure(uint32_t iterations, Lookup route) {
+    RoutingResult result = {};
+    uint64_t allocations = threadAllocations();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        for (size_t i = 0; i < routedPathCount; ++i) {
+            if (route(routedPaths[i]) != routedPaths[i].Route) {
+                result.Mismatches++;
+            }
+        }
+    }
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double requests = (double)iterations * routedPathCount;
+    result.NsPerRequest = elapsedNs / requests;
+    result.AllocationsPerRequest = (threadAllocations() - allocations) / requests;
+    return result;
+}
+
+static void printResult(const char* name, const RoutingResult& result, bool last) {
+    printf("    \"%s\": {\"nsPerRequest\": %.1f, \"allocationsPerRequest\": %.2f, \"heapBytes\": %lld, "
+           "\"mismatches\": %u}%s\n",
+           name, result.NsPerRequest, result.AllocationsPerRequest, (long long)result.HeapBytes, result.Mismatches,
+           last ? "" : ",");
+}
+
+void runRoutingBenchmark(uint32_t iterations) {
+    if (regexPatternCount != routeCount || !buildRouter(routes, routeCount)) {
+        fprintf(stderr, "the regex patterns do not match the routes table\n");
+        return;
+    }
+
+    RoutingResult trie = measure(iterations, [](const RoutedPath& request) {
+        char pathArgs[HTTP_MAX_PATH_ARGS][HTTP_MAX_PATH_ARG_SIZE];
+        return routeWithTrie(request, pathArgs);
+    });
+
+    RoutingResult perRequest = measure(iterations, [](const RoutedPath& request) {
+        std::vector<String> pathArgs;
+        return routeWithRegex(request, pathArgs);
+    });
+
+    int64_t heapBefore = getHeapStats().CurrentBytes;
+    std::vector<std::regex> compiled;
+    for (size_t i = 0; i < regexPatternCount; ++i) {
+        compiled.emplace_back(regexPatterns[i][0] == '^' ? regexPatterns[i] : "");
+    }
+    int64_t compiledBytes = getHeapStats().CurrentBytes - heapBefore;
+    RoutingResult precompiled = measure(iterations, [&compiled](const RoutedPath& request) {
+        std::vector<std::string> pathArgs;
+        return routeWithCompiledRegex(request, compiled, pathArgs);
+    });
+    precompiled.HeapBytes = compiledBytes;
+
+    printf("{\n  \"routing\": {\n");
+    printf("    \"paths\": %zu,\n    \"iterations\": %u,\n", routedPathCount, iterations);
+    printf("    \"trie\": {\"nsPerRequest\": %.1f, \"allocationsPerRequest\": %.2f, \"staticBytes\": %zu, "
+           "\"nodes\": %zu, \"mismatches\": %u},\n",
+           trie.NsPerRequest, trie.AllocationsPerRequest, sizeof(RouterNode) * ROUTER_MAX_NODES, routerNodeCount(),
+           trie.Mismatches);
+    printResult("regexPerRequest", perRequest, false);
+    printResult("regexPrecompiled", precompiled, true);
+    printf("  }\n}\n");
+}
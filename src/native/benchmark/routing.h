@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Compares the route trie with the regex routes of the ESP32 web server and prints
+ *        the time, heap allocations and memory of routing a request as JSON.
+ * @param iterations Number of passes over the request paths of evcc and Home Assistant.
+ */
+void runRoutingBenchmark(uint32_t iterations);
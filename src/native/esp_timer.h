@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Returns the time since start of the process.
+ * @return Microseconds since start.
+ */
+int64_t esp_timer_get_time();
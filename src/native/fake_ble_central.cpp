@@ -0,0 +1,242 @@
+#include "fake_ble_central.h"
+
+// Interval in which peripherals advertise while the central scans
+#define FAKE_ADVERTISING_INTERVAL_MS 100
+
+// Advertisements that were not fetched by available() are dropped beyond this
+#define FAKE_MAX_ADVERTISEMENTS 32
+
+void FakeGattPeripheral::setValue(const char* uuid, const uint8_t* value, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    values[uuid].assign((const char*)value, length);
+}
+
+std::string FakeGattPeripheral::lastWrite(const char* uuid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = writes.find(uuid);
+    return it != writes.end() ? it->second : std::string();
+}
+
+int FakeGattPeripheral::read(const char* uuid, uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = values.find(uuid);
+    if (it == values.end()) {
+        return -1;
+    }
+    size_t length = min(it->second.size(), size);
+    memcpy(buffer, it->second.data(), length);
+    return length;
+}
+
+bool FakeGattPeripheral::writable(const char* uuid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return values.count(uuid) > 0;
+}
+
+bool FakeGattPeripheral::write(const char* uuid, const uint8_t* value, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writes[uuid].assign((const char*)value, length);
+    return true;
+}
+
+void FakeBleCentral::addPeripheral(const char* address, const char* localName, FakePeripheral* peripheral) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    devices[address] = Device{localName, peripheral, false, {}};
+}
+
+void FakeBleCentral::notify(const char* address, const char* uuid) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    if (device == NULL || !device->Connected || device->Subscriptions.count(uuid) == 0) {
+        return;
+    }
+    uint8_t value[64];
+    int length = device->Peripheral->notifyValue(uuid, value, sizeof(value));
+    if (length >= 0) {
+        notifications.push_back(Notification{address, uuid, std::string((const char*)value, length)});
+    }
+}
+
+void FakeBleCentral::dropConnection(const char* address) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    if (device != NULL && device->Connected) {
+        device->Connected = false;
+        device->Subscriptions.clear();
+        disconnects.push_back(address);
+    }
+}
+
+FakeBleStats FakeBleCentral::getStats() {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return stats;
+}
+
+void FakeBleCentral::setNotifyHandler(BleNotifyHandler handler) {
+    notifyHandler = handler;
+}
+
+void FakeBleCentral::setDisconnectHandler(BleDisconnectHandler handler) {
+    disconnectHandler = handler;
+}
+
+bool FakeBleCentral::startScan(uint16_t interval, uint16_t window) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    scanning = true;
+    return true;
+}
+
+void FakeBleCentral::stopScan() {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    scanning = false;
+    advertisements.clear();
+}
+
+bool FakeBleCentral::available(BleAdvertisement& out) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    while (!advertisements.empty()) {
+        std::string address = advertisements.front();
+        advertisements.pop_front();
+        Device* device = find(address.c_str());
+        if (device == NULL) {
+            continue;
+        }
+        memset(&out, 0, sizeof(out));
+        strlcpy(out.Address, address.c_str(), sizeof(out.Address));
+        strlcpy(out.LocalName, device->LocalName.c_str(), sizeof(out.LocalName));
+        out.Rssi = -60;
+        return true;
+    }
+    return false;
+}
+
+bool FakeBleCentral::connect(const char* address) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    if (device == NULL) {
+        return false;
+    }
+    stats.Connects++;
+    device->Connected = device->Connected || device->Peripheral->connect();
+    checkDisconnect(address, device);
+    return device->Connected;
+}
+
+bool FakeBleCentral::connected(const char* address) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    return device != NULL && device->Connected;
+}
+
+void FakeBleCentral::disconnect(const char* address) {
+    dropConnection(address);
+}
+
+bool FakeBleCentral::discoverAttributes(const char* address) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    stats.Discoveries++;
+    if (device == NULL || !device->Connected) {
+        return false;
+    }
+    bool discovered = device->Peripheral->discoverAttributes();
+    checkDisconnect(address, device);
+    return discovered && device->Connected;
+}
+
+bool FakeBleCentral::subscribe(const char* address, const char* uuid) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    if (device == NULL || !device->Connected || !device->Peripheral->canSubscribe(uuid)) {
+        return false;
+    }
+    device->Subscriptions.insert(uuid);
+    return true;
+}
+
+int FakeBleCentral::read(const char* address, const char* uuid, uint8_t* buffer, size_t size) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    if (device == NULL || !device->Connected) {
+        return -1;
+    }
+    stats.Reads++;
+    int length = device->Peripheral->read(uuid, buffer, size);
+    checkDisconnect(address, device);
+    return length;
+}
+
+bool FakeBleCentral::writable(const char* address, const char* uuid) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    return device != NULL && device->Connected && device->Peripheral->writable(uuid);
+}
+
+bool FakeBleCentral::write(const char* address, const char* uuid, const uint8_t* value, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    Device* device = find(address);
+    if (device == NULL || !device->Connected) {
+        return false;
+    }
+    stats.Writes++;
+    bool written = device->Peripheral->write(uuid, value, length);
+    checkDisconnect(address, device);
+    return written;
+}
+
+void FakeBleCentral::poll() {
+    std::deque<Notification> delivered;
+    std::deque<std::string> disconnected;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        unsigned long now = millis();
+        if (scanning && now - lastAdvertising >= FAKE_ADVERTISING_INTERVAL_MS) {
+            lastAdvertising = now;
+            for (auto& entry : devices) {
+                if (!entry.second.Connected && advertisements.size() < FAKE_MAX_ADVERTISEMENTS) {
+                    advertisements.push_back(entry.first);
+                }
+            }
+        }
+        stats.Notifications += notifications.size();
+        delivered.swap(notifications);
+        disconnected.swap(disconnects);
+    }
+
+    // handlers are called without holding the lock, like the ArduinoBLE event handlers
+    for (const std::string& address : disconnected) {
+        if (disconnectHandler) {
+            disconnectHandler(address.c_str());
+        }
+    }
+    for (const Notification& notification : delivered) {
+        if (notifyHandler) {
+            notifyHandler(notification.Address.c_str(), notification.Uuid.c_str(),
+                          (const uint8_t*)notification.Value.data(), notification.Value.size());
+        }
+    }
+}
+
+FakeBleCentral::Device* FakeBleCentral::find(const char* address) {
+    for (auto& entry : devices) {
+        if (strcasecmp(entry.first.c_str(), address) == 0) {
+            return &entry.second;
+        }
+    }
+    return NULL;
+}
+
+void FakeBleCentral::checkDisconnect(const char* address, Device* device) {
+    if (device->Peripheral->takeDisconnect()) {
+        dropConnection(address);
+    }
+}
+
+FakeBleCentral& fakeBleCentral() {
+    static FakeBleCentral central;
+    return central;
+}
+
+BleCentral& bleCentral() {
+    return fakeBleCentral();
+}
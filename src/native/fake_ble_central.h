@@ -0,0 +1,151 @@
+#pragma once
+#include <Arduino.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+#include "ble_central.h"
+
+/**
+ * A peripheral served by the fake BLE central. Called from the poller task.
+ */
+class FakePeripheral {
+public:
+    virtual ~FakePeripheral() {}
+
+    virtual bool connect() { return true; }
+    virtual bool discoverAttributes() { return true; }
+    virtual bool canSubscribe(const char* uuid) { return false; }
+
+    /**
+     * @brief Reads a characteristic.
+     * @return Length of the value or -1 if the read failed.
+     */
+    virtual int read(const char* uuid, uint8_t* buffer, size_t size) = 0;
+    virtual bool writable(const char* uuid) = 0;
+    virtual bool write(const char* uuid, const uint8_t* value, size_t length) = 0;
+
+    /**
+     * @brief Returns the value sent with a notification, without the latency of a read.
+     * @return Length of the value or -1 if there is none.
+     */
+    virtual int notifyValue(const char* uuid, uint8_t* buffer, size_t size) { return read(uuid, buffer, size); }
+
+    /**
+     * @brief Returns whether the peripheral dropped the connection since the last call.
+     */
+    virtual bool takeDisconnect() { return false; }
+};
+
+/**
+ * Peripheral with characteristic values that are set by the caller.
+ */
+class FakeGattPeripheral : public FakePeripheral {
+public:
+    void setValue(const char* uuid, const uint8_t* value, size_t length);
+
+    /**
+     * @brief Returns the last value written to a characteristic.
+     * @param uuid The UUID of the characteristic.
+     * @return The written bytes or an empty string.
+     */
+    std::string lastWrite(const char* uuid);
+
+    int read(const char* uuid, uint8_t* buffer, size_t size) override;
+    bool writable(const char* uuid) override;
+    bool write(const char* uuid, const uint8_t* value, size_t length) override;
+
+private:
+    std::mutex mutex;
+    std::map<std::string, std::string> values;
+    std::map<std::string, std::string> writes;
+};
+
+struct FakeBleStats {
+    uint32_t Connects;
+    uint32_t Discoveries;
+    uint32_t Reads;
+    uint32_t Writes;
+    uint32_t Notifications;
+};
+
+/**
+ * In-process BLE central. Peripherals advertise while the central scans and are not
+ * connected, notifications and disconnects are delivered from poll() like with ArduinoBLE.
+ */
+class FakeBleCentral : public BleCentral {
+public:
+    /**
+     * @brief Adds a peripheral, the central does not take ownership.
+     * @param address The MAC address of the peripheral.
+     * @param localName The advertised local name.
+     * @param peripheral The peripheral.
+     */
+    void addPeripheral(const char* address, const char* localName, FakePeripheral* peripheral);
+
+    /**
+     * @brief Sends a notification with the current value of a subscribed characteristic.
+     * @param address The MAC address of the peripheral.
+     * @param uuid The UUID of the characteristic.
+     */
+    void notify(const char* address, const char* uuid);
+
+    /**
+     * @brief Drops the connection of a peripheral, e.g. because it went out of range.
+     * @param address The MAC address of the peripheral.
+     */
+    void dropConnection(const char* address);
+
+    FakeBleStats getStats();
+
+    void setNotifyHandler(BleNotifyHandler handler) override;
+    void setDisconnectHandler(BleDisconnectHandler handler) override;
+    bool startScan(uint16_t interval, uint16_t window) override;
+    void stopScan() override;
+    bool available(BleAdvertisement& out) override;
+    bool connect(const char* address) override;
+    bool connected(const char* address) override;
+    void disconnect(const char* address) override;
+    bool discoverAttributes(const char* address) override;
+    bool subscribe(const char* address, const char* uuid) override;
+    int read(const char* address, const char* uuid, uint8_t* buffer, size_t size) override;
+    bool writable(const char* address, const char* uuid) override;
+    bool write(const char* address, const char* uuid, const uint8_t* value, size_t length) override;
+    void poll() override;
+
+private:
+    struct Device {
+        std::string LocalName;
+        FakePeripheral* Peripheral;
+        bool Connected;
+        std::set<std::string> Subscriptions;
+    };
+
+    struct Notification {
+        std::string Address;
+        std::string Uuid;
+        std::string Value;
+    };
+
+    std::recursive_mutex mutex;
+    std::map<std::string, Device> devices;
+    std::deque<std::string> advertisements;
+    std::deque<Notification> notifications;
+    std::deque<std::string> disconnects;
+    BleNotifyHandler notifyHandler = NULL;
+    BleDisconnectHandler disconnectHandler = NULL;
+    bool scanning = false;
+    unsigned long lastAdvertising = 0;
+    FakeBleStats stats = {};
+
+    Device* find(const char* address);
+    void checkDisconnect(const char* address, Device* device);
+};
+
+/**
+ * @brief Returns the fake BLE central used by the native build, same instance as bleCentral().
+ * @return The fake BLE central.
+ */
+FakeBleCentral& fakeBleCentral();
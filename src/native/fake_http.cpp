@@ -0,0 +1,141 @@
+#include "fake_http.h"
+
+#include <chrono>
+
+#include "heap_counter.h"
+#include "router.h"
+
+static const String emptyString;
+
+FakeHttpRequest::FakeHttpRequest(const char* url, uint32_t client, const FakeHttpHeaders* headers)
+    : client(client), headerCount(0), exchange(std::make_shared<FakeHttpExchange>()) {
+    if (headers) {
+        for (const std::pair<std::string, std::string>& header : *headers) {
+            requestHeaders.emplace_back(String(header.first.c_str()), String(header.second.c_str()));
+        }
+    }
+    const char* query = strchr(url, '?');
+    requestUrl = query ? String(url, query - url) : String(url);
+    while (query && *query) {
+        const char* name = query + 1;
+        const char* end = name + strcspn(name, "&");
+        const char* equals = (const char*)memchr(name, '=', end - name);
+        const char* value = equals ? equals + 1 : end;
+        queryArgs.emplace_back(String(name, (equals ? equals : end) - name), String(value, end - value));
+        query = *end ? end : NULL;
+    }
+}
+
+bool FakeHttpRequest::waitForResponse(unsigned long timeoutMs, FakeHttpResponse& out) {
+    std::unique_lock<std::mutex> lock(exchange->Mutex);
+    bool sent = exchange->Done.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                        [this] { return exchange->Response.Sent; });
+    out = exchange->Response;
+    return sent;
+}
+
+String FakeHttpRequest::url() const {
+    return requestUrl;
+}
+
+String FakeHttpRequest::queryArg(const char* name) const {
+    for (const std::pair<String, String>& arg : queryArgs) {
+        if (arg.first == name) {
+            return arg.second;
+        }
+    }
+    return emptyString;
+}
+
+String FakeHttpRequest::header(const char* name) const {
+    for (const std::pair<String, String>& header : requestHeaders) {
+        if (strcasecmp(header.first.c_str(), name) == 0) {
+            return header.second;
+        }
+    }
+    return emptyString;
+}
+
+uint32_t FakeHttpRequest::clientId() const {
+    return client;
+}
+
+void FakeHttpRequest::addHeader(const char* name, const char* value) {
+    if (headerCount < HTTP_MAX_HEADERS) {
+        headerNames[headerCount] = name;
+        strlcpy(headerValues[headerCount], value, sizeof(headerValues[headerCount]));
+        headerCount++;
+    }
+}
+
+void FakeHttpRequest::send(int code, const char* contentType, const char* body, size_t length) {
+    stopTiming();
+    // copying the response out stands in for the network stack
+    UncountedAllocations uncounted;
+    std::lock_guard<std::mutex> lock(exchange->Mutex);
+    FakeHttpResponse& response = exchange->Response;
+    if (!response.Sent) {
+        response.Sent = true;
+        response.Code = code;
+        response.ContentType = contentType;
+        response.Body.assign(body, length);
+        for (uint8_t i = 0; i < headerCount; ++i) {
+            response.Headers.emplace_back(headerNames[i], headerValues[i]);
+        }
+        exchange->Done.notify_all();
+    }
+    headerCount = 0;
+}
+
+void FakeHttpRequest::sendStream(int code, const char* contentType, StreamFiller fill, StreamRelease release,
+                                 void* context) {
+    // small chunks like a congested client, so parts of the body are split
+    std::string body;
+    uint8_t chunk[64];
+    size_t length;
+    while ((length = fill(context, chunk, sizeof(chunk))) > 0) {
+        UncountedAllocations uncounted;
+        body.append((const char*)chunk, length);
+    }
+    release(context);
+    send(code, contentType, body.data(), body.size());
+}
+
+HttpRequest* FakeHttpRequest::defer() {
+    FakeHttpRequest* deferred = new FakeHttpRequest(*this);
+    deferred->headerCount = 0;
+    return deferred;
+}
+
+bool dispatchRequest(RouteMethod method, const char* url, const char* body, size_t length,
+                     unsigned long timeoutMs, FakeHttpResponse& out, uint32_t client,
+                     const FakeHttpHeaders* headers) {
+    static std::once_flag built;
+    std::call_once(built, [] { buildRouter(routes, routeCount); });
+
+    // routes match the path only, like on the ESP32
+    RouteMatch match;
+    if (matchRoute(method, url, strcspn(url, "?"), match)) {
+        const Route& route = routes[match.Route];
+        FakeHttpRequest request(url, client, headers);
+        request.startTiming(match.Route);
+        setPathArgs(request, url, match);
+        uint64_t allocations = threadAllocations();
+        if (route.Body) {
+            route.Body(&request, (uint8_t*)body, length, 0, length);
+        } else {
+            route.Handler(&request);
+        }
+        allocations = threadAllocations() - allocations;
+        bool sent = request.waitForResponse(timeoutMs, out);
+        out.HandlerAllocations = allocations;
+        return sent;
+    }
+
+    out = FakeHttpResponse();
+    out.Sent = true;
+    out.Code = 404;
+    out.ContentType = "text/plain";
+    out.Body = std::string("Not found ") + url;
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "http_request.h"
+#include "routes.h"
+
+typedef std::vector<std::pair<std::string, std::string>> FakeHttpHeaders;
+
+struct FakeHttpResponse {
+    bool Sent;
+    int Code;
+    std::string ContentType;
+    std::string Body;
+    FakeHttpHeaders Headers;
+    // heap allocations of the route handler, without the ones of the fake transport
+    uint64_t HandlerAllocations;
+};
+
+// Response shared by a request and its deferred handles
+struct FakeHttpExchange {
+    std::mutex Mutex;
+    std::condition_variable Done;
+    FakeHttpResponse Response;
+};
+
+/**
+ * In-process HttpRequest that records the response.
+ */
+class FakeHttpRequest : public HttpRequest {
+public:
+    /**
+     * @param url The request path, query parameters after '?' are split off.
+     * @param client Id of the simulated client.
+     * @param headers The request headers, may be NULL.
+     */
+    explicit FakeHttpRequest(const char* url, uint32_t client = 0, const FakeHttpHeaders* headers = NULL);
+
+    /**
+     * @brief Waits for the response, e.g. of a deferred request.
+     * @param timeoutMs Maximum time to wait.
+     * @param out Receives the response.
+     * @return false if no response was sent within the timeout.
+     */
+    bool waitForResponse(unsigned long timeoutMs, FakeHttpResponse& out);
+
+    using HttpRequest::addHeader;
+    using HttpRequest::send;
+
+    String url() const override;
+    String queryArg(const char* name) const override;
+    String header(const char* name) const override;
+    uint32_t clientId() const override;
+    void addHeader(const char* name, const char* value) override;
+    void send(int code, const char* contentType, const char* body, size_t length) override;
+    void sendStream(int code, const char* contentType, StreamFiller fill, StreamRelease release,
+                    void* context) override;
+    HttpRequest* defer() override;
+
+private:
+    String requestUrl;
+    uint32_t client;
+    std::vector<std::pair<String, String>> queryArgs;
+    std::vector<std::pair<String, String>> requestHeaders;
+    const char* headerNames[HTTP_MAX_HEADERS];
+    char headerValues[HTTP_MAX_HEADERS][HTTP_MAX_HEADER_VALUE];
+    uint8_t headerCount;
+    std::shared_ptr<FakeHttpExchange> exchange;
+};
+
+/**
+ * @brief Serves a request with the route matching its path, like the web server on the ESP32.
+ * @param method The request method.
+ * @param url The request path.
+ * @param body The request body, may be NULL.
+ * @param length Length of the body.
+ * @param timeoutMs Maximum time to wait for a deferred response.
+ * @param out Receives the response, 404 if no route matched.
+ * @param client Id of the simulated client.
+ * @param headers The request headers, may be NULL.
+ * @return false if no response was sent within the timeout.
+ */
+bool dispatchRequest(RouteMethod method, const char* url, const char* body, size_t length,
+                     unsigned long timeoutMs, FakeHttpResponse& out, uint32_t client = 0,
+                     const FakeHttpHeaders* headers = NULL);
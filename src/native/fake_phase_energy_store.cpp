@@ -0,0 +1,67 @@
+#include "fake_phase_energy_store.h"
+
+#include <cstdio>
+
+// Records are keyed by the upper case address
+static std::string recordKey(const char* address) {
+    std::string key(address);
+    for (char& c : key) {
+        c = toupper(c);
+    }
+    return key;
+}
+
+bool FakePhaseEnergyStore::setFile(const char* file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    path = file;
+    records.clear();
+    FILE* in = fopen(file, "rb");
+    if (!in) {
+        return true;
+    }
+    // the file holds the records back to back, like they are laid out in memory
+    PhaseEnergyRecord record;
+    size_t length;
+    while ((length = fread(&record, 1, sizeof(record), in)) == sizeof(record)) {
+        record.Address[sizeof(record.Address) - 1] = 0;
+        records[recordKey(record.Address)] = record;
+    }
+    fclose(in);
+    return length == 0;
+}
+
+bool FakePhaseEnergyStore::load(const char* address, PhaseEnergyRecord& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = records.find(recordKey(address));
+    if (it == records.end()) {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+bool FakePhaseEnergyStore::save(const PhaseEnergyRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    records[recordKey(record.Address)] = record;
+    if (path.empty()) {
+        return true;
+    }
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool written = true;
+    for (const auto& entry : records) {
+        written = written && fwrite(&entry.second, sizeof(entry.second), 1, out) == 1;
+    }
+    return fclose(out) == 0 && written;
+}
+
+FakePhaseEnergyStore& fakePhaseEnergyStore() {
+    static FakePhaseEnergyStore store;
+    return store;
+}
+
+PhaseEnergyStore& phaseEnergyStore() {
+    return fakePhaseEnergyStore();
+}
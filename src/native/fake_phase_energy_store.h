@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "phase_energy.h"
+
+/**
+ * PhaseEnergyStore keeping the records in memory, and in a file once one is set.
+ */
+class FakePhaseEnergyStore : public PhaseEnergyStore {
+public:
+    /**
+     * @brief Loads the records saved to a file and saves all later ones to it.
+     * @param path The file, it is created by the first save.
+     * @return false if the file exists but holds no valid records.
+     */
+    bool setFile(const char* path);
+
+    bool load(const char* address, PhaseEnergyRecord& out) override;
+    bool save(const PhaseEnergyRecord& record) override;
+
+private:
+    std::mutex mutex;
+    std::string path;
+    std::map<std::string, PhaseEnergyRecord> records;
+};
+
+/**
+ * @brief Returns the store used by the native build, same instance as phaseEnergyStore().
+ */
+FakePhaseEnergyStore& fakePhaseEnergyStore();
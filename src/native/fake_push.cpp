@@ -0,0 +1,24 @@
+#include "fake_push.h"
+
+FakePushChannel::FakePushChannel(FILE* out) : out(out), subscribers(0) {
+}
+
+void FakePushChannel::subscribe() {
+    subscribers++;
+    requestPushState();
+}
+
+size_t FakePushChannel::subscriberCount() {
+    return subscribers;
+}
+
+void FakePushChannel::broadcast(const char* message, size_t length, uint32_t sequence) {
+    // one call per message, so messages of the poller task do not interleave with responses
+    fprintf(out, "event %u: %.*s\n", (unsigned)sequence, (int)length, message);
+    fflush(out);
+}
+
+FakePushChannel& fakePushChannel() {
+    static FakePushChannel channel(stdout);
+    return channel;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+#include <atomic>
+#include <cstdio>
+
+#include "push.h"
+
+/**
+ * PushChannel printing the messages to a stream once a subscriber was added.
+ */
+class FakePushChannel : public PushChannel {
+public:
+    /**
+     * @param out Stream the messages are printed to.
+     */
+    explicit FakePushChannel(FILE* out);
+
+    /**
+     * @brief Adds a subscriber, it receives all fields of every charger first.
+     */
+    void subscribe();
+
+    size_t subscriberCount() override;
+    void broadcast(const char* message, size_t length, uint32_t sequence) override;
+
+private:
+    FILE* out;
+    std::atomic<size_t> subscribers;
+};
+
+/**
+ * @brief Returns the channel printing to stdout.
+ */
+FakePushChannel& fakePushChannel();
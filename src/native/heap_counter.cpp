@@ -0,0 +1,91 @@
+#include "heap_counter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// Every block is prefixed with its size, keeps the payload aligned like malloc does
+#define HEAP_HEADER_SIZE 16
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> frees(0);
+static std::atomic<int64_t> currentBytes(0);
+static std::atomic<int64_t> peakBytes(0);
+static thread_local uint64_t threadCount = 0;
+static thread_local int uncountedDepth = 0;
+
+static void* allocate(size_t size) {
+    uint8_t* block = (uint8_t*)malloc(size + HEAP_HEADER_SIZE);
+    if (block == NULL) {
+        throw std::bad_alloc();
+    }
+    *(size_t*)block = size;
+    allocations++;
+    if (uncountedDepth == 0) {
+        threadCount++;
+    }
+    int64_t current = currentBytes += size;
+    int64_t peak = peakBytes.load();
+    while (current > peak && !peakBytes.compare_exchange_weak(peak, current)) {
+    }
+    return block + HEAP_HEADER_SIZE;
+}
+
+static void release(void* pointer) {
+    if (pointer == NULL) {
+        return;
+    }
+    uint8_t* block = (uint8_t*)pointer - HEAP_HEADER_SIZE;
+    frees++;
+    currentBytes -= *(size_t*)block;
+    free(block);
+}
+
+void* operator new(size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    release(pointer);
+}
+
+HeapStats getHeapStats() {
+    HeapStats stats;
+    stats.Allocations = allocations.load();
+    stats.Frees = frees.load();
+    stats.CurrentBytes = currentBytes.load();
+    stats.PeakBytes = peakBytes.load();
+    return stats;
+}
+
+void resetHeapPeak() {
+    peakBytes = currentBytes.load();
+}
+
+uint64_t threadAllocations() {
+    return threadCount;
+}
+
+UncountedAllocations::UncountedAllocations() {
+    uncountedDepth++;
+}
+
+UncountedAllocations::~UncountedAllocations() {
+    uncountedDepth--;
+}
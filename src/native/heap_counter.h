@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+struct HeapStats {
+    uint64_t Allocations;
+    uint64_t Frees;
+    int64_t CurrentBytes;
+    int64_t PeakBytes;
+};
+
+/**
+ * @brief Returns the counters of the global operator new/delete of the native build.
+ * @return The heap statistics.
+ */
+HeapStats getHeapStats();
+
+/**
+ * @brief Restarts the peak tracking at the current heap use.
+ */
+void resetHeapPeak();
+
+/**
+ * @brief Returns the number of allocations of the calling thread outside of uncounted scopes.
+ * @return The allocation count.
+ */
+uint64_t threadAllocations();
+
+/**
+ * Excludes the allocations of the calling thread from threadAllocations() while in scope,
+ * e.g. the ones of a fake that stands in for the network stack.
+ */
+class UncountedAllocations {
+public:
+    UncountedAllocations();
+    ~UncountedAllocations();
+};
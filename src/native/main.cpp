@@ -0,0 +1,112 @@
+// Native entry point: runs the gateway against a simulated charger and serves
+// requests read from stdin, one per line: METHOD PATH [BODY]. Lines like
+// "If-None-Match: "1a2b3c4d"" add a header to the next request. SUBSCRIBE prints
+// the push messages from then on, like a client of /api/events.
+//
+//   echo "GET /api/measurements/00:11:22:33:44:55" | .pio/build/native/program --read-latency=200
+
+#include <Arduino.h>
+
+#include <iostream>
+#include <sstream>
+
+#include "ble_poller.h"
+#include "fake_ble_central.h"
+#include "fake_http.h"
+#include "fake_phase_energy_store.h"
+#include "fake_push.h"
+#include "log.h"
+#include "modbus_native.h"
+#include "simulated_charger.h"
+
+// Time to wait for deferred responses
+#define NATIVE_RESPONSE_TIMEOUT_MS 10000
+
+// Interval of the simulated charge and its notifications
+#define NATIVE_SIMULATION_PERIOD_MS 1000
+
+static bool parseMethod(const std::string& name, RouteMethod& method) {
+    if (name == "GET") {
+        method = ROUTE_GET;
+    } else if (name == "PUT") {
+        method = ROUTE_PUT;
+    } else if (name == "POST") {
+        method = ROUTE_POST;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    SimulationOptions options = defaultSimulationOptions();
+    int modbusPort = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--modbus-port=", 14) == 0) {
+            modbusPort = atoi(argv[i] + 14);
+        } else if (strncmp(argv[i], "--energy-file=", 14) == 0) {
+            if (!fakePhaseEnergyStore().setFile(argv[i] + 14)) {
+                fprintf(stderr, "%s holds no phase energy records\n", argv[i] + 14);
+                return 1;
+            }
+        } else if (!parseSimulationOption(argv[i], options)) {
+            fprintf(stderr, "usage: %s [options] < requests\n", argv[0]);
+            printSimulationOptions(stderr);
+            fprintf(stderr, "  --modbus-port=N\n");
+            fprintf(stderr, "  --energy-file=PATH\n");
+            return 1;
+        }
+    }
+
+    SimulatedCharger charger(options.Pin, options.Seed);
+    charger.setFaults(options.Faults);
+    charger.setNotifications(options.Notifications);
+    charger.setVehicle(options.Vehicle);
+    fakeBleCentral().addPeripheral(options.Address, "NRGkick", &charger);
+    startSimulation(fakeBleCentral(), options.Address, charger, NATIVE_SIMULATION_PERIOD_MS);
+    startLogTask();
+    addPushChannel(&fakePushChannel());
+    startBlePoller();
+    if (modbusPort > 0 && !startNativeModbusServer(modbusPort)) {
+        fprintf(stderr, "Modbus port %d could not be opened\n", modbusPort);
+        return 1;
+    }
+
+    std::string line;
+    FakeHttpHeaders headers;
+    while (std::getline(std::cin, line)) {
+        std::istringstream words(line);
+        std::string name, url, body;
+        words >> name >> url;
+        std::getline(words >> std::ws, body);
+        if (name == "SUBSCRIBE") {
+            fakePushChannel().subscribe();
+            continue;
+        }
+        if (name.size() > 1 && name.back() == ':') {
+            size_t value = line.find_first_not_of(' ', line.find(':') + 1);
+            headers.emplace_back(name.substr(0, name.size() - 1), value == std::string::npos ? "" : line.substr(value));
+            continue;
+        }
+        RouteMethod method;
+        if (!parseMethod(name, method) || url.empty()) {
+            std::cerr << "usage: METHOD PATH [BODY] | Header: value | SUBSCRIBE" << std::endl;
+            continue;
+        }
+
+        FakeHttpResponse response;
+        bool answered = dispatchRequest(method, url.c_str(), body.c_str(), body.size(), NATIVE_RESPONSE_TIMEOUT_MS,
+                                        response, 0, &headers);
+        headers.clear();
+        if (!answered) {
+            std::cout << "timeout" << std::endl;
+            continue;
+        }
+        std::cout << response.Code << " " << response.ContentType << std::endl;
+        for (const auto& header : response.Headers) {
+            std::cout << header.first << ": " << header.second << std::endl;
+        }
+        std::cout << response.Body << std::endl;
+    }
+    return 0;
+}
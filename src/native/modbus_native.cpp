@@ -0,0 +1,71 @@
+#include "modbus_native.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+static std::atomic<int> clientCount(0);
+
+static void sendResponse(void* context, const uint8_t* frame, size_t length) {
+    int socket = *(int*)context;
+    while (length > 0) {
+        ssize_t sent = send(socket, frame, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return;
+        }
+        frame += sent;
+        length -= sent;
+    }
+}
+
+static void serveClient(int socket) {
+    ModbusConnection connection = {};
+    uint8_t data[MODBUS_MAX_FRAME];
+    ssize_t received;
+    while ((received = recv(socket, data, sizeof(data), 0)) > 0) {
+        if (!receiveModbusData(connection, data, received, sendResponse, &socket)) {
+            break;
+        }
+    }
+    close(socket);
+    clientCount--;
+}
+
+bool startNativeModbusServer(uint16_t port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, MODBUS_MAX_CLIENTS) != 0) {
+        close(listener);
+        return false;
+    }
+    std::thread([listener]() {
+        for (;;) {
+            int client = accept(listener, NULL, NULL);
+            if (client < 0) {
+                continue;
+            }
+            if (clientCount >= MODBUS_MAX_CLIENTS) {
+                close(client);
+                continue;
+            }
+            int enable = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            clientCount++;
+            std::thread(serveClient, client).detach();
+        }
+    }).detach();
+    return true;
+}
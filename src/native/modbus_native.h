@@ -0,0 +1,10 @@
+#pragma once
+
+#include "modbus.h"
+
+/**
+ * @brief Starts a Modbus TCP server on a host port, each connection is served by its own thread.
+ * @param port The TCP port, e.g. 1502 to run without root.
+ * @return false if the port could not be opened.
+ */
+bool startNativeModbusServer(uint16_t port);
@@ -0,0 +1,317 @@
+#include "simulated_charger.h"
+
+#include <string>
+#include <thread>
+
+// Nominal phase voltage in 0.1 V
+#define SIMULATED_VOLTAGE 2300
+
+SimulatedCharger::SimulatedCharger(uint16_t pin, uint32_t seed)
+    : pin(pin), random(seed ? seed : 1), faults(), notifications(true), dropPending(false),
+      vehicle(VEHICLE_NONE), energyMilliWs(0), energy(), power(), voltageCurrent(), info() {
+    info.Current = 16;
+    info.KWhPer100 = 2000;
+    info.AmountPerKWh = 30;
+    info.FIEnabled = 1;
+    info.Efficiency = 90;
+    info.ChargingCurrentMax = 32;
+    info.BLETransmissionPower = 4;
+    energy.TotalEnergy = 1234567;
+    energy.ChargingEnergyLimit = 19997;
+    updateMeasurements();
+}
+
+void SimulatedCharger::setFaults(const SimulationFaults& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    faults = value;
+}
+
+void SimulatedCharger::setNotifications(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    notifications = enabled;
+}
+
+void SimulatedCharger::setVehicle(VehicleState state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state == VEHICLE_CHARGING && vehicle != VEHICLE_CHARGING) {
+        energy.Energy3rdLastCharge = energy.Energy2ndLastCharge;
+        energy.Energy2ndLastCharge = energy.EnergyLastCharge;
+        energy.EnergyLastCharge = 0;
+        energyMilliWs = 0;
+    }
+    vehicle = state;
+    updateMeasurements();
+}
+
+void SimulatedCharger::step(uint32_t elapsedMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    updateMeasurements();
+    // TotalPower is in 10 W, energies in Wh
+    energyMilliWs += (uint64_t)power.TotalPower * 10 * elapsedMs;
+    uint32_t wh = energyMilliWs / 3600000;
+    energy.TotalEnergy += wh - energy.EnergyLastCharge;
+    energy.EnergyLastCharge = wh;
+}
+
+Info SimulatedCharger::getInfo() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return info;
+}
+
+Power SimulatedCharger::getPower() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return power;
+}
+
+void SimulatedCharger::updateMeasurements() {
+    bool charging = vehicle == VEHICLE_CHARGING && info.PauseCharging == 0;
+    info.ChargingActive = charging ? 1 : 0;
+
+    switch (vehicle) {
+        case VEHICLE_CHARGING:
+            power.CPSignal = 2;
+            break;
+        case VEHICLE_CONNECTED:
+            power.CPSignal = 3;
+            break;
+        default:
+            power.CPSignal = 4;
+            break;
+    }
+    uint16_t current = charging ? info.Current * 100 : 0;
+    voltageCurrent.VoltageL1 = SIMULATED_VOLTAGE;
+    voltageCurrent.VoltageL2 = SIMULATED_VOLTAGE;
+    voltageCurrent.VoltageL3 = SIMULATED_VOLTAGE;
+    voltageCurrent.CurrentL1 = current;
+    voltageCurrent.CurrentL2 = current;
+    voltageCurrent.CurrentL3 = current;
+
+    // phase power in 10 W from 0.1 V and 10 mA
+    uint16_t phasePower = (uint32_t)SIMULATED_VOLTAGE * current / 10000;
+    power.L1 = phasePower;
+    power.L2 = phasePower;
+    power.L3 = phasePower;
+    power.TotalPower = phasePower * 3;
+    power.Frequency = 5000;
+    power.Temperature = charging ? 42 : 25;
+}
+
+uint32_t SimulatedCharger::nextRandom() {
+    // xorshift32, the same seed yields the same faults
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+}
+
+bool SimulatedCharger::fails(float rate) {
+    return rate > 0 && (nextRandom() % 10000) < rate * 10000;
+}
+
+void SimulatedCharger::wait(uint32_t latencyMs) {
+    uint32_t jitter = faults.JitterMs ? nextRandom() % (faults.JitterMs + 1) : 0;
+    if (latencyMs + jitter > 0) {
+        delay(latencyMs + jitter);
+    }
+}
+
+void SimulatedCharger::operationDone() {
+    if (fails(faults.DropRate)) {
+        dropPending = true;
+    }
+}
+
+bool SimulatedCharger::connect() {
+    std::lock_guard<std::mutex> lock(mutex);
+    wait(faults.ConnectLatencyMs);
+    return !fails(faults.ConnectFailureRate);
+}
+
+bool SimulatedCharger::discoverAttributes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    wait(faults.DiscoveryLatencyMs);
+    return !fails(faults.DiscoveryFailureRate);
+}
+
+bool SimulatedCharger::canSubscribe(const char* uuid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return notifications && strcasecmp(uuid, SETTINGS_SERVICE) != 0;
+}
+
+int SimulatedCharger::read(const char* uuid, uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    wait(faults.ReadLatencyMs);
+    if (fails(faults.ReadFailureRate)) {
+        operationDone();
+        return -1;
+    }
+    operationDone();
+    return encode(uuid, buffer, size);
+}
+
+int SimulatedCharger::notifyValue(const char* uuid, uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return encode(uuid, buffer, size);
+}
+
+int SimulatedCharger::encode(const char* uuid, uint8_t* buffer, size_t size) {
+    // payloads are big-endian like on the charger
+    if (strcasecmp(uuid, ENERGY_SERVICE) == 0 && size >= sizeof(Energy)) {
+        encodeWire(energy, buffer);
+        return sizeof(Energy);
+    }
+    if (strcasecmp(uuid, POWER_SERVICE) == 0 && size >= sizeof(Power)) {
+        encodeWire(power, buffer);
+        return sizeof(Power);
+    }
+    if (strcasecmp(uuid, VOLTAGE_CURRENT_SERVICE) == 0 && size >= sizeof(VoltageCurrent)) {
+        encodeWire(voltageCurrent, buffer);
+        return sizeof(VoltageCurrent);
+    }
+    if (strcasecmp(uuid, INFO_SERVICE) == 0 && size >= sizeof(Info)) {
+        encodeWire(info, buffer);
+        return sizeof(Info);
+    }
+    return -1;
+}
+
+bool SimulatedCharger::writable(const char* uuid) {
+    return strcasecmp(uuid, SETTINGS_SERVICE) == 0;
+}
+
+bool SimulatedCharger::write(const char* uuid, const uint8_t* value, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    wait(faults.WriteLatencyMs);
+    if (strcasecmp(uuid, SETTINGS_SERVICE) != 0 || length < sizeof(Settings) || fails(faults.WriteFailureRate)) {
+        operationDone();
+        return false;
+    }
+    operationDone();
+
+    Settings settings = decodeWire<Settings>(value);
+    if (settings.PIN != pin) {
+        // the charger acknowledges writes with a wrong PIN but ignores them
+        return true;
+    }
+    info.Current = min(settings.Current, info.ChargingCurrentMax);
+    info.KWhPer100 = settings.KWhPer100;
+    info.AmountPerKWh = settings.AmountPerKWh;
+    info.Efficiency = settings.Efficiency;
+    info.PauseCharging = settings.PauseCharging;
+    info.BLETransmissionPower = settings.BLETransmissionPower;
+    energy.ChargingEnergyLimit = settings.ChargingEnergyLimit;
+    updateMeasurements();
+    return true;
+}
+
+bool SimulatedCharger::takeDisconnect() {
+    std::lock_guard<std::mutex> lock(mutex);
+    bool dropped = dropPending;
+    dropPending = false;
+    return dropped;
+}
+
+void startSimulation(FakeBleCentral& central, const char* address, SimulatedCharger& charger, uint32_t periodMs) {
+    std::string target(address);
+    std::thread([&central, &charger, target, periodMs] {
+        for (;;) {
+            delay(periodMs);
+            charger.step(periodMs);
+            central.notify(target.c_str(), POWER_SERVICE);
+            central.notify(target.c_str(), VOLTAGE_CURRENT_SERVICE);
+            central.notify(target.c_str(), ENERGY_SERVICE);
+            central.notify(target.c_str(), INFO_SERVICE);
+        }
+    }).detach();
+}
+
+SimulationOptions defaultSimulationOptions() {
+    SimulationOptions options = {};
+    strcpy(options.Address, "00:11:22:33:44:55");
+    options.Pin = 1234;
+    options.Seed = 1;
+    options.Notifications = true;
+    options.Vehicle = VEHICLE_NONE;
+    return options;
+}
+
+struct NumberOption {
+    const char* Name;
+    uint32_t SimulationFaults::*Field;
+};
+
+struct RateOption {
+    const char* Name;
+    float SimulationFaults::*Field;
+};
+
+static const NumberOption numberOptions[] = {
+    {"connect-latency", &SimulationFaults::ConnectLatencyMs},
+    {"discovery-latency", &SimulationFaults::DiscoveryLatencyMs},
+    {"read-latency", &SimulationFaults::ReadLatencyMs},
+    {"write-latency", &SimulationFaults::WriteLatencyMs},
+    {"jitter", &SimulationFaults::JitterMs},
+};
+
+static const RateOption rateOptions[] = {
+    {"connect-failures", &SimulationFaults::ConnectFailureRate},
+    {"discovery-failures", &SimulationFaults::DiscoveryFailureRate},
+    {"read-failures", &SimulationFaults::ReadFailureRate},
+    {"write-failures", &SimulationFaults::WriteFailureRate},
+    {"drop-rate", &SimulationFaults::DropRate},
+};
+
+// returns the value of --name=value or NULL
+static const char* optionValue(const char* arg, const char* name) {
+    size_t length = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, length) != 0 || arg[2 + length] != '=') {
+        return NULL;
+    }
+    return arg + 3 + length;
+}
+
+bool parseSimulationOption(const char* arg, SimulationOptions& options) {
+    const char* value;
+    for (const NumberOption& option : numberOptions) {
+        if ((value = optionValue(arg, option.Name))) {
+            options.Faults.*option.Field = strtoul(value, NULL, 10);
+            return true;
+        }
+    }
+    for (const RateOption& option : rateOptions) {
+        if ((value = optionValue(arg, option.Name))) {
+            options.Faults.*option.Field = strtof(value, NULL);
+            return true;
+        }
+    }
+    if ((value = optionValue(arg, "address"))) {
+        strlcpy(options.Address, value, sizeof(options.Address));
+    } else if ((value = optionValue(arg, "pin"))) {
+        options.Pin = strtoul(value, NULL, 10);
+    } else if ((value = optionValue(arg, "seed"))) {
+        options.Seed = strtoul(value, NULL, 10);
+    } else if ((value = optionValue(arg, "vehicle"))) {
+        if (strcmp(value, "charging") == 0) {
+            options.Vehicle = VEHICLE_CHARGING;
+        } else if (strcmp(value, "connected") == 0) {
+            options.Vehicle = VEHICLE_CONNECTED;
+        } else {
+            options.Vehicle = VEHICLE_NONE;
+        }
+    } else if (strcmp(arg, "--no-notify") == 0) {
+        options.Notifications = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void printSimulationOptions(FILE* out) {
+    fprintf(out, "  --address=MAC --pin=N --seed=N --vehicle=none|connected|charging --no-notify\n");
+    for (const NumberOption& option : numberOptions) {
+        fprintf(out, "  --%s=MS\n", option.Name);
+    }
+    for (const RateOption& option : rateOptions) {
+        fprintf(out, "  --%s=0..1\n", option.Name);
+    }
+}
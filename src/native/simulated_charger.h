@@ -0,0 +1,123 @@
+#pragma once
+#include <Arduino.h>
+
+#include "ble_utils.h"
+#include "fake_ble_central.h"
+
+// Latencies and fault rates of the simulated BLE link, rates are probabilities per operation
+struct SimulationFaults {
+    uint32_t ConnectLatencyMs;
+    uint32_t DiscoveryLatencyMs;
+    uint32_t ReadLatencyMs;
+    uint32_t WriteLatencyMs;
+    // latencies vary uniformly by up to this value
+    uint32_t JitterMs;
+    float ConnectFailureRate;
+    float DiscoveryFailureRate;
+    float ReadFailureRate;
+    float WriteFailureRate;
+    // the connection is dropped after the operation
+    float DropRate;
+};
+
+// Vehicle state as signalled on the control pilot
+enum VehicleState {
+    VEHICLE_NONE,
+    VEHICLE_CONNECTED,
+    VEHICLE_CHARGING
+};
+
+// Command line configurable setup of a simulated charger
+struct SimulationOptions {
+    char Address[18];
+    uint16_t Pin;
+    uint32_t Seed;
+    bool Notifications;
+    VehicleState Vehicle;
+    SimulationFaults Faults;
+};
+
+/**
+ * Deterministic NRGkick GATT peripheral. Serves the characteristics of ble_utils.h as
+ * big-endian payloads, applies Settings writes and simulates a charging vehicle.
+ */
+class SimulatedCharger : public FakePeripheral {
+public:
+    /**
+     * @param pin The PIN required for Settings writes.
+     * @param seed Seed of the fault injection.
+     */
+    SimulatedCharger(uint16_t pin, uint32_t seed);
+
+    void setFaults(const SimulationFaults& faults);
+    void setNotifications(bool enabled);
+    void setVehicle(VehicleState state);
+
+    /**
+     * @brief Advances the simulated charge.
+     * @param elapsedMs Time since the last step.
+     */
+    void step(uint32_t elapsedMs);
+
+    Info getInfo();
+    Power getPower();
+
+    bool connect() override;
+    bool discoverAttributes() override;
+    bool canSubscribe(const char* uuid) override;
+    int read(const char* uuid, uint8_t* buffer, size_t size) override;
+    bool writable(const char* uuid) override;
+    bool write(const char* uuid, const uint8_t* value, size_t length) override;
+    int notifyValue(const char* uuid, uint8_t* buffer, size_t size) override;
+    bool takeDisconnect() override;
+
+private:
+    std::mutex mutex;
+    uint16_t pin;
+    uint32_t random;
+    SimulationFaults faults;
+    bool notifications;
+    bool dropPending;
+    VehicleState vehicle;
+    uint64_t energyMilliWs;
+    Energy energy;
+    Power power;
+    VoltageCurrent voltageCurrent;
+    Info info;
+
+    uint32_t nextRandom();
+    bool fails(float rate);
+    void wait(uint32_t latencyMs);
+    void operationDone();
+    void updateMeasurements();
+    int encode(const char* uuid, uint8_t* buffer, size_t size);
+};
+
+/**
+ * @brief Starts a thread that steps the simulated charger and notifies subscribed measurements.
+ * @param central The fake central the charger was added to.
+ * @param address The MAC address of the charger.
+ * @param charger The simulated charger.
+ * @param periodMs Interval of the simulation steps.
+ */
+void startSimulation(FakeBleCentral& central, const char* address, SimulatedCharger& charger, uint32_t periodMs);
+
+/**
+ * @brief Returns the default simulation options: one idle charger without faults.
+ * @return The options.
+ */
+SimulationOptions defaultSimulationOptions();
+
+/**
+ * @brief Parses a simulation option of the form --name=value, e.g. --read-latency=200.
+ * @param arg The command line argument.
+ * @param options The options to update.
+ * @return false if the argument is not a simulation option.
+ */
+bool parseSimulationOption(const char* arg, SimulationOptions& options);
+
+/**
+ * @brief Prints the supported simulation options.
+ * @param out The output stream.
+ */
+void printSimulationOptions(FILE* out);
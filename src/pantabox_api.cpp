@@ -1,31 +1,28 @@
 #include "pantabox_api.h"
+#include "api.h"
+#include "ble_poller.h"
 #include "ble_utils.h"
+#include "log.h"
+#include "server_timing.h"
+#include "snapshot.h"
+#include "snapshot_endpoint.h"
 
-
-void handlePantaboxChargerState(AsyncWebServerRequest *request) {
-    String mac = request->pathArg(0);
-    Serial.print("pantabox state request for ");
-    Serial.println(mac);
-
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
-        return;
-    }
-    if (!connectToDevice(device)) {
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
+static void respondPantaboxWrite(HttpRequest *request, const char* error) {
+    REQUEST_TIMING_HEADER(request);
+    if (error) {
+        LOG_ERROR("request failed", error);
+        sendJsonError(request, 500, error);
         return;
     }
-    
-    BLECharacteristic powerChar = device.characteristic(POWER_SERVICE);
-    if (!(powerChar && powerChar.canRead() && powerChar.read())) {
-        request->send(500, "application/json", "{\"Message\":\"Power characteristic not found or not readable\"}");
-        return;
-    }
-    Power power = convertPower(powerChar.value());
+    request->send(200, "application/json", "{\"success\":true}");
+}
 
-    String state;
-    switch (power.CPSignal) {
+
+static const SnapshotFieldId stateFields[] = {FIELD_POWER_CP_SIGNAL};
+
+static void renderChargerState(const EndpointValues& values, ResponseBuffer& json) {
+    const char* state;
+    switch (values.get(FIELD_POWER_CP_SIGNAL)) {
         case 4:
             state = "A";
             break;
@@ -39,187 +36,100 @@ void handlePantaboxChargerState(AsyncWebServerRequest *request) {
             state = "A";
             break;
     }
-    String json = String("{\"state\": \"") + state + "\"}";
-    request->send(200, "application/json", json);
+    json.append("{\"state\": \"");
+    json.append(state);
+    json.append("\"}");
 }
 
-void handlePantaboxChargerEnabled(AsyncWebServerRequest *request) {
-    String mac = request->pathArg(0);
-    Serial.print("pantabox enabled request for ");
-    Serial.println(mac);
+static const SnapshotEndpoint stateEndpoint = {
+    "pantabox state", ENDPOINT_FIELDS(stateFields), renderChargerState, 500, "Message", false
+};
 
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
-        return;
-    }
-    if (!connectToDevice(device)) {
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
-        return;
-    }
-    
-    BLECharacteristic infoChar = device.characteristic(INFO_SERVICE);
-    if (!(infoChar && infoChar.canRead() && infoChar.read())) {
-        request->send(500, "application/json", "{\"Message\":\"Info characteristic not found or not readable\"}");
-        return;
-    }
-    Info info = convertInfo(infoChar.value());
+void handlePantaboxChargerState(HttpRequest *request) {
+    serveEndpoint(request, stateEndpoint);
+}
+
+static const SnapshotFieldId enabledFields[] = {FIELD_INFO_PAUSE_CHARGING};
 
-    String json = String("{\"enabled\": \"") + ((info.PauseCharging == 0) ? "1" : "0") + "\"}";
-    request->send(200, "application/json", json);
+static void renderChargerEnabled(const EndpointValues& values, ResponseBuffer& json) {
+    json.append("{\"enabled\": \"");
+    json.append(values.get(FIELD_INFO_PAUSE_CHARGING) == 0 ? "1" : "0");
+    json.append("\"}");
 }
 
-void handlePantaboxMeterPower(AsyncWebServerRequest *request) {
-    String mac = request->pathArg(0);
-    Serial.print("pantabox power request for ");
-    Serial.println(mac);
+static const SnapshotEndpoint enabledEndpoint = {
+    "pantabox enabled", ENDPOINT_FIELDS(enabledFields), renderChargerEnabled, 500, "Message", false
+};
 
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
-        return;
-    }
-    if (!connectToDevice(device)) {
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
-        return;
-    }
-    
-    BLECharacteristic powerChar = device.characteristic(POWER_SERVICE);
-    if (!(powerChar && powerChar.canRead() && powerChar.read())) {
-        request->send(500, "application/json", "{\"Message\":\"Power characteristic not found or not readable\"}");
-        return;
-    }
-    Power power = convertPower(powerChar.value());
+void handlePantaboxChargerEnabled(HttpRequest *request) {
+    serveEndpoint(request, enabledEndpoint);
+}
+
+static const SnapshotFieldId powerFields[] = {FIELD_POWER_TOTAL_POWER};
 
-    String json = String("{\"power\": \"") + String(power.TotalPower*10) + "\"}";
-    request->send(200, "application/json", json);
+static void renderMeterPower(const EndpointValues& values, ResponseBuffer& json) {
+    json.append("{\"power\": \"");
+    json.appendInt(values.get(FIELD_POWER_TOTAL_POWER) * 10);
+    json.append("\"}");
 }
 
-void handlePantaboxChargerMaxCurrent(AsyncWebServerRequest *request) {
-    String mac = request->pathArg(0);
-    Serial.print("pantabox max current request for ");
-    Serial.println(mac);
+static const SnapshotEndpoint powerEndpoint = {
+    "pantabox power", ENDPOINT_FIELDS(powerFields), renderMeterPower, 500, "Message", false
+};
 
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
-        return;
-    }
-    if (!connectToDevice(device)) {
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
-        return;
-    }
-    
-    BLECharacteristic infoChar = device.characteristic(INFO_SERVICE);
-    if (!(infoChar && infoChar.canRead() && infoChar.read())) {
-        request->send(500, "application/json", "{\"Message\":\"Info characteristic not found or not readable\"}");
-        return;
-    }
-    Info info = convertInfo(infoChar.value());
+void handlePantaboxMeterPower(HttpRequest *request) {
+    serveEndpoint(request, powerEndpoint);
+}
+
+static const SnapshotFieldId maxCurrentFields[] = {FIELD_INFO_CURRENT};
+
+static void renderChargerMaxCurrent(const EndpointValues& values, ResponseBuffer& json) {
+    json.append("{\"maxCurrent\": \"");
+    json.appendInt(values.get(FIELD_INFO_CURRENT));
+    json.append("\"}");
+}
 
-    String json = String("{\"maxCurrent\": \"") + String(info.Current) + "\"}";
-    request->send(200, "application/json", json);
+static const SnapshotEndpoint maxCurrentEndpoint = {
+    "pantabox max current", ENDPOINT_FIELDS(maxCurrentFields), renderChargerMaxCurrent, 500, "Message", false
+};
+
+void handlePantaboxChargerMaxCurrent(HttpRequest *request) {
+    serveEndpoint(request, maxCurrentEndpoint);
 }
 
-void handlePantaboxChargerEnableSet(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-    String mac = request->pathArg(0);
-    String pin = request->pathArg(1);
+void handlePantaboxChargerEnableSet(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    // the route only matches numeric PINs
+    uint16_t pin = strtoul(request->pathArg(1), NULL, 10);
 
     String body;
     if (index == 0) body = "";
     body += String((const char*)data, len);
     if (index + len != total) return;
 
-    Serial.print("pantabox (POST) set enable request for ");
-    Serial.println(mac);
-
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        Serial.println("Device not found");
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
-        return;
-    }
-    if (!connectToDevice(device)) {
-        Serial.println("Device connect failed");
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
-        return;
-    }
-    BLECharacteristic infoChar = device.characteristic(INFO_SERVICE);
-    if (!(infoChar && infoChar.canRead() && infoChar.read())) {
-        Serial.println("Info characteristic not found or not readable");
-        request->send(500, "application/json", "{\"Message\":\"Info characteristic not writable\"}");
-        return;
-    }
-    // Prepare Info struct and set PauseCharging
-    Info info = convertInfo(infoChar.value());
-
-    Settings setSettings = convertToSettings(info, pin.toInt());
-    setSettings.PauseCharging = (body == "true") ? 0 : 1;
+    LOG_INFO("pantabox (POST) set enable request for", request->pathArg(0));
 
-    BLECharacteristic settingsChar = device.characteristic(SETTINGS_SERVICE);
-    if (!(settingsChar && settingsChar.canWrite())) {
-        Serial.println("Settings characteristic not found or not writable");
-        request->send(500, "application/json", "{\"Message\":\"Settings characteristic not found or not writable\"}");
-        return;
-    }
-    if (!settingsChar.writeValue((uint8_t*)&setSettings, sizeof(setSettings))) {
-        Serial.println("Failed to write settings");
-        request->send(500, "application/json", "{\"Message\":\"Failed to write settings\"}");
-        return;
-    }
-    request->send(200, "application/json", "{\"success\":true}");
+    SettingsChange change = {pin, -1, -1};
+    change.PauseCharging = (body == "true") ? 0 : 1;
+    submitSettingsChange(request, change, respondPantaboxWrite);
 }
 
-void handlePantaboxChargerCurrentSet(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-    String mac = request->pathArg(0);
-    String pin = request->pathArg(1);
+void handlePantaboxChargerCurrentSet(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    uint16_t pin = strtoul(request->pathArg(1), NULL, 10);
 
     String body;
     if (index == 0) body = "";
     body += String((const char*)data, len);
     if (index + len != total) return;
 
-    Serial.print("pantabox (POST) set current request for ");
-    Serial.println(mac);
+    LOG_INFO("pantabox (POST) set current request for", request->pathArg(0));
 
-    BLEDevice device = scanForTargetDevice(mac);
-    if (!device) {
-        Serial.println("Device not found");
-        request->send(500, "application/json", "{\"Message\":\"Device not found\"}");
-        return;
-    }
-    if (!connectToDevice(device)) {
-        Serial.println("Device connect failed");
-        request->send(500, "application/json", "{\"Message\":\"Device connect failed\"}");
-        return;
-    }
-    BLECharacteristic infoChar = device.characteristic(INFO_SERVICE);
-    if (!(infoChar && infoChar.canRead() && infoChar.read())) {
-        Serial.println("Info characteristic not found or not readable");
-        request->send(500, "application/json", "{\"Message\":\"Info characteristic not writable\"}");
-        return;
-    }
-    // Prepare Info struct and set PauseCharging
-    Info info = convertInfo(infoChar.value());
-
-    Settings setSettings = convertToSettings(info, pin.toInt());
-    setSettings.Current = body.toInt();
-
-    if (setSettings.Current < 6 || setSettings.Current > 32) {
+    long current = body.toInt();
+    if (current < 6 || current > 32) {
         request->send(400, "application/json", "{\"Message\":\"Invalid current value\"}");
         return;
     }
 
-    BLECharacteristic settingsChar = device.characteristic(SETTINGS_SERVICE);
-    if (!(settingsChar && settingsChar.canWrite())) {
-        Serial.println("Settings characteristic not found or not writable");
-        request->send(500, "application/json", "{\"Message\":\"Settings characteristic not found or not writable\"}");
-        return;
-    }
-    if (!settingsChar.writeValue((uint8_t*)&setSettings, sizeof(setSettings))) {
-        Serial.println("Failed to write settings");
-        request->send(500, "application/json", "{\"Message\":\"Failed to write settings\"}");
-        return;
-    }
-    request->send(200, "application/json", "{\"success\":true}");
+    SettingsChange change = {pin, -1, -1};
+    change.Current = current;
+    submitSettingsChange(request, change, respondPantaboxWrite);
 }
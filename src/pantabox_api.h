@@ -1,46 +1,46 @@
 #pragma once
-#include <ESPAsyncWebServer.h>
+#include "http_request.h"
 
 /**
  * @brief Handles Pantabox charger state requests.
- * @param request The web server request pointer.
+ * @param request The request.
  */
-void handlePantaboxChargerState(AsyncWebServerRequest *request);
+void handlePantaboxChargerState(HttpRequest *request);
 
 /**
  * @brief Handles Pantabox charger enabled requests.
- * @param request The web server request pointer.
+ * @param request The request.
  */
-void handlePantaboxChargerEnabled(AsyncWebServerRequest *request);
+void handlePantaboxChargerEnabled(HttpRequest *request);
 
 /**
  * @brief Handles Pantabox meter power requests.
- * @param request The web server request pointer.
+ * @param request The request.
  */
-void handlePantaboxMeterPower(AsyncWebServerRequest *request);
+void handlePantaboxMeterPower(HttpRequest *request);
 
 /**
  * @brief Handles Pantabox charger max current requests.
- * @param request The web server request pointer.
+ * @param request The request.
  */
-void handlePantaboxChargerMaxCurrent(AsyncWebServerRequest *request);
+void handlePantaboxChargerMaxCurrent(HttpRequest *request);
 
 /**
  * @brief Handles Pantabox charger enable set requests (POST).
- * @param request The web server request pointer.
+ * @param request The request.
  * @param data The data buffer received.
  * @param len The length of the data buffer.
  * @param index The index of the current data chunk.
  * @param total The total size of the data to be received.
  */
-void handlePantaboxChargerEnableSet(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+void handlePantaboxChargerEnableSet(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
 
 /**
  * @brief Handles Pantabox charger current set requests (POST).
- * @param request The web server request pointer.
+ * @param request The request.
  * @param data The data buffer received.
  * @param len The length of the data buffer.
  * @param index The index of the current data chunk.
  * @param total The total size of the data to be received.
  */
-void handlePantaboxChargerCurrentSet(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+void handlePantaboxChargerCurrentSet(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
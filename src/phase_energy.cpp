@@ -0,0 +1,160 @@
+#include "phase_energy.h"
+#include "log.h"
+
+// Per charger, only touched by the poller task
+struct PhaseIntegrator {
+    PhaseEnergyRecord Record;
+    // the record was restored or started after boot
+    bool Loaded;
+    // Record identifies a session reported by the charger
+    bool Anchored;
+    // changed since the last save
+    bool Dirty;
+    // save with the next service call, e.g. for a new session
+    bool SaveDue;
+    // time of the previous Power sample, 0 before the first one
+    int64_t SampleAt;
+    uint16_t SamplePower[3];
+    unsigned long SavedAt;
+};
+
+static PhaseIntegrator integrators[MAX_CHARGERS];
+static PhaseEnergyStats stats;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void count(uint32_t PhaseEnergyStats::*counter) {
+    portENTER_CRITICAL(&statsMux);
+    stats.*counter += 1;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Restores the session saved before the last reboot, it is kept if the charger still reports it
+static PhaseIntegrator* integrator(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return NULL;
+    }
+    PhaseIntegrator& state = integrators[slot];
+    if (state.Loaded) {
+        return &state;
+    }
+    ChargerSnapshot snapshot;
+    if (!copySnapshot(slot, snapshot)) {
+        return NULL;
+    }
+    memset(&state, 0, sizeof(state));
+    state.Loaded = true;
+    state.SavedAt = millis();
+    if (phaseEnergyStore().load(snapshot.Address, state.Record)) {
+        state.Anchored = true;
+        count(&PhaseEnergyStats::Restored);
+    } else {
+        memset(&state.Record, 0, sizeof(state.Record));
+        strlcpy(state.Record.Address, snapshot.Address, sizeof(state.Record.Address));
+    }
+    return &state;
+}
+
+void integratePhasePower(int slot, const Power& value, int64_t now) {
+    PhaseIntegrator* state = integrator(slot);
+    if (!state) {
+        return;
+    }
+    const uint16_t power[3] = {value.L1, value.L2, value.L3};
+    if (state->SampleAt > 0 && now >= state->SampleAt) {
+        uint64_t elapsedMs = (now - state->SampleAt) / 1000;
+        if (elapsedMs > PHASE_ENERGY_MAX_GAP_MS) {
+            // the charger was not reachable, the power in between is unknown
+            count(&PhaseEnergyStats::Gaps);
+        } else {
+            for (int phase = 0; phase < 3; ++phase) {
+                // trapezoid of two samples in 10 W: (a + b) * 10 / 2 * ms
+                uint64_t area = (uint64_t)(state->SamplePower[phase] + power[phase]) * 5 * elapsedMs;
+                if (area > 0) {
+                    state->Record.PhaseWattMs[phase] += area;
+                    state->Dirty = true;
+                }
+            }
+            count(&PhaseEnergyStats::Samples);
+        }
+    }
+    state->SampleAt = now;
+    memcpy(state->SamplePower, power, sizeof(power));
+}
+
+PhaseEnergy reconcilePhaseEnergy(int slot, const Energy& value) {
+    PhaseEnergy phases = {0, 0, 0};
+    PhaseIntegrator* state = integrator(slot);
+    if (!state) {
+        return phases;
+    }
+    PhaseEnergyRecord& record = state->Record;
+
+    // a new session restarts EnergyLastCharge and moves the previous one down the list
+    if (state->Anchored && (value.EnergyLastCharge < record.EnergyLastCharge ||
+                            value.Energy2ndLastCharge != record.Energy2ndLastCharge)) {
+        memset(record.PhaseWattMs, 0, sizeof(record.PhaseWattMs));
+        state->SaveDue = true;
+        count(&PhaseEnergyStats::Sessions);
+        LOG_INFO("phase energy session started", record.Address);
+    }
+    if (!state->Anchored || value.EnergyLastCharge != record.EnergyLastCharge ||
+        value.Energy2ndLastCharge != record.Energy2ndLastCharge) {
+        record.EnergyLastCharge = value.EnergyLastCharge;
+        record.Energy2ndLastCharge = value.Energy2ndLastCharge;
+        state->Anchored = true;
+        state->Dirty = true;
+    }
+
+    // the charger meters the session, the integrals only split it into phases
+    double sum = (double)record.PhaseWattMs[0] + (double)record.PhaseWattMs[1] + (double)record.PhaseWattMs[2];
+    if (sum <= 0) {
+        return phases;
+    }
+    double total = value.EnergyLastCharge;
+    phases.L1 = (uint32_t)(total * record.PhaseWattMs[0] / sum + 0.5);
+    phases.L2 = (uint32_t)(total * record.PhaseWattMs[1] / sum + 0.5);
+    phases.L3 = (uint32_t)(total * record.PhaseWattMs[2] / sum + 0.5);
+    return phases;
+}
+
+static void save(PhaseIntegrator& state, unsigned long now) {
+    // a failed save is retried after the next interval, not on every call
+    state.SavedAt = now;
+    state.SaveDue = false;
+    if (phaseEnergyStore().save(state.Record)) {
+        state.Dirty = false;
+        count(&PhaseEnergyStats::Saves);
+    } else {
+        LOG_ERROR("phase energy save failed", state.Record.Address);
+        count(&PhaseEnergyStats::SaveErrors);
+    }
+}
+
+void servicePhaseEnergy(unsigned long now) {
+    for (int slot = 0; slot < MAX_CHARGERS; ++slot) {
+        PhaseIntegrator& state = integrators[slot];
+        if (!state.Loaded || !state.Dirty) {
+            continue;
+        }
+        if (state.SaveDue || now - state.SavedAt >= PHASE_ENERGY_SAVE_INTERVAL_MS) {
+            save(state, now);
+        }
+    }
+}
+
+void releasePhaseEnergy(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    PhaseIntegrator& state = integrators[slot];
+    if (state.Loaded && state.Dirty) {
+        save(state, millis());
+    }
+    memset(&state, 0, sizeof(state));
+}
+
+void getPhaseEnergyStats(PhaseEnergyStats& out) {
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
+}
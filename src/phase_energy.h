@@ -0,0 +1,104 @@
+#pragma once
+#include <Arduino.h>
+
+#include "snapshot.h"
+
+// Power samples further apart than this are not integrated, the gap is left out
+// of the session instead of being bridged by a straight line (in milliseconds)
+#ifndef PHASE_ENERGY_MAX_GAP_MS
+#define PHASE_ENERGY_MAX_GAP_MS 30000
+#endif
+
+// Interval in which the integrals of a charger are saved while they change (in milliseconds)
+#ifndef PHASE_ENERGY_SAVE_INTERVAL_MS
+#define PHASE_ENERGY_SAVE_INTERVAL_MS (5UL * 60UL * 1000UL)
+#endif
+
+// The integrals of the current charging session of a charger, saved so they survive a reboot
+struct PhaseEnergyRecord {
+    char Address[18];
+    // identify the session the integrals belong to, in Wh as reported by the charger
+    uint32_t EnergyLastCharge;
+    uint32_t Energy2ndLastCharge;
+    // trapezoidal integrals of Power.L1 to L3 in Wms
+    uint64_t PhaseWattMs[3];
+};
+
+/**
+ * Persistent storage of the phase energy records, one per charger. Only used by the poller task.
+ */
+class PhaseEnergyStore {
+public:
+    virtual ~PhaseEnergyStore() {}
+
+    /**
+     * @brief Loads the record of a charger.
+     * @param address The MAC address of the charger.
+     * @param out Receives the record.
+     * @return false if no valid record was saved.
+     */
+    virtual bool load(const char* address, PhaseEnergyRecord& out) = 0;
+
+    /**
+     * @brief Saves a record, replacing the one of the same charger.
+     * @param record The record.
+     * @return false if the record could not be written.
+     */
+    virtual bool save(const PhaseEnergyRecord& record) = 0;
+};
+
+/**
+ * @brief Returns the phase energy store of the platform (NVS on the ESP32, a file or memory on the native build).
+ * @return The store.
+ */
+PhaseEnergyStore& phaseEnergyStore();
+
+struct PhaseEnergyStats {
+    // power samples that were integrated
+    uint32_t Samples;
+    // intervals longer than PHASE_ENERGY_MAX_GAP_MS that were left out
+    uint32_t Gaps;
+    // session boundaries that reset the integrals
+    uint32_t Sessions;
+    // records restored after a reboot
+    uint32_t Restored;
+    uint32_t Saves;
+    uint32_t SaveErrors;
+};
+
+/**
+ * @brief Integrates a Power sample into the session of a charger. Only called by the poller task.
+ * @param slot The charger slot.
+ * @param value The decoded value.
+ * @param now Time of the sample from snapshotNow().
+ */
+void integratePhasePower(int slot, const Power& value, int64_t now);
+
+/**
+ * @brief Anchors the integrals of a charger to an Energy sample and splits its EnergyLastCharge
+ *        into phases by the integrals. A new session resets the integrals. Only called by the poller task.
+ * @param slot The charger slot.
+ * @param value The decoded value.
+ * @return The energy per phase, its sum is EnergyLastCharge up to rounding.
+ */
+PhaseEnergy reconcilePhaseEnergy(int slot, const Energy& value);
+
+/**
+ * @brief Saves the records that changed since PHASE_ENERGY_SAVE_INTERVAL_MS and the ones
+ *        of a session that just started. Only called by the poller task.
+ * @param now Current time from millis().
+ */
+void servicePhaseEnergy(unsigned long now);
+
+/**
+ * @brief Saves the record of a released charger slot if it changed and forgets it,
+ *        the next charger in the slot loads its own. Only called by the poller task.
+ * @param slot The charger slot.
+ */
+void releasePhaseEnergy(int slot);
+
+/**
+ * @brief Returns the counters of the phase energy integration.
+ * @param out Stats to copy into.
+ */
+void getPhaseEnergyStats(PhaseEnergyStats& out);
@@ -0,0 +1,122 @@
+#include "prefetch.h"
+
+#include <limits.h>
+
+struct ClientBursts {
+    bool Used;
+    uint32_t Client;
+    int Slot;
+    unsigned long LastRequest;
+    // parts requested in the current burst
+    uint8_t BurstParts;
+    // parts of the last completed burst and how often it repeated
+    uint8_t LearnedParts;
+    uint8_t Repeats;
+    uint8_t PrefetchedParts;
+};
+
+static ClientBursts clients[PREFETCH_MAX_CLIENTS];
+static PrefetchStats stats;
+static portMUX_TYPE prefetchMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t countParts(uint8_t parts) {
+    uint8_t count = 0;
+    for (; parts; parts &= parts - 1) {
+        count++;
+    }
+    return count;
+}
+
+static int findClientLocked(uint32_t client, int slot, unsigned long now, bool& created) {
+    int replace = 0;
+    unsigned long replaceIdle = 0;
+    for (int i = 0; i < PREFETCH_MAX_CLIENTS; ++i) {
+        if (clients[i].Used && clients[i].Client == client && clients[i].Slot == slot) {
+            created = false;
+            return i;
+        }
+        // free entries first, then the one idle for the longest time
+        unsigned long idle = clients[i].Used ? now - clients[i].LastRequest : ULONG_MAX;
+        if (idle >= replaceIdle) {
+            replace = i;
+            replaceIdle = idle;
+        }
+    }
+    ClientBursts& entry = clients[replace];
+    memset(&entry, 0, sizeof(entry));
+    entry.Used = true;
+    entry.Client = client;
+    entry.Slot = slot;
+    created = true;
+    return replace;
+}
+
+static void finishBurstLocked(ClientBursts& entry) {
+    stats.Wasted += countParts(entry.PrefetchedParts & ~entry.BurstParts);
+    if (entry.BurstParts == entry.LearnedParts) {
+        if (entry.Repeats < UINT8_MAX) {
+            entry.Repeats++;
+        }
+    } else {
+        entry.LearnedParts = entry.BurstParts;
+        entry.Repeats = 1;
+    }
+}
+
+PrefetchDecision prefetchRequest(uint32_t client, int slot, uint8_t parts, unsigned long now) {
+    PrefetchDecision decision = {-1, false, 0};
+    if (slot < 0) {
+        return decision;
+    }
+    portENTER_CRITICAL(&prefetchMux);
+    bool created;
+    int index = findClientLocked(client, slot, now, created);
+    ClientBursts& entry = clients[index];
+    decision.Entry = index;
+    if (created || now - entry.LastRequest > PREFETCH_BURST_GAP_MS) {
+        if (!created) {
+            finishBurstLocked(entry);
+        }
+        stats.Bursts++;
+        decision.BurstStart = true;
+        entry.BurstParts = 0;
+        entry.PrefetchedParts = 0;
+        if (PREFETCH_ENABLED && entry.Repeats >= PREFETCH_MIN_REPEATS && (entry.LearnedParts & ~parts)) {
+            entry.PrefetchedParts = entry.LearnedParts & ~parts;
+            decision.Parts = entry.PrefetchedParts;
+            stats.Prefetches++;
+        }
+    }
+    entry.BurstParts |= parts;
+    entry.LastRequest = now;
+    portEXIT_CRITICAL(&prefetchMux);
+    return decision;
+}
+
+void prefetchServed(const PrefetchDecision& decision, uint8_t parts, PrefetchOutcome outcome) {
+    if (decision.Entry < 0) {
+        return;
+    }
+    portENTER_CRITICAL(&prefetchMux);
+    // only parts the burst prefetched show the effect of the prefetch, a request for parts
+    // that were fresh anyway is an ordinary cache hit
+    bool prefetched = !decision.BurstStart && (clients[decision.Entry].PrefetchedParts & parts);
+    switch (outcome) {
+        case PREFETCH_FROM_MEMORY:
+            (prefetched ? stats.Hits : stats.CacheHits)++;
+            break;
+        case PREFETCH_SHARED:
+            (prefetched ? stats.Shared : stats.CacheMisses)++;
+            break;
+        case PREFETCH_OWN_READ:
+            (prefetched ? stats.Misses : stats.CacheMisses)++;
+            break;
+    }
+    portEXIT_CRITICAL(&prefetchMux);
+}
+
+void getPrefetchStats(PrefetchStats& out) {
+    portENTER_CRITICAL(&prefetchMux);
+    out = stats;
+    portEXIT_CRITICAL(&prefetchMux);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <Arduino.h>
+
+// Set to 0 to disable the prefetch, requests are still counted
+#ifndef PREFETCH_ENABLED
+#define PREFETCH_ENABLED 1
+#endif
+
+// A request after this pause starts a new burst of a client
+#ifndef PREFETCH_BURST_GAP_MS
+#define PREFETCH_BURST_GAP_MS 2000
+#endif
+
+// Number of bursts with the same parts before they are prefetched
+#ifndef PREFETCH_MIN_REPEATS
+#define PREFETCH_MIN_REPEATS 2
+#endif
+
+// Number of client and charger pairs whose bursts are learned
+#ifndef PREFETCH_MAX_CLIENTS
+#define PREFETCH_MAX_CLIENTS 8
+#endif
+
+// How a request was answered
+enum PrefetchOutcome {
+    // from the snapshot without waiting for BLE
+    PREFETCH_FROM_MEMORY,
+    // attached to a refresh that was already in flight, e.g. the prefetch
+    PREFETCH_SHARED,
+    // needed a refresh of its own
+    PREFETCH_OWN_READ
+};
+
+struct PrefetchDecision {
+    // index of the client entry or -1 if the request is not tracked
+    int Entry;
+    bool BurstStart;
+    // parts predicted for the rest of the burst, to be read together with the request
+    uint8_t Parts;
+};
+
+struct PrefetchStats {
+    uint32_t Bursts;
+    uint32_t Prefetches;
+    // follow-up requests of a burst for parts that were prefetched, by outcome
+    uint32_t Hits;
+    uint32_t Shared;
+    uint32_t Misses;
+    // prefetched parts the rest of the burst did not request
+    uint32_t Wasted;
+    // all other requests, answered from the snapshot or after waiting for BLE
+    uint32_t CacheHits;
+    uint32_t CacheMisses;
+};
+
+/**
+ * @brief Records a snapshot request of a client. At the start of a burst that repeated the
+ *        same parts PREFETCH_MIN_REPEATS times, these parts are predicted for the rest of the burst.
+ * @param client Identifies the client, e.g. its IPv4 address.
+ * @param slot The charger slot.
+ * @param parts Bitmask of SnapshotPart bits the request needs.
+ * @param now Current time in milliseconds.
+ * @return The decision, Parts is 0 unless a known burst starts.
+ */
+PrefetchDecision prefetchRequest(uint32_t client, int slot, uint8_t parts, unsigned long now);
+
+/**
+ * @brief Records how a request was answered. Follow-up requests for parts the burst prefetched
+ *        count as prefetch hits, shared or misses, all others as cache hits or misses.
+ * @param decision The decision returned for the request.
+ * @param parts Bitmask of SnapshotPart bits the request needed.
+ * @param outcome How the request was answered.
+ */
+void prefetchServed(const PrefetchDecision& decision, uint8_t parts, PrefetchOutcome outcome);
+
+/**
+ * @brief Returns the prefetch statistics.
+ * @param out Stats to copy into.
+ */
+void getPrefetchStats(PrefetchStats& out);
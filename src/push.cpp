@@ -0,0 +1,213 @@
+#include "push.h"
+
+#include "response_buffer.h"
+#include "snapshot_fields.h"
+
+static_assert(SNAPSHOT_FIELD_COUNT <= 32, "changed fields are tracked in a 32 bit mask");
+
+#define FIELD_BIT(field) (1UL << (field))
+
+// Values of a charger as last sent, the base of the next message. Only the poller task uses it.
+struct PushedState {
+    char Address[18];
+    int64_t Values[SNAPSHOT_FIELD_COUNT];
+    // parts sent at least once
+    uint8_t Parts;
+    uint32_t Sequence;
+};
+
+static PushedState pushed[MAX_CHARGERS];
+// parts stored since the last message and when it was sent, poller task only
+static uint8_t pendingParts[MAX_CHARGERS];
+static unsigned long lastPushAt[MAX_CHARGERS];
+static unsigned long lastFullAt = 0;
+
+static PushChannel* channels[PUSH_MAX_CHANNELS];
+static size_t channelCount = 0;
+static bool fullRequested = false;
+static PushStats stats;
+static portMUX_TYPE pushMux = portMUX_INITIALIZER_UNLOCKED;
+
+void addPushChannel(PushChannel* channel) {
+    portENTER_CRITICAL(&pushMux);
+    if (channelCount < PUSH_MAX_CHANNELS) {
+        channels[channelCount++] = channel;
+    }
+    portEXIT_CRITICAL(&pushMux);
+}
+
+void requestPushState() {
+    portENTER_CRITICAL(&pushMux);
+    fullRequested = true;
+    portEXIT_CRITICAL(&pushMux);
+}
+
+void markPushPending(int slot, SnapshotPart part) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    if (pendingParts[slot] & PART_BIT(part)) {
+        portENTER_CRITICAL(&pushMux);
+        stats.Merged++;
+        portEXIT_CRITICAL(&pushMux);
+    }
+    pendingParts[slot] |= PART_BIT(part);
+}
+
+// {"Address":"..","Seq":7,"Power":{"TotalPower":1234,"L1":411},"VoltageCurrent":{...}}
+static void renderMessage(ResponseBuffer& out, const PushedState& state, uint32_t fields, bool full) {
+    out.append("{\"Address\":");
+    out.appendJsonString(state.Address);
+    out.append(",\"Seq\":");
+    out.appendUnsigned(state.Sequence);
+    if (full) {
+        out.append(",\"Full\":true");
+    }
+    int part = -1;
+    for (size_t i = 0; i < SNAPSHOT_FIELD_COUNT; ++i) {
+        if (!(fields & FIELD_BIT(i))) {
+            continue;
+        }
+        const SnapshotField& field = snapshotFields[i];
+        if (field.Part != part) {
+            out.append(part < 0 ? ",\"" : "},\"");
+            out.append(snapshotPartName(field.Part));
+            out.append("\":{");
+            part = field.Part;
+        } else {
+            out.append(',');
+        }
+        out.appendJsonString(field.Name);
+        out.append(':');
+        out.appendInt(state.Values[i]);
+    }
+    out.append(part < 0 ? "}" : "}}");
+}
+
+static void broadcast(PushChannel* const* targets, size_t count, const ResponseBuffer& message, uint32_t sequence) {
+    for (size_t i = 0; i < count; ++i) {
+        if (targets[i]->subscriberCount() > 0) {
+            targets[i]->broadcast(message.c_str(), message.length(), sequence);
+        }
+    }
+}
+
+static void pushChanges(int slot, unsigned long now, PushChannel* const* targets, size_t count, size_t subscribers) {
+    uint8_t parts = pendingParts[slot];
+    if (parts == 0 || now - lastPushAt[slot] < PUSH_MIN_INTERVAL_MS) {
+        return;
+    }
+    pendingParts[slot] = 0;
+    lastPushAt[slot] = now;
+    ChargerSnapshot snapshot;
+    if (!copySnapshot(slot, snapshot)) {
+        return;
+    }
+
+    // only fields that differ from the last message are sent, the whole
+    // characteristic the first time it is sent
+    PushedState& state = pushed[slot];
+    parts &= snapshot.Valid;
+    uint32_t changed = 0;
+    for (size_t i = 0; i < SNAPSHOT_FIELD_COUNT; ++i) {
+        const SnapshotField& field = snapshotFields[i];
+        if (!(parts & PART_BIT(field.Part))) {
+            continue;
+        }
+        int64_t value = readSnapshotField(snapshot, field);
+        if (!(state.Parts & PART_BIT(field.Part)) || value != state.Values[i]) {
+            state.Values[i] = value;
+            changed |= FIELD_BIT(i);
+        }
+    }
+    if (changed == 0) {
+        portENTER_CRITICAL(&pushMux);
+        stats.Unchanged++;
+        portEXIT_CRITICAL(&pushMux);
+        return;
+    }
+    strlcpy(state.Address, snapshot.Address, sizeof(state.Address));
+    state.Parts |= parts;
+    state.Sequence++;
+    // without subscribers the state is only kept as base for the ones to come
+    if (subscribers == 0) {
+        return;
+    }
+
+    StaticResponseBuffer<PUSH_MESSAGE_SIZE> message;
+    renderMessage(message, state, changed, false);
+    broadcast(targets, count, message, state.Sequence);
+    portENTER_CRITICAL(&pushMux);
+    stats.Messages++;
+    portEXIT_CRITICAL(&pushMux);
+}
+
+static void pushFull(int slot, PushChannel* const* targets, size_t count) {
+    const PushedState& state = pushed[slot];
+    if (state.Parts == 0) {
+        return;
+    }
+    uint32_t fields = 0;
+    for (size_t i = 0; i < SNAPSHOT_FIELD_COUNT; ++i) {
+        if (state.Parts & PART_BIT(snapshotFields[i].Part)) {
+            fields |= FIELD_BIT(i);
+        }
+    }
+    StaticResponseBuffer<PUSH_MESSAGE_SIZE> message;
+    renderMessage(message, state, fields, true);
+    broadcast(targets, count, message, state.Sequence);
+    portENTER_CRITICAL(&pushMux);
+    stats.Messages++;
+    stats.FullMessages++;
+    portEXIT_CRITICAL(&pushMux);
+}
+
+void servicePush(unsigned long now) {
+    PushChannel* targets[PUSH_MAX_CHANNELS];
+    portENTER_CRITICAL(&pushMux);
+    size_t count = channelCount;
+    memcpy(targets, channels, sizeof(targets[0]) * count);
+    bool full = fullRequested;
+    fullRequested = false;
+    portEXIT_CRITICAL(&pushMux);
+
+    // one message per charger is fanned out to all subscribers of all channels
+    size_t subscribers = 0;
+    for (size_t i = 0; i < count; ++i) {
+        subscribers += targets[i]->subscriberCount();
+    }
+    for (int slot = 0; slot < MAX_CHARGERS; ++slot) {
+        pushChanges(slot, now, targets, count, subscribers);
+    }
+
+    // full messages follow the changes, so they are never older than a message sent before
+    if (subscribers == 0 || (!full && now - lastFullAt < PUSH_FULL_INTERVAL_MS)) {
+        return;
+    }
+    lastFullAt = now;
+    for (int slot = 0; slot < MAX_CHARGERS; ++slot) {
+        pushFull(slot, targets, count);
+    }
+}
+
+void releasePushState(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    memset(&pushed[slot], 0, sizeof(pushed[slot]));
+    pendingParts[slot] = 0;
+    lastPushAt[slot] = 0;
+}
+
+void getPushStats(PushStats& out) {
+    PushChannel* targets[PUSH_MAX_CHANNELS];
+    portENTER_CRITICAL(&pushMux);
+    size_t count = channelCount;
+    memcpy(targets, channels, sizeof(targets[0]) * count);
+    out = stats;
+    portEXIT_CRITICAL(&pushMux);
+    out.Subscribers = 0;
+    for (size_t i = 0; i < count; ++i) {
+        out.Subscribers += targets[i]->subscriberCount();
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+
+#include "snapshot.h"
+
+// Minimum time between two messages of a charger, values stored in between are merged
+#ifndef PUSH_MIN_INTERVAL_MS
+#define PUSH_MIN_INTERVAL_MS 1000
+#endif
+
+// Messages with all fields are repeated this often, subscribers that missed a message catch up
+#ifndef PUSH_FULL_INTERVAL_MS
+#define PUSH_FULL_INTERVAL_MS 60000
+#endif
+
+// Maximum number of push channels, e.g. Server-Sent Events and WebSocket
+#ifndef PUSH_MAX_CHANNELS
+#define PUSH_MAX_CHANNELS 2
+#endif
+
+// Large enough for a message with all fields of a charger
+#define PUSH_MESSAGE_SIZE 1024
+
+/**
+ * Transport delivering push messages to its subscribers, e.g. Server-Sent Events.
+ */
+class PushChannel {
+public:
+    virtual ~PushChannel() {}
+
+    /**
+     * @brief Returns the number of connected subscribers.
+     */
+    virtual size_t subscriberCount() = 0;
+
+    /**
+     * @brief Queues a message for all subscribers without waiting for them. Called by the poller task.
+     * @param message The JSON message, null terminated.
+     * @param length Length of the message.
+     * @param sequence Sequence number of the message.
+     */
+    virtual void broadcast(const char* message, size_t length, uint32_t sequence) = 0;
+};
+
+struct PushStats {
+    uint32_t Subscribers;
+    uint32_t Messages;
+    uint32_t FullMessages;
+    // stored values that were merged into a later message because of the minimum interval
+    uint32_t Merged;
+    // stored values without a changed field
+    uint32_t Unchanged;
+};
+
+/**
+ * @brief Adds a channel that receives all push messages.
+ * @param channel The channel, must live as long as the program.
+ */
+void addPushChannel(PushChannel* channel);
+
+/**
+ * @brief Sends messages with all fields to all subscribers, e.g. once a new subscriber connected.
+ *        Can be called from any task.
+ */
+void requestPushState();
+
+/**
+ * @brief Marks a characteristic of a charger as stored. Only called by the poller task.
+ * @param slot The charger slot.
+ * @param part The characteristic.
+ */
+void markPushPending(int slot, SnapshotPart part);
+
+/**
+ * @brief Sends the changed fields of all chargers whose minimum interval elapsed, and the
+ *        requested or periodic full messages. Only called by the poller task.
+ * @param now Current time in milliseconds.
+ */
+void servicePush(unsigned long now);
+
+/**
+ * @brief Forgets what was sent for a released charger slot, the next charger in it
+ *        starts with all fields. Only called by the poller task.
+ * @param slot The charger slot.
+ */
+void releasePushState(int slot);
+
+/**
+ * @brief Returns the push statistics.
+ * @param out Stats to copy into.
+ */
+void getPushStats(PushStats& out);
@@ -0,0 +1,140 @@
+#include "refresh.h"
+
+enum FlightState {
+    FLIGHT_FREE = 0,
+    FLIGHT_STARTING,
+    FLIGHT_QUEUED,
+    FLIGHT_RUNNING
+};
+
+struct Flight {
+    FlightState State;
+    int Slot;
+    uint8_t Parts;
+    uint8_t Waiters;
+    // incremented on every start, tells a reused flight from the one that was started
+    uint32_t Generation;
+    BleJobCallback Callbacks[MAX_REFRESH_WAITERS];
+    void* Contexts[MAX_REFRESH_WAITERS];
+};
+
+static Flight flights[MAX_REFRESH_FLIGHTS];
+static RefreshStats stats;
+static portMUX_TYPE flightMux = portMUX_INITIALIZER_UNLOCKED;
+
+RefreshStatus requestRefresh(int slot, uint8_t parts, BleJobCallback callback, void* context) {
+    int index = -1;
+    uint32_t generation = 0;
+    portENTER_CRITICAL(&flightMux);
+    for (int i = 0; i < MAX_REFRESH_FLIGHTS; ++i) {
+        Flight& flight = flights[i];
+        if (flight.Slot != slot || flight.Waiters >= MAX_REFRESH_WAITERS) {
+            continue;
+        }
+        bool covered = (flight.Parts & parts) == parts;
+        if (flight.State == FLIGHT_QUEUED || (flight.State == FLIGHT_RUNNING && covered)) {
+            if (covered) {
+                stats.Coalesced++;
+            } else {
+                // the job has not started yet and reads the merged parts
+                flight.Parts |= parts;
+                stats.Merged++;
+            }
+            flight.Callbacks[flight.Waiters] = callback;
+            flight.Contexts[flight.Waiters] = context;
+            flight.Waiters++;
+            portEXIT_CRITICAL(&flightMux);
+            return REFRESH_ATTACHED;
+        }
+    }
+    for (int i = 0; i < MAX_REFRESH_FLIGHTS; ++i) {
+        Flight& flight = flights[i];
+        if (flight.State == FLIGHT_FREE) {
+            flight.State = FLIGHT_STARTING;
+            flight.Slot = slot;
+            flight.Parts = parts;
+            flight.Callbacks[0] = callback;
+            flight.Contexts[0] = context;
+            flight.Waiters = 1;
+            generation = ++flight.Generation;
+            index = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&flightMux);
+    if (index < 0) {
+        portENTER_CRITICAL(&flightMux);
+        stats.Rejected++;
+        portEXIT_CRITICAL(&flightMux);
+        return REFRESH_BUSY;
+    }
+
+    // nobody can attach before the job is queued, so a full queue only rejects this request.
+    // Once queued, the poller task may already have run and completed the job, and the flight
+    // may even be started again, so it is only marked as queued if it is still this start.
+    BleJob job = {};
+    job.Type = JOB_REFRESH;
+    job.Slot = slot;
+    job.Flight = index;
+    bool queued = enqueueBleJob(job);
+    portENTER_CRITICAL(&flightMux);
+    Flight& flight = flights[index];
+    if (queued) {
+        if (flight.State == FLIGHT_STARTING && flight.Generation == generation) {
+            flight.State = FLIGHT_QUEUED;
+        }
+        stats.Started++;
+    } else {
+        flight.State = FLIGHT_FREE;
+        flight.Waiters = 0;
+        stats.Rejected++;
+    }
+    portEXIT_CRITICAL(&flightMux);
+    return queued ? REFRESH_STARTED : REFRESH_BUSY;
+}
+
+uint8_t refreshParts(int index) {
+    portENTER_CRITICAL(&flightMux);
+    flights[index].State = FLIGHT_RUNNING;
+    uint8_t parts = flights[index].Parts;
+    portEXIT_CRITICAL(&flightMux);
+    return parts;
+}
+
+void completeRefresh(int index, const char* error) {
+    BleJobCallback callbacks[MAX_REFRESH_WAITERS];
+    void* contexts[MAX_REFRESH_WAITERS];
+    portENTER_CRITICAL(&flightMux);
+    Flight& flight = flights[index];
+    uint8_t waiters = flight.Waiters;
+    memcpy(callbacks, flight.Callbacks, sizeof(callbacks));
+    memcpy(contexts, flight.Contexts, sizeof(contexts));
+    flight.Waiters = 0;
+    flight.State = FLIGHT_FREE;
+    portEXIT_CRITICAL(&flightMux);
+
+    for (uint8_t i = 0; i < waiters; ++i) {
+        if (callbacks[i]) {
+            callbacks[i](contexts[i], error);
+        }
+    }
+}
+
+bool refreshActive(int slot) {
+    bool active = false;
+    portENTER_CRITICAL(&flightMux);
+    for (const Flight& flight : flights) {
+        if (flight.State != FLIGHT_FREE && flight.Slot == slot) {
+            active = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&flightMux);
+    return active;
+}
+
+void getRefreshStats(RefreshStats& out) {
+    portENTER_CRITICAL(&flightMux);
+    out = stats;
+    portEXIT_CRITICAL(&flightMux);
+}
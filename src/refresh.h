@@ -0,0 +1,69 @@
+#pragma once
+#include <Arduino.h>
+
+#include "ble_poller.h"
+
+// Maximum number of distinct refreshes in flight at the same time
+#ifndef MAX_REFRESH_FLIGHTS
+#define MAX_REFRESH_FLIGHTS 8
+#endif
+
+// Maximum number of requests attached to one refresh
+#ifndef MAX_REFRESH_WAITERS
+#define MAX_REFRESH_WAITERS 8
+#endif
+
+enum RefreshStatus {
+    REFRESH_STARTED,
+    REFRESH_ATTACHED,
+    REFRESH_BUSY
+};
+
+struct RefreshStats {
+    uint32_t Started;
+    uint32_t Coalesced;
+    // requests that added parts to a queued refresh of the same charger
+    uint32_t Merged;
+    uint32_t Rejected;
+};
+
+/**
+ * @brief Requests a refresh of parts of a charger snapshot.
+ *        A request for a charger and set of parts that is already covered by a
+ *        refresh in flight attaches to it instead of starting another BLE read.
+ *        Requests for other parts of a charger with a refresh that is still queued
+ *        add their parts to it, so one BLE session serves all of them.
+ * @param slot The charger slot.
+ * @param parts Bitmask of SnapshotPart bits to read.
+ * @param callback Called from the poller task once the refresh finished, may be NULL.
+ * @param context Passed to the callback.
+ * @return REFRESH_BUSY if the refresh could not be queued, the callback is not called in this case.
+ */
+RefreshStatus requestRefresh(int slot, uint8_t parts, BleJobCallback callback, void* context);
+
+/**
+ * @brief Returns the parts to read for a refresh and marks it as running, parts can no longer be added.
+ * @param flight The flight handle of the refresh job.
+ * @return Bitmask of SnapshotPart bits.
+ */
+uint8_t refreshParts(int flight);
+
+/**
+ * @brief Completes a refresh and calls the callbacks of all attached requests.
+ * @param flight The flight handle of the refresh job.
+ * @param error Static error message or NULL on success.
+ */
+void completeRefresh(int flight, const char* error);
+
+/**
+ * @brief Returns whether a refresh of a charger is queued or running.
+ * @param slot The charger slot.
+ * @return true if a flight of the slot is in use.
+ */
+bool refreshActive(int slot);
+
+/**
+ * @brief Returns the refresh statistics.
+ * @param out Stats to copy into.
+ */
+void getRefreshStats(RefreshStats& out);
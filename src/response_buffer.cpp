@@ -0,0 +1,122 @@
+#include "response_buffer.h"
+
+ResponseBuffer::ResponseBuffer(char* storage, size_t size) : data(storage), capacity(size) {
+    clear();
+}
+
+void ResponseBuffer::append(const char* text) {
+    append(text, strlen(text));
+}
+
+void ResponseBuffer::append(const char* text, size_t length) {
+    // one byte is kept for the terminator
+    if (overflow || length >= capacity - used) {
+        overflow = true;
+        return;
+    }
+    memcpy(data + used, text, length);
+    used += length;
+    data[used] = 0;
+}
+
+void ResponseBuffer::append(char c) {
+    append(&c, 1);
+}
+
+void ResponseBuffer::appendInt(int64_t value) {
+    if (value < 0) {
+        append('-');
+        appendUnsigned(-(uint64_t)value);
+        return;
+    }
+    appendUnsigned(value);
+}
+
+void ResponseBuffer::appendUnsigned(uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[sizeof(digits) - ++count] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    append(digits + sizeof(digits) - count, count);
+}
+
+void ResponseBuffer::appendFixed(int64_t value, uint8_t decimals) {
+    uint64_t scale = 1;
+    for (uint8_t i = 0; i < decimals; ++i) {
+        scale *= 10;
+    }
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : value;
+    uint64_t fraction = magnitude % scale;
+    if (value < 0) {
+        append('-');
+    }
+    appendUnsigned(magnitude / scale);
+    if (fraction == 0) {
+        return;
+    }
+
+    char digits[10];
+    uint8_t count = min(decimals, (uint8_t)sizeof(digits));
+    for (uint8_t i = count; i > 0; --i) {
+        digits[i - 1] = '0' + fraction % 10;
+        fraction /= 10;
+    }
+    while (count > 0 && digits[count - 1] == '0') {
+        count--;
+    }
+    append('.');
+    append(digits, count);
+}
+
+void ResponseBuffer::appendJsonString(const char* text) {
+    append('"');
+    for (const char* c = text; *c; ++c) {
+        switch (*c) {
+            case '"':
+                append("\\\"");
+                break;
+            case '\\':
+                append("\\\\");
+                break;
+            case '\n':
+                append("\\n");
+                break;
+            case '\r':
+                append("\\r");
+                break;
+            case '\t':
+                append("\\t");
+                break;
+            default:
+                if ((uint8_t)*c < 0x20) {
+                    static const char hex[] = "0123456789abcdef";
+                    char escaped[] = {'\\', 'u', '0', '0', hex[(*c >> 4) & 0x0f], hex[*c & 0x0f]};
+                    append(escaped, sizeof(escaped));
+                } else {
+                    append(*c);
+                }
+                break;
+        }
+    }
+    append('"');
+}
+
+void ResponseBuffer::clear() {
+    used = 0;
+    overflow = false;
+    data[0] = 0;
+}
+
+const char* ResponseBuffer::c_str() const {
+    return data;
+}
+
+size_t ResponseBuffer::length() const {
+    return used;
+}
+
+bool ResponseBuffer::overflowed() const {
+    return overflow;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+
+// Capacity of a response body built without heap allocations
+#ifndef RESPONSE_BUFFER_SIZE
+#define RESPONSE_BUFFER_SIZE 512
+#endif
+
+/**
+ * Fixed size buffer a response body is serialized into, e.g. on the stack of a handler.
+ * Output that does not fit is dropped and marks the buffer as overflowed.
+ */
+class ResponseBuffer {
+public:
+    /**
+     * @param storage Memory the body is written to, must outlive the buffer.
+     * @param size Size of the memory including the terminator.
+     */
+    ResponseBuffer(char* storage, size_t size);
+
+    void append(const char* text);
+    void append(const char* text, size_t length);
+    void append(char c);
+    void appendInt(int64_t value);
+    void appendUnsigned(uint64_t value);
+
+    /**
+     * @brief Appends a fixed point value with trailing zeros removed, e.g. 23050 with 2 decimals as 230.5.
+     * @param value The value in units of 10^-decimals.
+     * @param decimals Number of decimal places of the value.
+     */
+    void appendFixed(int64_t value, uint8_t decimals);
+
+    /**
+     * @brief Appends a quoted and escaped JSON string.
+     * @param text The unescaped text.
+     */
+    void appendJsonString(const char* text);
+
+    void clear();
+    const char* c_str() const;
+    size_t length() const;
+    bool overflowed() const;
+
+private:
+    char* data;
+    size_t capacity;
+    size_t used;
+    bool overflow;
+};
+
+/**
+ * ResponseBuffer with its own storage.
+ */
+template <size_t Size = RESPONSE_BUFFER_SIZE>
+class StaticResponseBuffer : public ResponseBuffer {
+public:
+    StaticResponseBuffer() : ResponseBuffer(storage, Size) {}
+
+private:
+    char storage[Size];
+};
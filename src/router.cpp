@@ -0,0 +1,188 @@
+#include "router.h"
+
+static_assert(ROUTER_MAX_NODES <= 128, "node indices are stored as int8_t");
+static_assert(HTTP_MAX_PATH_ARG_SIZE > 17, "a captured MAC address must fit a path argument");
+
+static RouterNode nodes[ROUTER_MAX_NODES];
+static size_t nodeCount = 0;
+
+static int addNode(const char* literal, uint8_t length, uint8_t capture) {
+    if (nodeCount >= ROUTER_MAX_NODES) {
+        return -1;
+    }
+    RouterNode& node = nodes[nodeCount];
+    node.Literal = literal;
+    node.LiteralLength = length;
+    node.Capture = capture;
+    node.FirstChild = -1;
+    node.NextSibling = -1;
+    for (int8_t& route : node.Routes) {
+        route = -1;
+    }
+    return nodeCount++;
+}
+
+// Finds or adds the child of a node for a pattern segment, -1 if the trie is full or
+// the parent has a capture of another type, a path could not tell them apart
+static int childNode(int parent, const char* literal, uint8_t length, uint8_t capture) {
+    int last = -1;
+    for (int child = nodes[parent].FirstChild; child >= 0; child = nodes[child].NextSibling) {
+        const RouterNode& node = nodes[child];
+        if (capture != CAPTURE_NONE && node.Capture != CAPTURE_NONE && node.Capture != capture) {
+            return -1;
+        }
+        if (node.Capture == capture &&
+            (capture != CAPTURE_NONE || (node.LiteralLength == length && memcmp(node.Literal, literal, length) == 0))) {
+            return child;
+        }
+        last = child;
+    }
+    int child = addNode(literal, length, capture);
+    if (child >= 0) {
+        if (last < 0) {
+            nodes[parent].FirstChild = child;
+        } else {
+            nodes[last].NextSibling = child;
+        }
+    }
+    return child;
+}
+
+static int parseCapture(const char* segment, size_t length) {
+    if (length == 5 && memcmp(segment, "{mac}", 5) == 0) {
+        return CAPTURE_MAC;
+    }
+    if (length == 5 && memcmp(segment, "{pin}", 5) == 0) {
+        return CAPTURE_PIN;
+    }
+    // other names in braces are typos rather than literals
+    return memchr(segment, '{', length) || memchr(segment, '}', length) ? -1 : CAPTURE_NONE;
+}
+
+static bool addRoute(const char* pattern, RouteMethod method, int route) {
+    if (pattern[0] != '/') {
+        return false;
+    }
+    int node = 0;
+    int captures = 0;
+    const char* segment = pattern + 1;
+    for (;;) {
+        size_t length = strcspn(segment, "/");
+        int capture = parseCapture(segment, length);
+        if (length == 0 || length > 255 || capture < 0) {
+            return false;
+        }
+        if (capture != CAPTURE_NONE && ++captures > HTTP_MAX_PATH_ARGS) {
+            return false;
+        }
+        node = childNode(node, segment, length, capture);
+        if (node < 0) {
+            return false;
+        }
+        if (segment[length] == 0) {
+            break;
+        }
+        segment += length + 1;
+    }
+    if (nodes[node].Routes[method] >= 0) {
+        return false;
+    }
+    nodes[node].Routes[method] = route;
+    return true;
+}
+
+bool buildRouter(const Route* routes, size_t count) {
+    nodeCount = 0;
+    addNode("", 0, CAPTURE_NONE);
+    for (size_t i = 0; i < count; ++i) {
+        if (i > INT8_MAX || !addRoute(routes[i].Pattern, routes[i].Method, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isHex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static bool captureValid(uint8_t capture, const char* segment, size_t length) {
+    if (capture == CAPTURE_MAC) {
+        if (length != 17) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (i % 3 == 2 ? segment[i] != ':' : !isHex(segment[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // CAPTURE_PIN
+    if (length < 1 || length > 5) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (segment[i] < '0' || segment[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (segment[i] - '0');
+    }
+    return value <= 0xFFFF;
+}
+
+bool matchRoute(RouteMethod method, const char* path, size_t length, RouteMatch& out) {
+    if (nodeCount == 0 || length == 0 || length > UINT16_MAX || path[0] != '/') {
+        return false;
+    }
+    out.ArgCount = 0;
+    int node = 0;
+    size_t position = 1;
+    for (;;) {
+        const char* segment = path + position;
+        const char* slash = (const char*)memchr(segment, '/', length - position);
+        size_t end = slash ? slash - path : length;
+        size_t segmentLength = end - position;
+
+        // a literal child wins over a capture, there is no backtracking
+        int next = -1;
+        int capture = -1;
+        for (int child = nodes[node].FirstChild; child >= 0; child = nodes[child].NextSibling) {
+            const RouterNode& candidate = nodes[child];
+            if (candidate.Capture != CAPTURE_NONE) {
+                capture = child;
+            } else if (candidate.LiteralLength == segmentLength &&
+                       memcmp(candidate.Literal, segment, segmentLength) == 0) {
+                next = child;
+                break;
+            }
+        }
+        if (next < 0) {
+            if (capture < 0 || !captureValid(nodes[capture].Capture, segment, segmentLength)) {
+                return false;
+            }
+            next = capture;
+            out.ArgStart[out.ArgCount] = position;
+            out.ArgLength[out.ArgCount] = segmentLength;
+            out.ArgCount++;
+        }
+        node = next;
+        if (end == length) {
+            break;
+        }
+        position = end + 1;
+    }
+    out.Route = nodes[node].Routes[method];
+    return out.Route >= 0;
+}
+
+void setPathArgs(HttpRequest& request, const char* path, const RouteMatch& match) {
+    for (uint8_t i = 0; i < match.ArgCount; ++i) {
+        request.setPathArg(i, path + match.ArgStart[i], match.ArgLength[i]);
+    }
+}
+
+size_t routerNodeCount() {
+    return nodeCount;
+}
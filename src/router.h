@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+
+#include "routes.h"
+
+// Maximum number of path segments of all route patterns together, including the root
+#ifndef ROUTER_MAX_NODES
+#define ROUTER_MAX_NODES 48
+#endif
+
+// Value a capture segment accepts
+enum RouteCapture {
+    CAPTURE_NONE,
+    // "00:11:22:33:44:55", upper or lower case
+    CAPTURE_MAC,
+    // a decimal number up to 65535
+    CAPTURE_PIN
+};
+
+// A path segment of the route trie. Children are linked by NextSibling,
+// literal segments are tried before a capture of the same parent.
+struct RouterNode {
+    // points into the route pattern, not terminated
+    const char* Literal;
+    uint8_t LiteralLength;
+    uint8_t Capture;
+    int8_t FirstChild;
+    int8_t NextSibling;
+    // route served by a path ending in this segment, per RouteMethod
+    int8_t Routes[3];
+};
+
+// The route matching a path and the spans of its captures in the path
+struct RouteMatch {
+    int Route;
+    uint8_t ArgCount;
+    uint16_t ArgStart[HTTP_MAX_PATH_ARGS];
+    uint8_t ArgLength[HTTP_MAX_PATH_ARGS];
+};
+
+/**
+ * @brief Builds the route trie, called once before the first request.
+ *        Patterns are literal segments and the captures {mac} and {pin}, e.g.
+ *        "/pantabox/{mac}/{pin}/api/charger/state".
+ * @param routes The routes, must outlive the router.
+ * @param count Number of routes.
+ * @return false if a pattern is invalid or the routes do not fit ROUTER_MAX_NODES.
+ */
+bool buildRouter(const Route* routes, size_t count);
+
+/**
+ * @brief Finds the route of a request path in one pass over the path, without allocating.
+ *        Can be called from any task once the router is built.
+ * @param method The request method.
+ * @param path The request path without query.
+ * @param length Length of the path.
+ * @param out Receives the route index and the captures.
+ * @return false if no route matches path and method.
+ */
+bool matchRoute(RouteMethod method, const char* path, size_t length, RouteMatch& out);
+
+/**
+ * @brief Copies the captures of a match into the path arguments of its request.
+ * @param request The request.
+ * @param path The path passed to matchRoute.
+ * @param match The match.
+ */
+void setPathArgs(HttpRequest& request, const char* path, const RouteMatch& match);
+
+/**
+ * @brief Returns the number of trie nodes in use.
+ */
+size_t routerNodeCount();
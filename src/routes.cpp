@@ -0,0 +1,25 @@
+#include "routes.h"
+#include "api.h"
+#include "pantabox_api.h"
+
+const Route routes[] = {
+    {ROUTE_GET, "/api/measurements/{mac}", handleMeasurementsRequest, NULL},
+    {ROUTE_GET, "/api/settings/{mac}", handleSettingsRequest, NULL},
+    {ROUTE_GET, "/api/snapshot/{mac}", handleSnapshotRequest, NULL},
+    {ROUTE_GET, "/api/history/{mac}", handleHistoryRequest, NULL},
+    {ROUTE_GET, "/api/stats", handleStatsRequest, NULL},
+    {ROUTE_GET, "/api/devices", handleDevicesRequest, NULL},
+    {ROUTE_GET, "/metrics", handleMetricsRequest, NULL},
+    {ROUTE_GET, "/api/log", handleLogRequest, NULL},
+    {ROUTE_PUT, "/api/priority/{mac}", NULL, handlePriorityRequestPut},
+    {ROUTE_PUT, "/api/settings/{mac}", NULL, handleSettingsRequestPut},
+
+    {ROUTE_GET, "/pantabox/{mac}/{pin}/api/charger/state", handlePantaboxChargerState, NULL},
+    {ROUTE_GET, "/pantabox/{mac}/{pin}/api/charger/enabled", handlePantaboxChargerEnabled, NULL},
+    {ROUTE_GET, "/pantabox/{mac}/{pin}/api/meter/power", handlePantaboxMeterPower, NULL},
+    {ROUTE_GET, "/pantabox/{mac}/{pin}/api/charger/maxcurrent", handlePantaboxChargerMaxCurrent, NULL},
+    {ROUTE_POST, "/pantabox/{mac}/{pin}/api/charger/enable", NULL, handlePantaboxChargerEnableSet},
+    {ROUTE_POST, "/pantabox/{mac}/{pin}/api/charger/current", NULL, handlePantaboxChargerCurrentSet},
+};
+
+const size_t routeCount = sizeof(routes) / sizeof(routes[0]);
@@ -0,0 +1,38 @@
+#pragma once
+#include <Arduino.h>
+
+#include "http_request.h"
+
+enum RouteMethod {
+    ROUTE_GET,
+    ROUTE_PUT,
+    ROUTE_POST
+};
+
+/**
+ * @brief Handles a request without body.
+ * @param request The request.
+ */
+typedef void (*RequestHandler)(HttpRequest *request);
+
+/**
+ * @brief Handles a chunk of a request body.
+ * @param request The request.
+ * @param data The body chunk.
+ * @param len Length of the chunk.
+ * @param index Offset of the chunk in the body.
+ * @param total Total length of the body.
+ */
+typedef void (*BodyHandler)(HttpRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+
+struct Route {
+    RouteMethod Method;
+    // path segments, {mac} and {pin} capture a MAC address and a PIN, see buildRouter
+    const char* Pattern;
+    RequestHandler Handler;
+    BodyHandler Body;
+};
+
+// Routes served by the gateway on all platforms
+extern const Route routes[];
+extern const size_t routeCount;
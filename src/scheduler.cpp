@@ -0,0 +1,181 @@
+#include "scheduler.h"
+#include "snapshot.h"
+
+struct ChargerSchedule {
+    bool Initialized;
+    bool Polled;
+    unsigned long LastPoll;
+    // interval of the CP state before it is scaled by the priority
+    uint32_t StateIntervalMs;
+    SchedulerStats Stats;
+};
+
+static ChargerSchedule schedules[MAX_CHARGERS];
+static portMUX_TYPE schedulerMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t intervalFor(int8_t cpSignal) {
+    switch (cpSignal) {
+        case 2:
+            return SCHED_INTERVAL_CHARGING_MS;
+        case 3:
+            return SCHED_INTERVAL_CONNECTED_MS;
+        default:
+            return SCHED_INTERVAL_IDLE_MS;
+    }
+}
+
+// exponential moving average with a weight of 1/8
+static uint32_t average(uint32_t avg, uint32_t value) {
+    return avg + ((int32_t)(value - avg) / 8);
+}
+
+// Higher priorities poll more often and with a shorter latency budget, the default
+// priority polls with the interval of the CP state
+static void updateSchedule(ChargerSchedule& schedule) {
+    SchedulerStats& stats = schedule.Stats;
+    stats.IntervalMs = schedule.StateIntervalMs * (SCHED_PRIORITY_DEFAULT + 1) / (stats.Priority + 1);
+    stats.BudgetMs = stats.IntervalMs / (stats.Priority + 1);
+}
+
+static ChargerSchedule& scheduleLocked(int slot) {
+    ChargerSchedule& schedule = schedules[slot];
+    if (!schedule.Initialized) {
+        schedule.Initialized = true;
+        schedule.Stats.Priority = SCHED_PRIORITY_DEFAULT;
+        schedule.StateIntervalMs = SCHED_INTERVAL_IDLE_MS;
+        updateSchedule(schedule);
+    }
+    return schedule;
+}
+
+// Released slots are not polled, looked up outside of the scheduler lock
+static int registeredSlots(bool (&registered)[MAX_CHARGERS]) {
+    int count = chargerCount();
+    for (int slot = 0; slot < count; ++slot) {
+        registered[slot] = chargerRegistered(slot);
+    }
+    return count;
+}
+
+int nextChargerDue(unsigned long now, unsigned long& waitMs) {
+    int next = -1;
+    long nextDeadline = 0;
+    // the longest interval, that of an idle charger at priority 0
+    waitMs = SCHED_INTERVAL_IDLE_MS * (SCHED_PRIORITY_DEFAULT + 1);
+    bool registered[MAX_CHARGERS];
+    int count = registeredSlots(registered);
+    portENTER_CRITICAL(&schedulerMux);
+    for (int slot = 0; slot < count; ++slot) {
+        if (!registered[slot]) {
+            continue;
+        }
+        ChargerSchedule& schedule = scheduleLocked(slot);
+        if (!schedule.Polled) {
+            // never polled chargers are due immediately
+            next = slot;
+            break;
+        }
+        long untilDue = (long)(schedule.LastPoll + schedule.Stats.IntervalMs - now);
+        if (untilDue > 0) {
+            waitMs = min(waitMs, (unsigned long)untilDue);
+            continue;
+        }
+        long deadline = untilDue + (long)schedule.Stats.BudgetMs;
+        if (next < 0 || deadline < nextDeadline) {
+            next = slot;
+            nextDeadline = deadline;
+        }
+    }
+    portEXIT_CRITICAL(&schedulerMux);
+    if (next >= 0) {
+        waitMs = 0;
+    }
+    return next;
+}
+
+bool chargerOverdue(unsigned long now) {
+    bool registered[MAX_CHARGERS];
+    int count = registeredSlots(registered);
+    bool overdue = false;
+    portENTER_CRITICAL(&schedulerMux);
+    for (int slot = 0; slot < count && !overdue; ++slot) {
+        if (!registered[slot]) {
+            continue;
+        }
+        ChargerSchedule& schedule = scheduleLocked(slot);
+        unsigned long deadline = schedule.LastPoll + schedule.Stats.IntervalMs + schedule.Stats.BudgetMs;
+        overdue = schedule.Polled && (long)(now - deadline) > 0;
+    }
+    portEXIT_CRITICAL(&schedulerMux);
+    return overdue;
+}
+
+void chargerPolled(int slot, unsigned long start, unsigned long end, int8_t cpSignal) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&schedulerMux);
+    ChargerSchedule& schedule = scheduleLocked(slot);
+    SchedulerStats& stats = schedule.Stats;
+    if (schedule.Polled) {
+        uint32_t refresh = start - schedule.LastPoll;
+        uint32_t due = schedule.LastPoll + stats.IntervalMs;
+        uint32_t wait = (long)(start - due) > 0 ? start - due : 0;
+        if (wait > stats.BudgetMs) {
+            stats.BudgetMisses++;
+        }
+        stats.AvgRefreshMs = stats.AvgRefreshMs == 0 ? refresh : average(stats.AvgRefreshMs, refresh);
+        stats.AvgWaitMs = average(stats.AvgWaitMs, wait);
+        stats.MaxWaitMs = max(stats.MaxWaitMs, wait);
+    }
+    schedule.Polled = true;
+    schedule.LastPoll = start;
+    stats.Polls++;
+    stats.AirtimeMs += end - start;
+    schedule.StateIntervalMs = intervalFor(cpSignal);
+    updateSchedule(schedule);
+    portEXIT_CRITICAL(&schedulerMux);
+}
+
+void jobStarted(int slot, uint32_t waitMs) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&schedulerMux);
+    SchedulerStats& stats = scheduleLocked(slot).Stats;
+    stats.Jobs++;
+    stats.AvgJobWaitMs = average(stats.AvgJobWaitMs, waitMs);
+    stats.MaxJobWaitMs = max(stats.MaxJobWaitMs, waitMs);
+    portEXIT_CRITICAL(&schedulerMux);
+}
+
+bool setChargerPriority(int slot, int priority) {
+    if (slot < 0 || slot >= MAX_CHARGERS || priority < 0 || priority > SCHED_PRIORITY_MAX) {
+        return false;
+    }
+    portENTER_CRITICAL(&schedulerMux);
+    ChargerSchedule& schedule = scheduleLocked(slot);
+    schedule.Stats.Priority = (uint8_t)priority;
+    updateSchedule(schedule);
+    portEXIT_CRITICAL(&schedulerMux);
+    return true;
+}
+
+void releaseSchedule(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&schedulerMux);
+    memset(&schedules[slot], 0, sizeof(schedules[slot]));
+    portEXIT_CRITICAL(&schedulerMux);
+}
+
+bool getSchedulerStats(int slot, SchedulerStats& out) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return false;
+    }
+    portENTER_CRITICAL(&schedulerMux);
+    out = scheduleLocked(slot).Stats;
+    portEXIT_CRITICAL(&schedulerMux);
+    return true;
+}
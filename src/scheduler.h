@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+
+// Poll interval of a charger in CP state C (charging)
+#ifndef SCHED_INTERVAL_CHARGING_MS
+#define SCHED_INTERVAL_CHARGING_MS 1000
+#endif
+
+// Poll interval of a charger in CP state B (vehicle connected)
+#ifndef SCHED_INTERVAL_CONNECTED_MS
+#define SCHED_INTERVAL_CONNECTED_MS 4000
+#endif
+
+// Poll interval of an idle charger
+#ifndef SCHED_INTERVAL_IDLE_MS
+#define SCHED_INTERVAL_IDLE_MS 10000
+#endif
+
+#define SCHED_PRIORITY_DEFAULT 1
+#define SCHED_PRIORITY_MAX 3
+
+struct SchedulerStats {
+    uint8_t Priority;
+    uint32_t IntervalMs;
+    uint32_t BudgetMs;
+    uint32_t Polls;
+    uint32_t BudgetMisses;
+    uint32_t AvgRefreshMs;
+    uint32_t AvgWaitMs;
+    uint32_t MaxWaitMs;
+    uint32_t Jobs;
+    uint32_t AvgJobWaitMs;
+    uint32_t MaxJobWaitMs;
+    uint32_t AirtimeMs;
+};
+
+/**
+ * @brief Selects the charger to poll next. Chargers are polled once their interval elapsed,
+ *        the charger with the earliest deadline (due time plus latency budget) goes first.
+ *        The interval of the CP state is scaled by the priority, priority 3 polls twice as
+ *        often as the default and priority 0 half as often.
+ * @param now Current time in milliseconds.
+ * @param waitMs Receives the time until the next charger is due if none is due now.
+ * @return Slot of the charger to poll or -1 if none is due.
+ */
+int nextChargerDue(unsigned long now, unsigned long& waitMs);
+
+/**
+ * @brief Tells if a charger missed its deadline. The poller then polls it before serving
+ *        more queued jobs, so requests cannot push a charger past its latency budget.
+ * @param now Current time in milliseconds.
+ * @return true if a polled charger is past its due time plus latency budget.
+ */
+bool chargerOverdue(unsigned long now);
+
+/**
+ * @brief Records a finished poll of a charger and adapts its interval to its CP state.
+ * @param slot The charger slot.
+ * @param start Start time of the poll in milliseconds.
+ * @param end End time of the poll in milliseconds.
+ * @param cpSignal The CP signal reported by the charger.
+ */
+void chargerPolled(int slot, unsigned long start, unsigned long end, int8_t cpSignal);
+
+/**
+ * @brief Records the time a BLE job of a charger waited in the queue.
+ * @param slot The charger slot.
+ * @param waitMs Time between queueing and start of the job.
+ */
+void jobStarted(int slot, uint32_t waitMs);
+
+/**
+ * @brief Sets the priority of a charger. Higher priorities shorten the poll interval and the latency budget.
+ * @param slot The charger slot.
+ * @param priority Priority between 0 and SCHED_PRIORITY_MAX.
+ * @return true if the priority is valid, false otherwise.
+ */
+bool setChargerPriority(int slot, int priority);
+
+/**
+ * @brief Resets the schedule, priority and statistics of a released charger slot.
+ * @param slot The charger slot.
+ */
+void releaseSchedule(int slot);
+
+/**
+ * @brief Returns the scheduler statistics of a charger slot.
+ * @param slot The charger slot.
+ * @param out Stats to copy into.
+ * @return true if the slot is valid, false otherwise.
+ */
+bool getSchedulerStats(int slot, SchedulerStats& out);
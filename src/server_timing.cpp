@@ -0,0 +1,72 @@
+#include "server_timing.h"
+#include "response_buffer.h"
+
+static const char* const phaseNames[TIMING_COUNT] = {
+    "lookup", "wait", "connect", "discover", "read-energy", "read-power", "read-voltage-current", "read-info",
+    "decode", "write", "json",
+};
+
+// written and read by the poller task only
+static ServerTiming session;
+
+static void addPhase(ServerTiming& timing, TimingPhase phase, int64_t durationUs) {
+    if (durationUs < 0) {
+        durationUs = 0;
+    }
+    timing.DurationUs[phase] += (uint32_t)min(durationUs, (int64_t)UINT32_MAX);
+    timing.Phases |= 1 << phase;
+}
+
+void startServerTiming(ServerTiming& timing, int64_t now) {
+    memset(&timing, 0, sizeof(timing));
+    timing.Start = now;
+    timing.Mark = now;
+}
+
+void endTimingPhase(ServerTiming& timing, TimingPhase phase) {
+    int64_t now = esp_timer_get_time();
+    addPhase(timing, phase, now - timing.Mark);
+    timing.Mark = now;
+}
+
+void addSessionTiming(ServerTiming& timing) {
+    addPhase(timing, TIMING_WAIT, session.Start - timing.Mark);
+    for (int phase = 0; phase < TIMING_COUNT; ++phase) {
+        if (session.Phases & (1 << phase)) {
+            addPhase(timing, (TimingPhase)phase, session.DurationUs[phase]);
+        }
+    }
+    timing.Mark = esp_timer_get_time();
+}
+
+// entries are appended as a whole, once one does not fit the rest is dropped
+static void appendEntry(ResponseBuffer& out, const char* name, int64_t durationUs) {
+    char storage[40];
+    ResponseBuffer entry(storage, sizeof(storage));
+    if (out.length() > 0) {
+        entry.append(',');
+    }
+    entry.append(name);
+    entry.append(";dur=");
+    entry.appendFixed(durationUs, 3);
+    out.append(entry.c_str(), entry.length());
+}
+
+void formatServerTiming(const ServerTiming& timing, char* out, size_t size) {
+    ResponseBuffer value(out, size);
+    // the total first, it explains the phases that do not fit
+    appendEntry(value, "total", esp_timer_get_time() - timing.Start);
+    for (int phase = 0; phase < TIMING_COUNT; ++phase) {
+        if (timing.Phases & (1 << phase)) {
+            appendEntry(value, phaseNames[phase], timing.DurationUs[phase]);
+        }
+    }
+}
+
+void beginSessionTiming() {
+    startServerTiming(session, esp_timer_get_time());
+}
+
+void recordSessionPhase(TimingPhase phase, int64_t durationUs) {
+    addPhase(session, phase, durationUs);
+}
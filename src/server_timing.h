@@ -0,0 +1,99 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Set to 0 to compile the Server-Timing headers and their measurements out
+#ifndef SERVER_TIMING_ENABLED
+#define SERVER_TIMING_ENABLED 1
+#endif
+
+// Phases of a request reported in its Server-Timing header
+enum TimingPhase {
+    // handler until the response or the deferral, e.g. snapshot and registry lookups
+    TIMING_LOOKUP,
+    // deferral until the BLE session started
+    TIMING_WAIT,
+    TIMING_CONNECT,
+    TIMING_DISCOVER,
+    TIMING_READ_ENERGY,
+    TIMING_READ_POWER,
+    TIMING_READ_VOLTAGE_CURRENT,
+    TIMING_READ_INFO,
+    // converting and storing the read values
+    TIMING_DECODE,
+    TIMING_WRITE,
+    TIMING_JSON,
+    TIMING_COUNT
+};
+
+// The read of the characteristic holding a SnapshotPart
+#define TIMING_READ(part) ((TimingPhase)(TIMING_READ_ENERGY + (part)))
+
+struct ServerTiming {
+    // when the request was received and when the last phase ended, in microseconds
+    int64_t Start;
+    int64_t Mark;
+    uint32_t DurationUs[TIMING_COUNT];
+    // bitmask of the recorded phases
+    uint16_t Phases;
+};
+
+/**
+ * @brief Starts the timing of a request.
+ * @param timing The timing.
+ * @param now Time the request was received.
+ */
+void startServerTiming(ServerTiming& timing, int64_t now);
+
+/**
+ * @brief Records the time since the previous phase ended as duration of a phase.
+ * @param timing The timing of the request.
+ * @param phase The phase that ended now.
+ */
+void endTimingPhase(ServerTiming& timing, TimingPhase phase);
+
+/**
+ * @brief Records the BLE session the poller task just finished for a deferred request:
+ *        the wait until the session started and the phases of the session.
+ * @param timing The timing of the request.
+ */
+void addSessionTiming(ServerTiming& timing);
+
+/**
+ * @brief Formats the Server-Timing header value, durations in milliseconds. Phases that
+ *        do not fit are left out.
+ * @param timing The timing of the request.
+ * @param out Receives the value.
+ * @param size Size of out.
+ */
+void formatServerTiming(const ServerTiming& timing, char* out, size_t size);
+
+/**
+ * @brief Starts recording the phases of a BLE session. Only called by the poller task.
+ */
+void beginSessionTiming();
+
+/**
+ * @brief Adds to a phase of the BLE session. Only called by the poller task.
+ * @param phase The phase.
+ * @param durationUs The duration in microseconds.
+ */
+void recordSessionPhase(TimingPhase phase, int64_t durationUs);
+
+#if SERVER_TIMING_ENABLED
+#define TIMING_START(name) int64_t name = esp_timer_get_time()
+#define SESSION_TIMING_BEGIN() beginSessionTiming()
+#define SESSION_TIMING(phase, durationUs) recordSessionPhase(phase, durationUs)
+#define SESSION_TIMING_SINCE(phase, start) recordSessionPhase(phase, esp_timer_get_time() - (start))
+#define REQUEST_TIMING_PHASE(request, phase) endTimingPhase((request)->timing(), phase)
+#define REQUEST_TIMING_SESSION(request) addSessionTiming((request)->timing())
+#define REQUEST_TIMING_HEADER(request) (request)->addServerTimingHeader()
+#else
+#define TIMING_START(name)
+#define SESSION_TIMING_BEGIN()
+#define SESSION_TIMING(phase, durationUs)
+#define SESSION_TIMING_SINCE(phase, start)
+#define REQUEST_TIMING_PHASE(request, phase)
+#define REQUEST_TIMING_SESSION(request)
+#define REQUEST_TIMING_HEADER(request)
+#endif
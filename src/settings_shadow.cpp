@@ -0,0 +1,180 @@
+#include "settings_shadow.h"
+#include "snapshot.h"
+
+struct SettingsShadow {
+    bool Pending;
+    unsigned long FirstChange;
+    PendingSettings Write;
+    // taken by the poller task and not yet finished
+    bool InFlight;
+    bool Unconfirmed;
+    SettingsChange Expected;
+    // the last write changed a value, so its confirmation proves its PIN
+    bool ExpectedChanges;
+    // PIN of the last write the charger applied
+    bool PinVerified;
+    uint16_t VerifiedPin;
+    SettingsStats Stats;
+};
+
+static SettingsShadow shadows[MAX_CHARGERS];
+static portMUX_TYPE shadowMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool matches(const SettingsChange& change, const Info& info) {
+    return (change.PauseCharging < 0 || change.PauseCharging == info.PauseCharging) &&
+        (change.Current < 0 || change.Current == info.Current);
+}
+
+bool settingsUnchanged(int slot, const SettingsChange& change) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return false;
+    }
+    ChargerSnapshot snapshot;
+    int64_t age;
+    bool known = loadSnapshot(slot, PART_BIT(PART_INFO), snapshot, age);
+
+    portENTER_CRITICAL(&shadowMux);
+    SettingsShadow& shadow = shadows[slot];
+    // a pending or running write may still change the values, so nothing is suppressed meanwhile.
+    // Only a PIN the charger accepted before is answered without writing, a wrong one must fail,
+    // and unconfirmed values in the snapshot only count if they were written with that PIN.
+    bool verified = shadow.PinVerified && shadow.VerifiedPin == change.Pin &&
+        (!shadow.Unconfirmed || shadow.Expected.Pin == change.Pin);
+    bool unchanged = known && !shadow.Pending && !shadow.InFlight && verified && matches(change, snapshot.InfoData);
+    shadow.Stats.Requests++;
+    if (unchanged) {
+        shadow.Stats.Suppressed++;
+    }
+    portEXIT_CRITICAL(&shadowMux);
+    return unchanged;
+}
+
+SettingsQueueStatus queueSettingsChange(int slot, const SettingsChange& change, BleJobCallback callback, void* context) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return SETTINGS_BUSY;
+    }
+    SettingsQueueStatus status = SETTINGS_BUSY;
+    portENTER_CRITICAL(&shadowMux);
+    SettingsShadow& shadow = shadows[slot];
+    PendingSettings& write = shadow.Write;
+    // the frame is written with one PIN, changes authorized by another one are not merged into it
+    if (shadow.Pending && write.Change.Pin != change.Pin) {
+        portEXIT_CRITICAL(&shadowMux);
+        return SETTINGS_CONFLICT;
+    }
+    if (!shadow.Pending) {
+        shadow.Pending = true;
+        shadow.FirstChange = millis();
+        write.Change = {change.Pin, -1, -1};
+        write.Waiters = 0;
+    } else {
+        shadow.Stats.Coalesced++;
+    }
+    if (write.Waiters < MAX_SETTINGS_WAITERS) {
+        if (change.PauseCharging >= 0) {
+            write.Change.PauseCharging = change.PauseCharging;
+        }
+        if (change.Current >= 0) {
+            write.Change.Current = change.Current;
+        }
+        write.Callbacks[write.Waiters] = callback;
+        write.Contexts[write.Waiters] = context;
+        write.Waiters++;
+        status = SETTINGS_QUEUED;
+    }
+    portEXIT_CRITICAL(&shadowMux);
+    return status;
+}
+
+bool takeDueSettings(unsigned long now, int& slot, PendingSettings& out) {
+    bool found = false;
+    portENTER_CRITICAL(&shadowMux);
+    for (int i = 0; i < MAX_CHARGERS; ++i) {
+        SettingsShadow& shadow = shadows[i];
+        if (shadow.Pending && now - shadow.FirstChange >= SETTINGS_COALESCE_MS) {
+            shadow.Pending = false;
+            shadow.InFlight = true;
+            slot = i;
+            out = shadow.Write;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&shadowMux);
+    return found;
+}
+
+void settingsWritten(int slot, const SettingsChange& change, const char* error) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    ChargerSnapshot snapshot;
+    bool known = copySnapshot(slot, snapshot) && (snapshot.Valid & PART_BIT(PART_INFO));
+    portENTER_CRITICAL(&shadowMux);
+    SettingsShadow& shadow = shadows[slot];
+    shadow.InFlight = false;
+    if (!error) {
+        shadow.Stats.Writes++;
+        shadow.Unconfirmed = true;
+        shadow.Expected = change;
+        shadow.ExpectedChanges = known && !matches(change, snapshot.InfoData);
+    }
+    portEXIT_CRITICAL(&shadowMux);
+
+    // serve the written values until the charger reports its actual settings
+    if (!error && known) {
+        Info info = snapshot.InfoData;
+        if (change.PauseCharging >= 0) {
+            info.PauseCharging = change.PauseCharging;
+        }
+        if (change.Current >= 0) {
+            info.Current = change.Current;
+        }
+        patchSnapshot(slot, info);
+    }
+}
+
+void confirmSettings(int slot, const Info& info) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&shadowMux);
+    SettingsShadow& shadow = shadows[slot];
+    if (shadow.Unconfirmed) {
+        shadow.Unconfirmed = false;
+        if (matches(shadow.Expected, info)) {
+            shadow.Stats.Confirmed++;
+            if (shadow.ExpectedChanges) {
+                shadow.PinVerified = true;
+                shadow.VerifiedPin = shadow.Expected.Pin;
+            }
+        } else {
+            shadow.Stats.Mismatched++;
+        }
+    }
+    portEXIT_CRITICAL(&shadowMux);
+}
+
+bool releaseSettings(int slot) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return false;
+    }
+    portENTER_CRITICAL(&shadowMux);
+    SettingsShadow& shadow = shadows[slot];
+    bool idle = !shadow.Pending && !shadow.InFlight;
+    if (idle) {
+        memset(&shadow, 0, sizeof(shadow));
+    }
+    portEXIT_CRITICAL(&shadowMux);
+    return idle;
+}
+
+bool getSettingsStats(int slot, SettingsStats& out) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return false;
+    }
+    portENTER_CRITICAL(&shadowMux);
+    out = shadows[slot].Stats;
+    portEXIT_CRITICAL(&shadowMux);
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <Arduino.h>
+
+#include "ble_poller.h"
+#include "ble_utils.h"
+
+// Changes of the same charger arriving within this window are written together
+#ifndef SETTINGS_COALESCE_MS
+#define SETTINGS_COALESCE_MS 300
+#endif
+
+// Maximum number of requests waiting for the same settings write
+#ifndef MAX_SETTINGS_WAITERS
+#define MAX_SETTINGS_WAITERS 8
+#endif
+
+// Settings to change, negative values keep the current value
+struct SettingsChange {
+    uint16_t Pin;
+    int8_t PauseCharging;
+    int8_t Current;
+};
+
+enum SettingsQueueStatus {
+    SETTINGS_QUEUED,
+    // too many requests are already waiting for the pending write
+    SETTINGS_BUSY,
+    // a change with another PIN is pending
+    SETTINGS_CONFLICT
+};
+
+// A merged settings change and the requests waiting for it
+struct PendingSettings {
+    SettingsChange Change;
+    uint8_t Waiters;
+    BleJobCallback Callbacks[MAX_SETTINGS_WAITERS];
+    void* Contexts[MAX_SETTINGS_WAITERS];
+};
+
+struct SettingsStats {
+    uint32_t Requests;
+    uint32_t Suppressed;
+    uint32_t Coalesced;
+    uint32_t Writes;
+    uint32_t Confirmed;
+    uint32_t Mismatched;
+};
+
+/**
+ * @brief Checks whether a change would not modify the last known settings of a charger.
+ *        Nothing is skipped while a write is pending or running, or if the charger did
+ *        not apply an earlier write with the PIN of the change.
+ * @param slot The charger slot.
+ * @param change The settings to change.
+ * @return true if the write can be skipped.
+ */
+bool settingsUnchanged(int slot, const SettingsChange& change);
+
+/**
+ * @brief Merges a change into the pending settings write of a charger.
+ *        The write is executed SETTINGS_COALESCE_MS after the first change.
+ *        Only changes with the same PIN are merged.
+ * @param slot The charger slot.
+ * @param change The settings to change.
+ * @param callback Called from the poller task once the write finished.
+ * @param context Passed to the callback.
+ * @return SETTINGS_QUEUED if the change was merged, otherwise the callback is not called.
+ */
+SettingsQueueStatus queueSettingsChange(int slot, const SettingsChange& change, BleJobCallback callback, void* context);
+
+/**
+ * @brief Takes a pending settings write whose coalescing window elapsed.
+ * @param now Current time in milliseconds.
+ * @param slot Receives the charger slot.
+ * @param out Receives the merged change and its waiters.
+ * @return true if a write is due.
+ */
+bool takeDueSettings(unsigned long now, int& slot, PendingSettings& out);
+
+/**
+ * @brief Records a finished write, failed or not. On success the written values are applied to
+ *        the snapshot and confirmed by the next Info value read from the charger, which verifies
+ *        the PIN if the write changed a value.
+ * @param slot The charger slot.
+ * @param change The written change.
+ * @param error Error message or NULL on success.
+ */
+void settingsWritten(int slot, const SettingsChange& change, const char* error);
+
+/**
+ * @brief Compares a freshly read Info value with the last written settings.
+ * @param slot The charger slot.
+ * @param info The Info value read from the charger.
+ */
+void confirmSettings(int slot, const Info& info);
+
+/**
+ * @brief Resets the shadow of a charger slot that is released, including its verified PIN.
+ * @param slot The charger slot.
+ * @return false if a write is pending or running, the shadow is kept in this case.
+ */
+bool releaseSettings(int slot);
+
+/**
+ * @brief Returns the settings statistics of a charger slot.
+ * @param slot The charger slot.
+ * @param out Stats to copy into.
+ * @return true if the slot is valid, false otherwise.
+ */
+bool getSettingsStats(int slot, SettingsStats& out);
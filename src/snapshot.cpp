@@ -0,0 +1,217 @@
+#include <esp_timer.h>
+
+#include "snapshot.h"
+
+static ChargerSnapshot snapshots[MAX_CHARGERS];
+static int snapshotCount = 0;
+static portMUX_TYPE snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+
+int64_t snapshotNow() {
+    return esp_timer_get_time();
+}
+
+static bool usedLocked(int slot) {
+    return slot >= 0 && slot < snapshotCount && snapshots[slot].Address[0] != 0;
+}
+
+static int findSlotLocked(const char* address) {
+    for (int i = 0; i < snapshotCount; ++i) {
+        if (usedLocked(i) && strcasecmp(snapshots[i].Address, address) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int findCharger(const char* address) {
+    portENTER_CRITICAL(&snapshotMux);
+    int slot = findSlotLocked(address);
+    portEXIT_CRITICAL(&snapshotMux);
+    return slot;
+}
+
+int registerCharger(const char* address) {
+    if (address[0] == 0 || strlen(address) >= sizeof(snapshots[0].Address)) {
+        return -1;
+    }
+    int64_t now = snapshotNow();
+    portENTER_CRITICAL(&snapshotMux);
+    int slot = findSlotLocked(address);
+    if (slot < 0) {
+        // released slots are reused before a new one is taken
+        for (int i = 0; i < MAX_CHARGERS; ++i) {
+            if (!usedLocked(i)) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot >= 0) {
+            ChargerSnapshot& snapshot = snapshots[slot];
+            memset(&snapshot, 0, sizeof(snapshot));
+            strcpy(snapshot.Address, address);
+            strcpy(snapshot.Error, "no data yet");
+            snapshot.RegisteredAt = now;
+            snapshotCount = max(snapshotCount, slot + 1);
+        }
+    }
+    if (slot >= 0) {
+        snapshots[slot].RequestedAt = now;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+    return slot;
+}
+
+void touchCharger(int slot) {
+    int64_t now = snapshotNow();
+    portENTER_CRITICAL(&snapshotMux);
+    if (usedLocked(slot)) {
+        snapshots[slot].RequestedAt = now;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+bool releaseCharger(int slot, int64_t requestedAt) {
+    bool released = false;
+    portENTER_CRITICAL(&snapshotMux);
+    if (usedLocked(slot) && snapshots[slot].RequestedAt == requestedAt) {
+        memset(&snapshots[slot], 0, sizeof(snapshots[slot]));
+        while (snapshotCount > 0 && !usedLocked(snapshotCount - 1)) {
+            snapshotCount--;
+        }
+        released = true;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+    return released;
+}
+
+bool chargerRegistered(int slot) {
+    portENTER_CRITICAL(&snapshotMux);
+    bool used = usedLocked(slot);
+    portEXIT_CRITICAL(&snapshotMux);
+    return used;
+}
+
+int chargerCount() {
+    portENTER_CRITICAL(&snapshotMux);
+    int count = snapshotCount;
+    portEXIT_CRITICAL(&snapshotMux);
+    return count;
+}
+
+bool copySnapshot(int slot, ChargerSnapshot& out) {
+    bool found = false;
+    portENTER_CRITICAL(&snapshotMux);
+    if (usedLocked(slot)) {
+        out = snapshots[slot];
+        found = true;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+    return found;
+}
+
+template <typename T>
+static void storePart(int slot, SnapshotPart part, T ChargerSnapshot::*field, const T& value) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    int64_t now = snapshotNow();
+    portENTER_CRITICAL(&snapshotMux);
+    ChargerSnapshot& snapshot = snapshots[slot];
+    snapshot.*field = value;
+    snapshot.ReadAt[part] = now;
+    snapshot.Valid |= PART_BIT(part);
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+void storeSnapshot(int slot, const Energy& value, const PhaseEnergy& phases) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    int64_t now = snapshotNow();
+    portENTER_CRITICAL(&snapshotMux);
+    ChargerSnapshot& snapshot = snapshots[slot];
+    snapshot.EnergyData = value;
+    snapshot.PhaseEnergyData = phases;
+    snapshot.ReadAt[PART_ENERGY] = now;
+    snapshot.Valid |= PART_BIT(PART_ENERGY);
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+void storeSnapshot(int slot, const Power& value) {
+    storePart(slot, PART_POWER, &ChargerSnapshot::PowerData, value);
+}
+
+void storeSnapshot(int slot, const VoltageCurrent& value) {
+    storePart(slot, PART_VOLTAGE_CURRENT, &ChargerSnapshot::VoltageCurrentData, value);
+}
+
+void storeSnapshot(int slot, const Info& value) {
+    storePart(slot, PART_INFO, &ChargerSnapshot::InfoData, value);
+}
+
+void patchSnapshot(int slot, const Info& value) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&snapshotMux);
+    snapshots[slot].InfoData = value;
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+void setSnapshotError(int slot, const char* error) {
+    if (slot < 0 || slot >= MAX_CHARGERS) {
+        return;
+    }
+    portENTER_CRITICAL(&snapshotMux);
+    strlcpy(snapshots[slot].Error, error, sizeof(snapshots[slot].Error));
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+int64_t snapshotAge(const ChargerSnapshot& snapshot, uint8_t parts, int64_t now) {
+    if ((snapshot.Valid & parts) != parts) {
+        return -1;
+    }
+    int64_t oldest = now;
+    for (int part = 0; part < PART_COUNT; ++part) {
+        if ((parts & PART_BIT(part)) && snapshot.ReadAt[part] < oldest) {
+            oldest = snapshot.ReadAt[part];
+        }
+    }
+    return now - oldest;
+}
+
+uint8_t staleParts(const ChargerSnapshot& snapshot, uint8_t parts, int64_t now) {
+    uint8_t stale = 0;
+    for (int part = 0; part < PART_COUNT; ++part) {
+        if (!(parts & PART_BIT(part))) {
+            continue;
+        }
+        if (!(snapshot.Valid & PART_BIT(part)) || now - snapshot.ReadAt[part] > SNAPSHOT_REFRESH_AGE_US) {
+            stale |= PART_BIT(part);
+        }
+    }
+    return stale;
+}
+
+bool loadSnapshot(int slot, uint8_t parts, ChargerSnapshot& out, int64_t& age) {
+    age = -1;
+    if (!copySnapshot(slot, out)) {
+        strcpy(out.Error, "too many chargers");
+        return false;
+    }
+    age = snapshotAge(out, parts, snapshotNow());
+    if (age < 0) {
+        if (out.Error[0] == 0) {
+            strcpy(out.Error, "no data yet");
+        }
+        return false;
+    }
+    if (age > SNAPSHOT_MAX_AGE_US) {
+        if (out.Error[0] == 0) {
+            strcpy(out.Error, "data outdated");
+        }
+        return false;
+    }
+    out.Error[0] = 0;
+    return true;
+}
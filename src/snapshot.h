@@ -0,0 +1,193 @@
+#pragma once
+#include <Arduino.h>
+
+#include "ble_utils.h"
+
+// Number of chargers that can be polled in parallel
+#ifndef MAX_CHARGERS
+#define MAX_CHARGERS 4
+#endif
+
+// Snapshots older than this are refreshed on request (in microseconds)
+#ifndef SNAPSHOT_REFRESH_AGE_US
+#define SNAPSHOT_REFRESH_AGE_US (15LL * 1000000LL)
+#endif
+
+// Snapshots older than this are no longer served (in microseconds)
+#ifndef SNAPSHOT_MAX_AGE_US
+#define SNAPSHOT_MAX_AGE_US (60LL * 1000000LL)
+#endif
+
+// Chargers nobody requested for this time are released (in microseconds)
+#ifndef CHARGER_IDLE_EXPIRY_US
+#define CHARGER_IDLE_EXPIRY_US (3600LL * 1000000LL)
+#endif
+
+// Chargers that were not read for this time and are no longer seen by the registry
+// are released (in microseconds)
+#ifndef CHARGER_UNREACHABLE_EXPIRY_US
+#define CHARGER_UNREACHABLE_EXPIRY_US (600LL * 1000000LL)
+#endif
+
+// Characteristics held in a snapshot
+enum SnapshotPart {
+    PART_ENERGY = 0,
+    PART_POWER,
+    PART_VOLTAGE_CURRENT,
+    PART_INFO,
+    PART_COUNT
+};
+
+#define PART_BIT(part) (1 << (part))
+#define PARTS_ALL (PART_BIT(PART_COUNT) - 1)
+
+// Energy per phase of the current charging session in Wh, integrated from the Power
+// samples and scaled to the EnergyLastCharge it is stored with
+struct PhaseEnergy {
+    uint32_t L1;
+    uint32_t L2;
+    uint32_t L3;
+};
+
+struct ChargerSnapshot {
+    char Address[18];
+    char Error[50];
+    uint8_t Valid;
+    int64_t ReadAt[PART_COUNT];
+    // when the slot was taken and when a client last asked for the charger
+    int64_t RegisteredAt;
+    int64_t RequestedAt;
+    Energy EnergyData;
+    // part of the Energy characteristic, not read from the charger
+    PhaseEnergy PhaseEnergyData;
+    Power PowerData;
+    VoltageCurrent VoltageCurrentData;
+    Info InfoData;
+};
+
+/**
+ * @brief Returns the current time used for snapshot timestamps.
+ * @return Microseconds since boot.
+ */
+int64_t snapshotNow();
+
+/**
+ * @brief Finds the slot of a registered charger.
+ * @param address The MAC address of the charger.
+ * @return Slot index or -1 if the charger is not registered.
+ */
+int findCharger(const char* address);
+
+/**
+ * @brief Registers a charger for background polling, or marks a registered one as requested.
+ *        Only devices the registry has seen should be registered, a slot is kept until
+ *        the charger is released.
+ * @param address The MAC address of the charger.
+ * @return Slot index or -1 if all slots are in use.
+ */
+int registerCharger(const char* address);
+
+/**
+ * @brief Marks a registered charger as requested, e.g. by a Modbus client.
+ * @param slot The charger slot.
+ */
+void touchCharger(int slot);
+
+/**
+ * @brief Frees the slot of a charger unless it was requested again meanwhile.
+ *        Only called by the poller task, after the state of the slot was reset.
+ * @param slot The charger slot.
+ * @param requestedAt RequestedAt of the snapshot the decision was based on.
+ * @return true if the slot was freed.
+ */
+bool releaseCharger(int slot, int64_t requestedAt);
+
+/**
+ * @brief Returns the number of slots to iterate, released slots below it may be free.
+ * @return One past the highest slot in use.
+ */
+int chargerCount();
+
+/**
+ * @brief Returns whether a slot holds a registered charger.
+ * @param slot The charger slot.
+ * @return true if the slot is in use.
+ */
+bool chargerRegistered(int slot);
+
+/**
+ * @brief Copies the snapshot of a charger slot.
+ * @param slot The charger slot.
+ * @param out Snapshot to copy into.
+ * @return true if the slot is in use, false otherwise.
+ */
+bool copySnapshot(int slot, ChargerSnapshot& out);
+
+/**
+ * @brief Stores the decoded Energy value and the energy per phase derived from it.
+ * @param slot The charger slot.
+ * @param value The decoded value.
+ * @param phases The energy per phase of the session in value.
+ */
+void storeSnapshot(int slot, const Energy& value, const PhaseEnergy& phases);
+
+/**
+ * @brief Stores decoded characteristic values in the snapshot of a charger slot.
+ * @param slot The charger slot.
+ * @param value The decoded value.
+ */
+void storeSnapshot(int slot, const Power& value);
+void storeSnapshot(int slot, const VoltageCurrent& value);
+void storeSnapshot(int slot, const Info& value);
+
+/**
+ * @brief Replaces the Info value of a charger slot without updating its read timestamp.
+ *        Used to serve written settings until the charger reports them.
+ * @param slot The charger slot.
+ * @param value The expected value.
+ */
+void patchSnapshot(int slot, const Info& value);
+
+/**
+ * @brief Sets the error of the last poll of a charger slot.
+ * @param slot The charger slot.
+ * @param error The error message or an empty string on success.
+ */
+void setSnapshotError(int slot, const char* error);
+
+/**
+ * @brief Returns the age of the oldest of the given parts of a snapshot.
+ * @param snapshot The snapshot.
+ * @param parts Bitmask of SnapshotPart bits.
+ * @param now Current time from snapshotNow().
+ * @return Age in microseconds or -1 if a part was never read.
+ */
+int64_t snapshotAge(const ChargerSnapshot& snapshot, uint8_t parts, int64_t now);
+
+/**
+ * @brief Returns the given parts that are missing or older than SNAPSHOT_REFRESH_AGE_US.
+ * @param snapshot The snapshot.
+ * @param parts Bitmask of SnapshotPart bits.
+ * @param now Current time from snapshotNow().
+ * @return Bitmask of the parts that need a refresh.
+ */
+uint8_t staleParts(const ChargerSnapshot& snapshot, uint8_t parts, int64_t now);
+
+/**
+ * @brief Loads the snapshot of a charger slot and checks the required parts.
+ * @param slot The charger slot, as returned by registerCharger.
+ * @param parts Bitmask of SnapshotPart bits that are required.
+ * @param out Snapshot to copy into, Error is set on failure.
+ * @param age Age of the required parts in microseconds.
+ * @return true if all required parts are available and not outdated.
+ */
+bool loadSnapshot(int slot, uint8_t parts, ChargerSnapshot& out, int64_t& age);
+
+/**
+ * @brief Returns whether a snapshot of the given age should be refreshed before it is served.
+ * @param age Age as returned by loadSnapshot.
+ * @return true if the snapshot is missing or older than SNAPSHOT_REFRESH_AGE_US.
+ */
+inline bool snapshotNeedsRefresh(int64_t age) {
+    return age < 0 || age > SNAPSHOT_REFRESH_AGE_US;
+}
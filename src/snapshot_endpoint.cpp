@@ -0,0 +1,130 @@
+#include "snapshot_endpoint.h"
+#include "api.h"
+#include "log.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "server_timing.h"
+
+// A quoted 32 bit hash and the terminator
+#define ETAG_SIZE 11
+
+EndpointValues::EndpointValues(const ChargerSnapshot& snapshot, const SnapshotFieldId* fields, size_t count)
+    : snapshot(snapshot), fields(fields), count(count) {
+}
+
+int64_t EndpointValues::get(SnapshotFieldId field) const {
+    // undeclared fields would not be refreshed, so they are never served
+    for (size_t i = 0; i < count; ++i) {
+        if (fields[i] == field) {
+            return readSnapshotField(snapshot, snapshotFields[field]);
+        }
+    }
+    return 0;
+}
+
+PhaseEnergy EndpointValues::phaseEnergy() const {
+    // the phases split EnergyLastCharge and are only as fresh as it
+    for (size_t i = 0; i < count; ++i) {
+        if (fields[i] == FIELD_ENERGY_LAST_CHARGE) {
+            return snapshot.PhaseEnergyData;
+        }
+    }
+    PhaseEnergy none = {0, 0, 0};
+    return none;
+}
+
+uint8_t endpointParts(const SnapshotEndpoint& endpoint) {
+    return snapshotFieldParts(endpoint.Fields, endpoint.FieldCount);
+}
+
+static uint32_t hashValue(uint32_t hash, uint64_t value) {
+    for (int byte = 0; byte < 8; ++byte) {
+        hash = (hash ^ (uint8_t)(value >> (byte * 8))) * 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over the declared field values and the phase energy served with them,
+// the body is rendered from nothing else
+static void formatEtag(const ChargerSnapshot& snapshot, const SnapshotEndpoint& endpoint, char* etag) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < endpoint.FieldCount; ++i) {
+        hash = hashValue(hash, (uint64_t)readSnapshotField(snapshot, snapshotFields[endpoint.Fields[i]]));
+        if (endpoint.Fields[i] == FIELD_ENERGY_LAST_CHARGE) {
+            const PhaseEnergy& phases = snapshot.PhaseEnergyData;
+            hash = hashValue(hashValue(hashValue(hash, phases.L1), phases.L2), phases.L3);
+        }
+    }
+    snprintf(etag, ETAG_SIZE, "\"%08lx\"", (unsigned long)hash);
+}
+
+// If-None-Match holds "*" or a list of entity tags, weak ones match as well
+static bool etagListed(const char* list, const char* etag) {
+    size_t length = strlen(etag);
+    const char* tag = list;
+    while (*tag) {
+        tag += strspn(tag, " \t,");
+        if (*tag == '*') {
+            return true;
+        }
+        if (strncmp(tag, "W/", 2) == 0) {
+            tag += 2;
+        }
+        if (strncmp(tag, etag, length) == 0 && strchr(" \t,", tag[length])) {
+            return true;
+        }
+        tag += strcspn(tag, ",");
+    }
+    return false;
+}
+
+// Seconds until the poller reads the charger again
+static uint32_t maxAgeS(const ChargerSnapshot& snapshot, int64_t age) {
+    SchedulerStats stats;
+    int slot = findCharger(snapshot.Address);
+    if (age < 0 || slot < 0 || !getSchedulerStats(slot, stats)) {
+        return 0;
+    }
+    int64_t remainingUs = (int64_t)stats.IntervalMs * 1000 - age;
+    return remainingUs > 0 ? remainingUs / 1000000 : 0;
+}
+
+static void respondEndpoint(HttpRequest *request, const ChargerSnapshot& snapshot, int64_t age, const void* context) {
+    const SnapshotEndpoint& endpoint = *(const SnapshotEndpoint*)context;
+    StaticResponseBuffer<> json;
+    if (snapshot.Error[0] != 0) {
+        LOG_ERROR("request failed", snapshot.Error);
+        countHttpError(snapshot.Error);
+        json.append("{\"");
+        json.append(endpoint.ErrorKey);
+        json.append("\":");
+        json.appendJsonString(snapshot.Error);
+        json.append('}');
+        REQUEST_TIMING_PHASE(request, TIMING_JSON);
+        sendSnapshotJson(request, endpoint.ErrorCode, json, age);
+        return;
+    }
+    if (endpoint.Cacheable) {
+        char etag[ETAG_SIZE];
+        char cacheControl[24];
+        formatEtag(snapshot, endpoint, etag);
+        snprintf(cacheControl, sizeof(cacheControl), "max-age=%lu", (unsigned long)maxAgeS(snapshot, age));
+        request->addHeader("ETag", etag);
+        request->addHeader("Cache-Control", cacheControl);
+        bool hit = etagListed(request->header("If-None-Match").c_str(), etag);
+        recordHttpCache(request->route(), hit);
+        if (hit) {
+            sendSnapshotJson(request, 304, json, age);
+            return;
+        }
+    }
+    endpoint.Render(EndpointValues(snapshot, endpoint.Fields, endpoint.FieldCount), json);
+    REQUEST_TIMING_PHASE(request, TIMING_JSON);
+    sendSnapshotJson(request, 200, json, age);
+}
+
+void serveEndpoint(HttpRequest *request, const SnapshotEndpoint& endpoint) {
+    // endpoint names are string literals, they can be stored as message
+    LOG_INFO(endpoint.Name, request->pathArg(0));
+    serveSnapshot(request, endpointParts(endpoint), respondEndpoint, &endpoint);
+}
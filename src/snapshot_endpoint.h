@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+
+#include "http_request.h"
+#include "response_buffer.h"
+#include "snapshot_fields.h"
+
+/**
+ * Values of the fields an endpoint declared, read from one snapshot.
+ */
+class EndpointValues {
+public:
+    EndpointValues(const ChargerSnapshot& snapshot, const SnapshotFieldId* fields, size_t count);
+
+    /**
+     * @brief Returns the value of a field.
+     * @param field The field, must be declared by the endpoint.
+     * @return The value or 0 if the endpoint did not declare the field.
+     */
+    int64_t get(SnapshotFieldId field) const;
+
+    /**
+     * @brief Returns the energy per phase stored with the Energy characteristic.
+     * @return The energy in Wh, 0 if the endpoint did not declare FIELD_ENERGY_LAST_CHARGE.
+     */
+    PhaseEnergy phaseEnergy() const;
+
+private:
+    const ChargerSnapshot& snapshot;
+    const SnapshotFieldId* fields;
+    size_t count;
+};
+
+/**
+ * @brief Writes the JSON body of an endpoint.
+ * @param values The values of the declared fields.
+ * @param json Buffer to write the body to.
+ */
+typedef void (*EndpointRenderer)(const EndpointValues& values, ResponseBuffer& json);
+
+// A GET endpoint served from the snapshot of the charger in path argument 0.
+// The declared fields determine which characteristics are read.
+struct SnapshotEndpoint {
+    // used in the request log, e.g. "pantabox state"
+    const char* Name;
+    const SnapshotFieldId* Fields;
+    size_t FieldCount;
+    EndpointRenderer Render;
+    // status code and key of the {"<ErrorKey>":"<error>"} body sent if the snapshot is not usable
+    int ErrorCode;
+    const char* ErrorKey;
+    // responses carry an ETag of the field values and a Cache-Control max-age until the next poll,
+    // a matching If-None-Match is answered with 304 without rendering the body
+    bool Cacheable;
+};
+
+// Expands to the Fields and FieldCount members of a SnapshotEndpoint
+#define ENDPOINT_FIELDS(fields) fields, sizeof(fields) / sizeof(fields[0])
+
+/**
+ * @brief Returns the characteristics an endpoint needs.
+ * @param endpoint The endpoint.
+ * @return Bitmask of the SnapshotPart bits holding the declared fields.
+ */
+uint8_t endpointParts(const SnapshotEndpoint& endpoint);
+
+/**
+ * @brief Serves a request with an endpoint. Fresh characteristics are served from the snapshot,
+ *        missing or outdated ones are read, sharing the BLE session with other requests.
+ *        Revalidations of cacheable endpoints are answered from the snapshot as well.
+ * @param request The request.
+ * @param endpoint The endpoint.
+ */
+void serveEndpoint(HttpRequest *request, const SnapshotEndpoint& endpoint);
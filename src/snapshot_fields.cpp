@@ -0,0 +1,100 @@
+#include "snapshot_fields.h"
+
+#include <stddef.h>
+
+#define SNAPSHOT_FIELD(part, member, type, name) \
+    {#name, part, (uint16_t)(offsetof(ChargerSnapshot, member) + offsetof(type, name)), FIELD_TYPE(type, name)}
+
+// the field type follows from the size and signedness of the struct member
+#define FIELD_TYPE(type, name) fieldType(sizeof(((type*)0)->name), (decltype(((type*)0)->name))-1 < 0)
+
+static constexpr FieldType fieldType(size_t size, bool isSigned) {
+    return size == 1 ? (isSigned ? TYPE_I8 : TYPE_U8)
+         : size == 2 ? (isSigned ? TYPE_I16 : TYPE_U16)
+         : TYPE_U32;
+}
+
+#define ENERGY_FIELD(name) SNAPSHOT_FIELD(PART_ENERGY, EnergyData, Energy, name)
+#define POWER_FIELD(name) SNAPSHOT_FIELD(PART_POWER, PowerData, Power, name)
+#define VOLTAGE_CURRENT_FIELD(name) SNAPSHOT_FIELD(PART_VOLTAGE_CURRENT, VoltageCurrentData, VoltageCurrent, name)
+#define INFO_FIELD(name) SNAPSHOT_FIELD(PART_INFO, InfoData, Info, name)
+
+const SnapshotField snapshotFields[] = {
+    ENERGY_FIELD(TotalEnergy),
+    ENERGY_FIELD(EnergyLastCharge),
+    ENERGY_FIELD(Energy2ndLastCharge),
+    ENERGY_FIELD(Energy3rdLastCharge),
+    ENERGY_FIELD(ChargingEnergyLimit),
+
+    POWER_FIELD(TotalPower),
+    POWER_FIELD(L1),
+    POWER_FIELD(L2),
+    POWER_FIELD(L3),
+    POWER_FIELD(PeakPower),
+    POWER_FIELD(Frequency),
+    POWER_FIELD(Temperature),
+    POWER_FIELD(RemainingDistance),
+    POWER_FIELD(Costs),
+    POWER_FIELD(CPSignal),
+
+    VOLTAGE_CURRENT_FIELD(VoltageL1),
+    VOLTAGE_CURRENT_FIELD(VoltageL2),
+    VOLTAGE_CURRENT_FIELD(VoltageL3),
+    VOLTAGE_CURRENT_FIELD(CurrentL1),
+    VOLTAGE_CURRENT_FIELD(CurrentL2),
+    VOLTAGE_CURRENT_FIELD(CurrentL3),
+
+    INFO_FIELD(Current),
+    INFO_FIELD(KWhPer100),
+    INFO_FIELD(AmountPerKWh),
+    INFO_FIELD(FIEnabled),
+    INFO_FIELD(ErrorCode),
+    INFO_FIELD(Efficiency),
+    INFO_FIELD(ChargingActive),
+    INFO_FIELD(PauseCharging),
+    INFO_FIELD(ChargingCurrentMax),
+    INFO_FIELD(BLETransmissionPower),
+};
+
+static_assert(sizeof(snapshotFields) / sizeof(snapshotFields[0]) == SNAPSHOT_FIELD_COUNT,
+              "snapshotFields must list every SnapshotFieldId in order");
+
+static const char* partNames[PART_COUNT] = {"Energy", "Power", "VoltageCurrent", "Info"};
+
+const char* snapshotPartName(SnapshotPart part) {
+    return part >= 0 && part < PART_COUNT ? partNames[part] : "";
+}
+
+uint8_t snapshotFieldParts(const SnapshotFieldId* fields, size_t count) {
+    uint8_t parts = 0;
+    for (size_t i = 0; i < count; ++i) {
+        parts |= PART_BIT(snapshotFields[fields[i]].Part);
+    }
+    return parts;
+}
+
+int64_t readSnapshotField(const ChargerSnapshot& snapshot, const SnapshotField& field) {
+    // the characteristic structs are packed, fields are copied out instead of dereferenced
+    const uint8_t* source = (const uint8_t*)&snapshot + field.Offset;
+    switch (field.Type) {
+        case TYPE_U8:
+            return *source;
+        case TYPE_I8:
+            return (int8_t)*source;
+        case TYPE_U16: {
+            uint16_t value;
+            memcpy(&value, source, sizeof(value));
+            return value;
+        }
+        case TYPE_I16: {
+            int16_t value;
+            memcpy(&value, source, sizeof(value));
+            return value;
+        }
+        default: {
+            uint32_t value;
+            memcpy(&value, source, sizeof(value));
+            return value;
+        }
+    }
+}
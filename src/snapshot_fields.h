@@ -0,0 +1,87 @@
+#pragma once
+#include <Arduino.h>
+
+#include "snapshot.h"
+
+// Storage type of a characteristic field
+enum FieldType {
+    TYPE_U8,
+    TYPE_I8,
+    TYPE_U16,
+    TYPE_I16,
+    TYPE_U32
+};
+
+// Fields of the readable characteristics, index into snapshotFields
+enum SnapshotFieldId {
+    FIELD_ENERGY_TOTAL_ENERGY,
+    FIELD_ENERGY_LAST_CHARGE,
+    FIELD_ENERGY_2ND_LAST_CHARGE,
+    FIELD_ENERGY_3RD_LAST_CHARGE,
+    FIELD_ENERGY_CHARGING_ENERGY_LIMIT,
+
+    FIELD_POWER_TOTAL_POWER,
+    FIELD_POWER_L1,
+    FIELD_POWER_L2,
+    FIELD_POWER_L3,
+    FIELD_POWER_PEAK_POWER,
+    FIELD_POWER_FREQUENCY,
+    FIELD_POWER_TEMPERATURE,
+    FIELD_POWER_REMAINING_DISTANCE,
+    FIELD_POWER_COSTS,
+    FIELD_POWER_CP_SIGNAL,
+
+    FIELD_VOLTAGE_L1,
+    FIELD_VOLTAGE_L2,
+    FIELD_VOLTAGE_L3,
+    FIELD_CURRENT_L1,
+    FIELD_CURRENT_L2,
+    FIELD_CURRENT_L3,
+
+    FIELD_INFO_CURRENT,
+    FIELD_INFO_KWH_PER_100,
+    FIELD_INFO_AMOUNT_PER_KWH,
+    FIELD_INFO_FI_ENABLED,
+    FIELD_INFO_ERROR_CODE,
+    FIELD_INFO_EFFICIENCY,
+    FIELD_INFO_CHARGING_ACTIVE,
+    FIELD_INFO_PAUSE_CHARGING,
+    FIELD_INFO_CHARGING_CURRENT_MAX,
+    FIELD_INFO_BLE_TRANSMISSION_POWER,
+
+    SNAPSHOT_FIELD_COUNT
+};
+
+// A field of a characteristic, located by its offset in ChargerSnapshot
+struct SnapshotField {
+    const char* Name;
+    SnapshotPart Part;
+    uint16_t Offset;
+    FieldType Type;
+};
+
+// All fields of the readable characteristics in SnapshotFieldId order, grouped by part
+extern const SnapshotField snapshotFields[SNAPSHOT_FIELD_COUNT];
+
+/**
+ * @brief Returns the name of a snapshot part as used in the API, e.g. "VoltageCurrent".
+ * @param part The part.
+ * @return The name.
+ */
+const char* snapshotPartName(SnapshotPart part);
+
+/**
+ * @brief Returns the parts holding the given fields.
+ * @param fields The fields.
+ * @param count Number of fields.
+ * @return Bitmask of SnapshotPart bits.
+ */
+uint8_t snapshotFieldParts(const SnapshotFieldId* fields, size_t count);
+
+/**
+ * @brief Reads the value of a field from a snapshot.
+ * @param snapshot The snapshot.
+ * @param field The field.
+ * @return The value, widened to 64 bits.
+ */
+int64_t readSnapshotField(const ChargerSnapshot& snapshot, const SnapshotField& field);
@@ -0,0 +1,127 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+
+// A big-endian integer of a characteristic payload. The payload structs are packed in wire
+// order, so a field has the same offset on the wire as in its struct.
+struct WireField {
+    uint8_t Offset;
+    uint8_t Size;
+};
+
+#define WIRE_FIELD(type, name) WireField{(uint8_t)offsetof(type, name), (uint8_t)sizeof(((type*)0)->name)}
+
+// The fields of a payload struct in wire order, padding is left out. Specialized per struct
+// with WIRE_SCHEMA, decodeWire and encodeWire are generated from it.
+template <typename T>
+struct WireSchema;
+
+#define WIRE_SCHEMA(type, ...)                                              \
+    template <>                                                             \
+    struct WireSchema<type> {                                               \
+        static constexpr WireField Fields[] = {__VA_ARGS__};                \
+        static constexpr size_t Count = sizeof(Fields) / sizeof(Fields[0]); \
+    }
+
+// Host integer type of a field size
+template <size_t Size>
+struct WireInt;
+
+template <>
+struct WireInt<1> {
+    typedef uint8_t Type;
+};
+
+template <>
+struct WireInt<2> {
+    typedef uint16_t Type;
+};
+
+template <>
+struct WireInt<4> {
+    typedef uint32_t Type;
+};
+
+// The value is composed arithmetically and copied with memcpy, so neither the payload
+// nor the struct needs to be aligned and the host byte order does not matter
+template <size_t Size>
+inline void loadBigEndian(const uint8_t* in, uint8_t* out) {
+    typename WireInt<Size>::Type value = 0;
+    for (size_t i = 0; i < Size; ++i) {
+        value = (typename WireInt<Size>::Type)((value << 8) | in[i]);
+    }
+    memcpy(out, &value, Size);
+}
+
+template <size_t Size>
+inline void storeBigEndian(const uint8_t* in, uint8_t* out) {
+    typename WireInt<Size>::Type value;
+    memcpy(&value, in, Size);
+    for (size_t i = Size; i > 0; --i) {
+        out[i - 1] = (uint8_t)value;
+        value = (typename WireInt<Size>::Type)(value >> 8);
+    }
+}
+
+// Unrolled at compile time, one load or store per field
+template <typename T, size_t Index, bool End = (Index == WireSchema<T>::Count)>
+struct WireCodec {
+    enum : uint8_t {
+        Offset = WireSchema<T>::Fields[Index].Offset,
+        Size = WireSchema<T>::Fields[Index].Size
+    };
+
+    static inline void decode(const uint8_t* data, uint8_t* value) {
+        loadBigEndian<Size>(data + Offset, value + Offset);
+        WireCodec<T, Index + 1>::decode(data, value);
+    }
+
+    static inline void encode(const uint8_t* value, uint8_t* data) {
+        storeBigEndian<Size>(value + Offset, data + Offset);
+        WireCodec<T, Index + 1>::encode(value, data);
+    }
+};
+
+template <typename T, size_t Index>
+struct WireCodec<T, Index, true> {
+    static inline void decode(const uint8_t* data, uint8_t* value) {}
+    static inline void encode(const uint8_t* value, uint8_t* data) {}
+};
+
+// Fields must be ascending, must not overlap and must fit the struct
+template <typename T>
+constexpr bool wireSchemaValid(size_t index = 0, size_t end = 0) {
+    return index == WireSchema<T>::Count
+        ? end <= sizeof(T)
+        : WireSchema<T>::Fields[index].Offset >= end &&
+          (WireSchema<T>::Fields[index].Size == 1 || WireSchema<T>::Fields[index].Size == 2 ||
+           WireSchema<T>::Fields[index].Size == 4) &&
+          wireSchemaValid<T>(index + 1, WireSchema<T>::Fields[index].Offset + WireSchema<T>::Fields[index].Size);
+}
+
+/**
+ * @brief Decodes a big-endian payload into its struct. The payload is only read and
+ *        padding is zeroed, decoding the same payload twice gives the same value.
+ * @param data The payload, at least sizeof(T) bytes, no alignment required.
+ * @return The decoded value.
+ */
+template <typename T>
+inline T decodeWire(const uint8_t* data) {
+    static_assert(wireSchemaValid<T>(), "wire schema fields must be ascending and fit the struct");
+    T value;
+    memset(&value, 0, sizeof(value));
+    WireCodec<T, 0>::decode(data, (uint8_t*)&value);
+    return value;
+}
+
+/**
+ * @brief Encodes a struct as big-endian payload, padding is zeroed.
+ * @param value The value.
+ * @param data Receives sizeof(T) bytes, no alignment required.
+ */
+template <typename T>
+inline void encodeWire(const T& value, uint8_t* data) {
+    static_assert(wireSchemaValid<T>(), "wire schema fields must be ascending and fit the struct");
+    memset(data, 0, sizeof(T));
+    WireCodec<T, 0>::encode((const uint8_t*)&value, data);
+}